@@ -0,0 +1,765 @@
+#include "stdafx.h"
+#include "Benchmarks.h"
+#include "BitArray.h"
+#include "Palette.h"
+#include "LightStorage.h"
+#include "block.h"
+#include "ConcurrentChunkMap.h"
+#include "ChunkStorage.h"
+#include "VertexKernel.h"
+#include "LodGrid.h"
+#include "FaceRanges.h"
+#include "CompactShaderCheck.h"
+#include "settings.h"
+#include <vao.h>
+#include <vbo.h>
+#include <random>
+#include <thread>
+#include <queue>
+#include <shared_mutex>
+
+namespace Benchmarks
+{
+	namespace
+	{
+		// prevents the optimizer from discarding benchmarked work
+		volatile unsigned sink = 0;
+
+		// the original std::vector<bool> BitArray, kept as a baseline
+		class BitArrayOld
+		{
+		public:
+			BitArrayOld(size_t size = 0) { data_.resize(size, 0); }
+
+			void SetSequence(int index, int len, unsigned val)
+			{
+				for (int i = index; i < index + len; i++)
+				{
+					data_[i] = val & 1;
+					val >>= 1;
+				}
+			}
+
+			unsigned GetSequence(int index, int len) const
+			{
+				unsigned ret = 0;
+				for (int i = index; i < index + len; i++)
+					ret |= data_[i] << (i - index);
+				return ret;
+			}
+
+		private:
+			std::vector<bool> data_;
+		};
+
+		// the original ConcurrentPalette, kept as a baseline
+		template<typename T, unsigned _Size>
+		class SharedMutexPalette : public Palette<T, _Size>
+		{
+		public:
+			void SetVal(int index, T val)
+			{
+				std::lock_guard w(mtx);
+				Palette<T, _Size>::SetVal(index, val);
+			}
+
+			T GetVal(int index) const
+			{
+				std::shared_lock r(mtx);
+				return Palette<T, _Size>::GetVal(index);
+			}
+
+		private:
+			mutable std::shared_mutex mtx;
+		};
+
+		// N threads read random voxels while one thread keeps writing
+		// returns reads per second summed over all readers
+		template<typename PaletteT>
+		double contendedReads(int readers, int writesPerSecond, double seconds)
+		{
+			constexpr int count = 32 * 32 * 32;
+			auto palette = std::make_unique<PaletteT>();
+			for (int i = 0; i < count; i++)
+				palette->SetVal(i, BlockType(i % 8));
+
+			std::atomic_bool stop = false;
+			std::atomic<uint64_t> totalReads = 0;
+			std::vector<std::thread> threads;
+			for (int t = 0; t < readers; t++)
+			{
+				threads.emplace_back([&, t]
+				{
+					std::mt19937 rng(t);
+					uint64_t reads = 0;
+					unsigned sum = 0;
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						for (int i = 0; i < 1024; i++)
+							sum += unsigned(palette->GetVal(rng() % count));
+						reads += 1024;
+					}
+					sink = sink + sum;
+					totalReads += reads;
+				});
+			}
+
+			// writer
+			std::mt19937 rng(1234);
+			auto start = high_resolution_clock::now();
+			auto elapsed = [&] { return duration_cast<duration<double>>(high_resolution_clock::now() - start).count(); };
+			uint64_t writes = 0;
+			while (elapsed() < seconds)
+			{
+				if (writes < elapsed() * writesPerSecond)
+				{
+					palette->SetVal(rng() % count, BlockType(rng() % 16));
+					writes++;
+				}
+				else
+					std::this_thread::yield();
+			}
+			stop = true;
+			for (auto& t : threads)
+				t.join();
+			return totalReads / elapsed();
+		}
+
+		// flood fills colored light from the emitters through an empty chunk,
+		// the same way ChunkManager::lightPropagateAdd does
+		// returns the number of lights written
+		template<typename StorageT>
+		uint64_t floodLight(StorageT& storage, const std::vector<std::pair<glm::ivec3, Light>>& emitters)
+		{
+			constexpr int size = 32;
+			constexpr glm::ivec3 dirs[] =
+			{
+				{ 1, 0, 0 }, {-1, 0, 0 },
+				{ 0, 1, 0 }, { 0,-1, 0 },
+				{ 0, 0, 1 }, { 0, 0,-1 },
+			};
+			auto index = [](glm::ivec3 p) { return p.x + size * (p.y + size * p.z); };
+
+			uint64_t writes = 0;
+			std::queue<glm::ivec3> queue;
+			for (const auto& [pos, light] : emitters)
+			{
+				storage.SetVal(index(pos), glm::max(storage.GetVal(index(pos)).Get(), light.Get()));
+				writes++;
+				queue.push(pos);
+			}
+
+			while (!queue.empty())
+			{
+				glm::ivec3 p = queue.front();
+				queue.pop();
+				glm::u8vec4 level = storage.GetVal(index(p)).Get();
+				for (const auto& dir : dirs)
+				{
+					glm::ivec3 n = p + dir;
+					if (glm::any(glm::lessThan(n, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(n, glm::ivec3(size))))
+						continue;
+
+					glm::u8vec4 val = storage.GetVal(index(n)).Get();
+					bool enqueue = false;
+					for (int ci = 0; ci < 3; ci++)
+					{
+						if (val[ci] + 2 > level[ci])
+							continue;
+						val[ci] = level[ci] - 1;
+						enqueue = true;
+					}
+					if (enqueue)
+					{
+						storage.SetVal(index(n), val);
+						writes++;
+						queue.push(n);
+					}
+				}
+			}
+			return writes;
+		}
+
+		// runs a flood fill on a fresh storage of each policy and prints a row
+		template<typename StorageT>
+		void lightStorageRow(const char* policy, const char* scene, const std::vector<Light>& initial,
+			const std::vector<std::pair<glm::ivec3, Light>>& emitters)
+		{
+			constexpr int iterations = 5;
+			double ms = 0;
+			uint64_t writes = 0;
+			size_t bytes = 0;
+			for (int i = 0; i < iterations; i++)
+			{
+				auto storage = std::make_unique<StorageT>();
+				storage->Import(initial.data());
+				ms += timeIt(1, [&] { writes = floodLight(*storage, emitters); });
+				bytes = storage->MemoryUsage();
+			}
+			ms /= iterations;
+			printf("%-9s | %-8s | %9zu | %8.3f | %13.2f\n",
+				policy, scene, bytes, ms, writes / (ms / 1000) / 1e6);
+		}
+
+		// the same interface as ConcurrentChunkMap, the way chunks were stored before it
+		template<typename V>
+		class SharedMutexChunkMap
+		{
+		public:
+			V Find(const glm::ivec3& key) const
+			{
+				std::shared_lock r(mtx);
+				auto it = map.find(key);
+				return it != map.end() ? it->second : V{};
+			}
+
+			std::pair<V, bool> TryEmplace(const glm::ivec3& key, V value)
+			{
+				std::unique_lock w(mtx);
+				auto [it, inserted] = map.try_emplace(key, value);
+				return { it->second, inserted };
+			}
+
+			V Erase(const glm::ivec3& key)
+			{
+				std::unique_lock w(mtx);
+				auto it = map.find(key);
+				if (it == map.end())
+					return V{};
+				V ret = it->second;
+				map.erase(it);
+				return ret;
+			}
+
+		private:
+			struct Hash
+			{
+				size_t operator()(const glm::ivec3& v) const
+				{
+					return size_t(v.x) * 73856093 ^ size_t(v.y) * 19349663 ^ size_t(v.z) * 83492791;
+				}
+			};
+			mutable std::shared_mutex mtx;
+			std::unordered_map<glm::ivec3, V, Hash> map;
+		};
+
+		// each thread looks up random positions in a world of side^3 chunks (plus a margin
+		// that misses) and, for one op in writeEvery, inserts or erases one of its own positions
+		// returns operations per second
+		template<typename MapT>
+		double chunkMapOps(int threadCount, int writeEvery, double seconds)
+		{
+			constexpr int side = 32;
+			MapT map;
+			for (int x = 0; x < side; x++)
+				for (int y = 0; y < side; y++)
+					for (int z = 0; z < side; z++)
+						map.TryEmplace({ x, y, z }, intptr_t(1 + x + side * (y + side * z)));
+
+			std::atomic_bool stop = false;
+			std::atomic<uint64_t> totalOps = 0;
+			std::vector<std::thread> threads;
+			for (int t = 0; t < threadCount; t++)
+			{
+				threads.emplace_back([&, t]
+				{
+					std::mt19937 rng(t);
+					std::uniform_int_distribution<int> coord(-side / 4, side + side / 4);
+					uint64_t ops = 0;
+					intptr_t found = 0;
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						for (int i = 0; i < 1024; i++, ops++)
+						{
+							if (writeEvery && ops % writeEvery == 0)
+							{
+								// positions outside the prefilled world, owned by this thread
+								glm::ivec3 own(side * 2 + t, coord(rng), coord(rng));
+								if (rng() & 1)
+									map.TryEmplace(own, intptr_t(1));
+								else
+									map.Erase(own);
+							}
+							else
+								found += map.Find({ coord(rng), coord(rng), coord(rng) });
+						}
+					}
+					sink = sink + unsigned(found);
+					totalOps += ops;
+				});
+			}
+
+			std::this_thread::sleep_for(duration<double>(seconds));
+			stop = true;
+			for (auto& t : threads)
+				t.join();
+			return totalOps / seconds;
+		}
+
+		// returns average milliseconds per call of fn
+		template<typename Fn>
+		double timeIt(int iterations, Fn&& fn)
+		{
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			for (int i = 0; i < iterations; i++)
+				fn();
+			duration<double> dur = duration_cast<duration<double>>(high_resolution_clock::now() - start);
+			return dur.count() * 1000 / iterations;
+		}
+
+		// meshes each chunk into a scratch mesh (so the chunk's own mesh is untouched) and prints a row
+		void mesherRow(const char* name, const std::vector<ChunkPtr>& chunks, bool greedy, bool compact)
+		{
+			double ms = 0;
+			size_t vertices = 0;
+			size_t bytes = 0;
+			for (ChunkPtr chunk : chunks)
+			{
+				ChunkMesh mesh;
+				mesh.SetParent(chunk);
+				ms += timeIt(1, [&] { mesh.BuildMesh(greedy, compact); });
+				vertices += mesh.GetStagedVertexCount();
+				bytes += mesh.GetStagedBytes();
+			}
+			double n = double(chunks.size());
+			printf("%-12s | %14.1f | %8.3f | %15.2f\n", name, vertices / n, ms / n, bytes / n / 1024);
+		}
+
+		// the loaded chunks, up to a limit
+		std::vector<ChunkPtr> loadedChunks(size_t maxChunks)
+		{
+			std::vector<ChunkPtr> chunks;
+			ChunkStorage::GetMapRaw().ForEach([&](const glm::ivec3&, ChunkPtr chunk)
+			{
+				if (chunks.size() < maxChunks)
+					chunks.push_back(chunk);
+			});
+			return chunks;
+		}
+
+		// expands every quad record of a compact mesh into its vertices
+		std::vector<GLuint> expandQuads(const std::vector<GLuint>& quads)
+		{
+			std::vector<GLuint> vertices;
+			vertices.reserve(quads.size() * 6);
+			for (size_t i = 0; i + 1 < quads.size(); i += 2)
+			{
+				GLuint expanded[12];
+				ChunkHelpers::DecodeQuad({ quads[i], quads[i + 1] }, expanded);
+				vertices.insert(vertices.end(), std::begin(expanded), std::end(expanded));
+			}
+			return vertices;
+		}
+	}
+
+
+	void BitArrayCodec()
+	{
+		constexpr int count = 32 * 32 * 32; // entries in a chunk
+		constexpr int iterations = 20;
+		std::mt19937 rng(42);
+
+		printf("BitArray codec (%d entries, avg of %d runs)\n", count, iterations);
+		printf("width | old get   | new get   | new decode | old set   | new set   | new encode (ms)\n");
+		for (unsigned width : { 1u, 2u, 4u, 5u, 8u, 12u, 16u })
+		{
+			std::vector<uint16_t> values(count);
+			for (auto& v : values)
+				v = uint16_t(rng() & ((1u << width) - 1));
+			std::vector<uint16_t> decoded(count);
+
+			BitArrayOld oldArr(count * width);
+			BitArray newArr(count * width);
+
+			double oldSet = timeIt(iterations, [&]
+			{
+				for (int i = 0; i < count; i++)
+					oldArr.SetSequence(i * width, width, values[i]);
+			});
+			double newSet = timeIt(iterations, [&]
+			{
+				for (int i = 0; i < count; i++)
+					newArr.SetSequence(i * width, width, values[i]);
+			});
+			double newEncode = timeIt(iterations, [&]
+			{
+				newArr.EncodeRange(width, 0, count, values.data());
+			});
+
+			double oldGet = timeIt(iterations, [&]
+			{
+				unsigned sum = 0;
+				for (int i = 0; i < count; i++)
+					sum += oldArr.GetSequence(i * width, width);
+				sink = sink + sum;
+			});
+			double newGet = timeIt(iterations, [&]
+			{
+				unsigned sum = 0;
+				for (int i = 0; i < count; i++)
+					sum += newArr.GetSequence(i * width, width);
+				sink = sink + sum;
+			});
+			double newDecode = timeIt(iterations, [&]
+			{
+				newArr.DecodeRange(width, 0, count, decoded.data());
+				sink = sink + decoded[count - 1];
+			});
+
+			ASSERT(decoded == values);
+			printf("%5u | %9.4f | %9.4f | %10.4f | %9.4f | %9.4f | %10.4f\n",
+				width, oldGet, newGet, newDecode, oldSet, newSet, newEncode);
+		}
+	}
+
+
+	void PaletteContention()
+	{
+		constexpr double seconds = .5;
+		constexpr int writesPerSecond = 100'000;
+		int maxReaders = std::max(1u, std::thread::hardware_concurrency() - 1);
+
+		printf("Palette contention (%d writes/s, %.1fs per run)\n", writesPerSecond, seconds);
+		printf("readers | shared_mutex (Mreads/s) | seqlock (Mreads/s)\n");
+		for (int readers = 1; readers <= maxReaders; readers *= 2)
+		{
+			double locked = contendedReads<SharedMutexPalette<BlockType, 32768>>(readers, writesPerSecond, seconds);
+			double seqlock = contendedReads<ConcurrentPalette<BlockType, 32768>>(readers, writesPerSecond, seconds);
+			printf("%7d | %23.2f | %18.2f\n", readers, locked / 1e6, seqlock / 1e6);
+		}
+	}
+
+
+	void LightStorage()
+	{
+		constexpr unsigned count = 32 * 32 * 32;
+		std::mt19937 rng(7);
+
+		// dark chunk with a handful of colored emitters
+		std::vector<Light> dark(count);
+		std::vector<std::pair<glm::ivec3, Light>> torches;
+		for (int i = 0; i < 8; i++)
+		{
+			glm::ivec3 pos(rng() % 32, rng() % 32, rng() % 32);
+			torches.push_back({ pos, Light({ rng() % 16, rng() % 16, rng() % 16, 0 }) });
+		}
+
+		// fully sunlit chunk with one emitter
+		std::vector<Light> sunlit(count, Light({ 0, 0, 0, 15 }));
+		std::vector<std::pair<glm::ivec3, Light>> lamp = { { { 16, 16, 16 }, Light({ 15, 10, 5, 15 }) } };
+
+		printf("Light storage (32^3 chunk, flood fill from emitters)\n");
+		printf("policy    | scene    | bytes     | fill ms  | Mwrites/s\n");
+		lightStorageRow<PaletteLightStorage<count>>("palette", "sunlit", sunlit, lamp);
+		lightStorageRow<DenseLightStorage<count>>("dense", "sunlit", sunlit, lamp);
+		lightStorageRow<AdaptiveLightStorage<count>>("adaptive", "sunlit", sunlit, lamp);
+		lightStorageRow<PaletteLightStorage<count>>("palette", "torches", dark, torches);
+		lightStorageRow<DenseLightStorage<count>>("dense", "torches", dark, torches);
+		lightStorageRow<AdaptiveLightStorage<count>>("adaptive", "torches", dark, torches);
+	}
+
+
+	void ChunkMapContention()
+	{
+		constexpr double seconds = .5;
+		int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+		printf("Chunk map contention (32^3 chunks, %.1fs per run, Mops/s)\n", seconds);
+		printf("threads | writes | shared_mutex map | ConcurrentChunkMap\n");
+		for (int writeEvery : { 0, 10 })
+		{
+			for (int threads = 1; threads <= maxThreads; threads *= 2)
+			{
+				double locked = chunkMapOps<SharedMutexChunkMap<intptr_t>>(threads, writeEvery, seconds);
+				double sharded = chunkMapOps<ConcurrentChunkMap<intptr_t>>(threads, writeEvery, seconds);
+				printf("%7d | %5d%% | %16.2f | %18.2f\n", threads, writeEvery ? 100 / writeEvery : 0,
+					locked / 1e6, sharded / 1e6);
+			}
+		}
+	}
+
+
+	void Meshers()
+	{
+		std::vector<ChunkPtr> chunks = loadedChunks(512);
+		if (chunks.empty())
+		{
+			printf("Meshers: no chunks are loaded\n");
+			return;
+		}
+
+		printf("Meshers (%zu loaded chunks)\n", chunks.size());
+		printf("mesher       | vertices/chunk | ms/chunk | upload KB/chunk\n");
+		mesherRow("naive", chunks, false, false);
+		mesherRow("greedy", chunks, true, false);
+		mesherRow("naive quads", chunks, false, true);
+		mesherRow("greedy quads", chunks, true, true);
+	}
+
+
+	void QuadFormat()
+	{
+		constexpr int quads = 1'000'000;
+		std::mt19937 rng(11);
+
+		// random quads, with every field at every value it can take
+		size_t mismatched = 0;
+		size_t fieldErrors = 0;
+		for (int i = 0; i < quads; i++)
+		{
+			glm::uvec3 lpos(rng() % 32, rng() % 32, rng() % 32);
+			GLuint face = rng() % 6;
+			GLuint texIdx = rng() % 512;
+			Light light;
+			light.Raw() = uint16_t(rng());
+			int ao[4] = { int(rng() % 4), int(rng() % 4), int(rng() % 4), int(rng() % 4) };
+			int w = rng() % 32 + 1;
+			int h = rng() % 32 + 1;
+
+			GLuint expected[12];
+			GLuint decoded[12];
+			ChunkHelpers::ExpandQuad(lpos, face, texIdx, light, ao, w, h, expected);
+			glm::uvec2 quad = ChunkHelpers::EncodeQuad(lpos, face, texIdx, light, ao, w, h);
+			ChunkHelpers::DecodeQuad(quad, decoded);
+			if (!std::equal(std::begin(expected), std::end(expected), std::begin(decoded)))
+				mismatched++;
+
+			// the fields have to survive too, not only match the expansion
+			glm::uvec3 lowest(63);
+			bool fieldsKept = true;
+			for (int v = 0; v < 6; v++)
+			{
+				GLuint encoded = decoded[v * 2];
+				GLuint lighting = decoded[v * 2 + 1];
+				lowest = glm::min(lowest, glm::uvec3(encoded >> 26, (encoded >> 20) & 0x3F, (encoded >> 14) & 0x3F));
+				glm::ivec2 size(((lighting >> 19) & 0x1F) + 1, ((lighting >> 24) & 0x1F) + 1);
+				fieldsKept = fieldsKept && ((encoded >> 11) & 0x7) == face && ((encoded >> 2) & 0x1FF) == texIdx &&
+					(size == glm::ivec2(w, h) || size == glm::ivec2(h, w));
+			}
+			// faces pointing along +x, +y or +z lie on the far side of their block
+			glm::uvec3 facePos = lpos + glm::uvec3(glm::max(ChunkHelpers::faces[face], glm::ivec3(0)));
+			if (!fieldsKept || lowest != facePos)
+				fieldErrors++;
+		}
+		printf("Quad format (%d random quads): %zu expansions differ, %zu fields lost\n",
+			quads, mismatched, fieldErrors);
+
+		// the same, but expanded by the shaders
+		CompactShaderCheck::Result gpu = CompactShaderCheck::Run(100'000);
+		if (gpu.ran)
+			printf("Quad format (chunk_compact.vs vs chunk_optimized.vs): %zu/%zu vertices differ\n", gpu.mismatched, gpu.vertices);
+		else
+			printf("Quad format: the chunk shaders couldn't be built for the check\n");
+
+		std::vector<ChunkPtr> chunks = loadedChunks(512);
+		if (chunks.empty())
+		{
+			printf("Quad format: no chunks are loaded\n");
+			return;
+		}
+
+		// both meshers' output in the compact format has to expand to the per-vertex stream
+		for (bool greedy : { false, true })
+		{
+			size_t vertexBytes = 0;
+			size_t quadBytes = 0;
+			size_t differing = 0;
+			double vertexMs = 0;
+			double quadMs = 0;
+			for (ChunkPtr chunk : chunks)
+			{
+				ChunkMesh vertexMesh;
+				ChunkMesh quadMesh;
+				vertexMesh.SetParent(chunk);
+				quadMesh.SetParent(chunk);
+				vertexMs += timeIt(1, [&] { vertexMesh.BuildMesh(greedy, false); });
+				quadMs += timeIt(1, [&] { quadMesh.BuildMesh(greedy, true); });
+
+				std::vector<GLuint> vertices = vertexMesh.CopyStagedVertices();
+				std::vector<GLuint> quadRecords = quadMesh.CopyStagedVertices();
+				if (expandQuads(quadRecords) != vertices)
+					differing++;
+				vertexBytes += vertices.size() * sizeof(GLuint);
+				quadBytes += quadRecords.size() * sizeof(GLuint);
+			}
+			printf("%-6s | %zu/%zu chunks differ | %.2f MB vertices, %.2f MB quads (%.2fx smaller) | %.3f vs %.3f ms/chunk\n",
+				greedy ? "greedy" : "naive", differing, chunks.size(),
+				vertexBytes / 1e6, quadBytes / 1e6, quadBytes ? double(vertexBytes) / quadBytes : 0.0,
+				vertexMs / chunks.size(), quadMs / chunks.size());
+		}
+	}
+
+	void VertexKernels()
+	{
+		constexpr size_t count = 100'000;
+		constexpr int reps = 20;
+		std::mt19937 rng(5);
+
+		std::vector<VertexKernel::Quad> quads(count);
+		for (auto& q : quads)
+		{
+			glm::uvec3 lpos(rng() % 32, rng() % 32, rng() % 32);
+			q = { ChunkHelpers::Encode(lpos, 0, 0, 0), uint16_t(rng()), uint16_t(rng() % 512),
+				uint8_t(rng() % 6), uint8_t(rng()), uint8_t(rng() % 32 + 1), uint8_t(rng() % 32 + 1) };
+		}
+
+		// the scalar reference the mesher used to call per quad
+		std::vector<uint32_t> expected(count * 12);
+		auto reference = [&]
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				const auto& q = quads[i];
+				glm::uvec3 lpos(q.position >> 26, q.position >> 20 & 0x3F, q.position >> 14 & 0x3F);
+				Light light;
+				light.Raw() = q.light;
+				int ao[4] = { q.ao & 3, q.ao >> 2 & 3, q.ao >> 4 & 3, q.ao >> 6 & 3 };
+				GLuint vertices[12];
+				ChunkHelpers::ExpandQuad(lpos, q.face, q.texIdx, light, ao, q.w, q.h, vertices);
+				std::copy(std::begin(vertices), std::end(vertices), expected.begin() + i * 12);
+			}
+		};
+		double referenceMs = timeIt(reps, reference);
+
+		const char* names[] = { "scalar", "sse4.1", "avx2" };
+		// levels this CPU supports that weren't compiled in would only time a fallback, so they're skipped
+		printf("Vertex kernels (%zu random quads, detected level: %s)\n", count, names[VertexKernel::GetLevel()]);
+		printf("version    | ms     | Mquads/s | mismatches\n");
+		printf("%-10s | %6.3f | %8.2f | -\n", "ExpandQuad", referenceMs, count / referenceMs / 1e3);
+		for (int level = VertexKernel::Scalar; level <= VertexKernel::GetLevel(); level++)
+		{
+			if (!VertexKernel::IsCompiled(VertexKernel::Level(level)))
+				continue;
+			std::vector<uint32_t> out(count * 12);
+			double ms = timeIt(reps, [&] { VertexKernel::Expand(VertexKernel::Level(level), quads.data(), count, out.data()); });
+			size_t mismatches = 0;
+			for (size_t i = 0; i < count; i++)
+				if (!std::equal(out.begin() + i * 12, out.begin() + i * 12 + 12, expected.begin() + i * 12))
+					mismatches++;
+			printf("%-10s | %6.3f | %8.2f | %zu\n", names[level], ms, count / ms / 1e3, mismatches);
+		}
+	}
+
+
+	void LodMeshes()
+	{
+		std::vector<ChunkPtr> chunks = loadedChunks(512);
+		if (chunks.empty())
+		{
+			printf("LOD meshes: no chunks are loaded\n");
+			return;
+		}
+
+		bool majority = Settings::Graphics.lodMajority;
+		printf("LOD meshes (%zu loaded chunks)\n", chunks.size());
+		printf("reduction | level | triangles/chunk | ms/chunk | upload KB/chunk\n");
+		for (bool useMajority : { false, true })
+		{
+			Settings::Graphics.lodMajority = useMajority;
+			for (int level = 0; level <= LodGrid::MAX_LEVEL; level++)
+			{
+				double ms = 0;
+				size_t vertices = 0;
+				size_t bytes = 0;
+				for (ChunkPtr chunk : chunks)
+				{
+					ChunkMesh mesh;
+					mesh.SetParent(chunk);
+					mesh.SetLod(level);
+					ms += timeIt(1, [&] { mesh.BuildMesh(false, false); });
+					vertices += mesh.GetStagedVertexCount();
+					bytes += mesh.GetStagedBytes();
+				}
+				double n = double(chunks.size());
+				printf("%-9s | %5d | %15.1f | %8.3f | %15.2f\n",
+					useMajority ? "majority" : "surface", level, vertices / 3 / n, ms / n, bytes / n / 1024);
+			}
+		}
+		Settings::Graphics.lodMajority = majority;
+	}
+
+
+	void BackfaceRanges()
+	{
+		std::vector<ChunkPtr> chunks = loadedChunks(512);
+		if (chunks.empty())
+		{
+			printf("Backface ranges: no chunks are loaded\n");
+			return;
+		}
+
+		// compact meshes, so every record is one quad that can be checked against the viewpoint
+		struct Meshed
+		{
+			glm::ivec3 origin;
+			std::vector<std::pair<FaceRanges::AllocInfo, GLuint>> ranges;
+			std::vector<GLuint> quads; // every section's records, in the order of ranges
+		};
+		std::vector<Meshed> meshes;
+		glm::vec3 lo(std::numeric_limits<float>::max());
+		glm::vec3 hi(std::numeric_limits<float>::lowest());
+		for (ChunkPtr chunk : chunks)
+		{
+			ChunkMesh mesh;
+			mesh.SetParent(chunk);
+			mesh.BuildMesh(Settings::Graphics.greedyMeshing, true);
+			meshes.push_back({ chunk->GetPos() * Chunk::CHUNK_SIZE, mesh.GetStagedRanges(), mesh.CopyStagedVertices() });
+			lo = glm::min(lo, chunk->GetAABB().min);
+			hi = glm::max(hi, chunk->GetAABB().max);
+		}
+
+		constexpr int views = 64;
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<float> unit(0, 1);
+		size_t allTriangles = 0;
+		size_t drawnTriangles = 0;
+		size_t sections = 0;
+		size_t draws = 0;
+		size_t dropped = 0;
+		double ms = 0;
+		for (int view = 0; view < views; view++)
+		{
+			// anywhere in or a little around the loaded chunks
+			glm::vec3 eye = lo - 32.f + glm::vec3(unit(rng), unit(rng), unit(rng)) * (hi - lo + 64.f);
+			for (const Meshed& mesh : meshes)
+			{
+				size_t first = 0; // of the section in quads
+				for (const auto& [info, records] : mesh.ranges)
+				{
+					// as if the section was at the start of the allocator
+					DrawArraysIndirectCommand cmds[FaceRanges::MaxDraws];
+					int count = 0;
+					ms += timeIt(1, [&] { count = FaceRanges::Commands(info, 0, eye, 2 * sizeof(GLuint), 1, cmds); });
+
+					for (GLuint r = 0; r < records; r++)
+					{
+						GLuint x = mesh.quads[(first + r) * 2];
+						glm::ivec3 lpos(x >> 27, x >> 22 & 31, x >> 17 & 31);
+						int face = x >> 14 & 7;
+						glm::ivec3 normal = ChunkHelpers::faces[face];
+						int axis = normal.x ? 0 : normal.y ? 1 : 2;
+						float plane = float(mesh.origin[axis] + lpos[axis] + (normal[axis] > 0));
+						bool toward = (eye[axis] - plane) * normal[axis] > 0;
+						bool drawn = std::any_of(cmds, cmds + count,
+							[r](const DrawArraysIndirectCommand& c) { return r >= c.first && r < c.first + c.count; });
+						dropped += toward && !drawn;
+					}
+
+					allTriangles += records * 2;
+					for (int i = 0; i < count; i++)
+						drawnTriangles += cmds[i].count * 2;
+					sections++;
+					draws += count;
+					first += records;
+				}
+			}
+		}
+
+		printf("Backface ranges (%zu loaded chunks, %d viewpoints, %s)\n", chunks.size(), views,
+			Settings::Graphics.greedyMeshing ? "greedy" : "naive");
+		printf("triangles/view all | drawn   | drawn %% | draws/section | us/section | dropped faces\n");
+		printf("%18.1f | %7.1f | %7.1f | %13.2f | %10.4f | %zu\n",
+			double(allTriangles) / views, double(drawnTriangles) / views, 100.0 * drawnTriangles / allTriangles,
+			double(draws) / sections, ms * 1000 / sections, dropped);
+	}
+}
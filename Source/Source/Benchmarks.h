@@ -0,0 +1,37 @@
+#pragma once
+
+// microbenchmarks for engine internals
+// each one runs synchronously and prints its results to stdout
+namespace Benchmarks
+{
+	// word-packed BitArray vs. the old std::vector<bool> one
+	void BitArrayCodec();
+
+	// seqlock ConcurrentPalette vs. a shared_mutex palette with N readers and one writer
+	void PaletteContention();
+
+	// bytes per chunk and flood fill throughput of each light storage policy
+	void LightStorage();
+
+	// ConcurrentChunkMap vs. a shared_mutex unordered_map, mixed lookups/inserts on N threads
+	void ChunkMapContention();
+
+	// vertices, build time and upload size per chunk of the naive and greedy meshers on loaded chunks
+	void Meshers();
+
+	// compact quad records (EncodeQuad) vs. 6 expanded vertices: checks that random quads and
+	// the meshes of loaded chunks decode to exactly the per-vertex stream, and prints the sizes
+	void QuadFormat();
+
+	// ExpandQuad vs. each VertexKernel version the CPU supports, on random quads
+	// the kernels have to produce exactly ExpandQuad's vertices
+	void VertexKernels();
+
+	// triangles and build time per chunk at each LOD level, for both voxel reductions, on loaded chunks
+	void LodMeshes();
+
+	// triangles drawn with and without leaving out the face directions that point away from the camera
+	// (FaceRanges), from random viewpoints around the loaded chunks
+	// no face that points toward the camera may be left out
+	void BackfaceRanges();
+}
@@ -1,46 +1,227 @@
 #pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
 
-// specialized wrapper around std::vector<bool>
-// or any other dynamic bitset container
-// allows getting and setting of sequences
+// dynamic bitset backed by 64-bit words
+// allows getting and setting of sequences, as well as bulk
+// encoding/decoding of runs of fixed-width entries
 class BitArray
 {
 public:
 	BitArray(size_t size = 0);
 	void Resize(size_t newSize);
+	size_t Size() const { return size_; }
+	size_t ByteSize() const { return data_.size() * sizeof(word_t); }
+
 	void SetSequence(int index, int len, unsigned val);
 	unsigned GetSequence(int index, int len) const;
 
+	// raw words, for readers that can't hold a reference to the BitArray itself
+	const uint64_t* Data() const { return data_.data(); }
+	static unsigned GetSequence(const uint64_t* words, int index, int len);
+
+	// bulk access to entries that are Width bits wide
+	// entry i occupies bits [i * Width, (i + 1) * Width)
+	template<unsigned Width, typename OutT>
+	void DecodeRange(size_t first, size_t count, OutT* out) const;
+	template<unsigned Width, typename InT>
+	void EncodeRange(size_t first, size_t count, const InT* in);
+
+	// same as above, but the width is dispatched to one of the
+	// specializations at runtime
+	template<typename OutT>
+	void DecodeRange(unsigned width, size_t first, size_t count, OutT* out) const;
+	template<typename OutT>
+	static void DecodeRange(const uint64_t* words, unsigned width, size_t first, size_t count, OutT* out);
+	template<typename InT>
+	void EncodeRange(unsigned width, size_t first, size_t count, const InT* in);
+
+	static constexpr unsigned MaxWidth = 16;
+
 private:
-	// TODO: make this less vector<bool>
-	std::vector<bool> data_;
+	using word_t = uint64_t;
+	static constexpr unsigned WordBits = 64;
+
+	static constexpr word_t lowMask(unsigned len)
+	{
+		return len >= WordBits ? ~word_t(0) : (word_t(1) << len) - 1;
+	}
+
+	template<unsigned Width, typename OutT>
+	static void decodeRange(const word_t* words, size_t first, size_t count, OutT* out);
+
+	template<unsigned... Ws, typename Fn>
+	static void dispatchWidth(unsigned width, Fn&& fn, std::integer_sequence<unsigned, Ws...>);
+
+	std::vector<word_t> data_;
+	size_t size_ = 0;
 };
 
 inline BitArray::BitArray(size_t size)
 {
-	data_.resize(size, 0);
+	Resize(size);
 }
 
 inline void BitArray::Resize(size_t newSize)
 {
-	data_.resize(newSize, 0);
+	data_.resize((newSize + WordBits - 1) / WordBits, 0);
+
+	// clear bits past the end so that growing again yields zeroes (like vector<bool>)
+	if (newSize < size_ && newSize % WordBits)
+		data_.back() &= lowMask(newSize % WordBits);
+	size_ = newSize;
 }
 
 inline void BitArray::SetSequence(int index, int len, unsigned val)
 {
-	for (int i = index; i < index + len; i++)
+	if (len == 0)
+		return;
+	size_t word = size_t(index) / WordBits;
+	unsigned off = unsigned(index) % WordBits;
+	word_t mask = lowMask(len);
+	word_t v = word_t(val) & mask;
+
+	data_[word] = (data_[word] & ~(mask << off)) | (v << off);
+
+	// sequence straddles two words
+	if (off + len > WordBits)
 	{
-		data_[i] = val & 1;
-		val >>= 1;
+		unsigned spill = WordBits - off;
+		data_[word + 1] = (data_[word + 1] & ~(mask >> spill)) | (v >> spill);
 	}
 }
 
 inline unsigned BitArray::GetSequence(int index, int len) const
 {
-	unsigned ret = 0;
-	for (int i = index; i < index + len; i++)
+	return GetSequence(data_.data(), index, len);
+}
+
+inline unsigned BitArray::GetSequence(const uint64_t* words, int index, int len)
+{
+	if (len == 0)
+		return 0;
+	size_t word = size_t(index) / WordBits;
+	unsigned off = unsigned(index) % WordBits;
+	word_t ret = words[word] >> off;
+
+	// sequence straddles two words
+	if (off + len > WordBits)
+		ret |= words[word + 1] << (WordBits - off);
+	return unsigned(ret & lowMask(len));
+}
+
+// 64 entries of any width occupy exactly Width words, so groups of 64 entries
+// are decoded with shifts and masks that are all known at compile time
+// (MSVC fully unrolls these and vectorizes the widths that divide 64)
+// unaligned heads and tails fall back to GetSequence
+template<unsigned Width, typename OutT>
+void BitArray::DecodeRange(size_t first, size_t count, OutT* out) const
+{
+	decodeRange<Width>(data_.data(), first, count, out);
+}
+
+template<unsigned Width, typename OutT>
+void BitArray::decodeRange(const word_t* words, size_t first, size_t count, OutT* out)
+{
+	static_assert(Width <= MaxWidth);
+	if constexpr (Width == 0)
+	{
+		for (size_t i = 0; i < count; i++)
+			out[i] = OutT(0);
+	}
+	else
+	{
+		constexpr word_t mask = lowMask(Width);
+		size_t i = 0;
+		for (; i < count && (first + i) % WordBits; i++)
+			out[i] = OutT(GetSequence(words, int((first + i) * Width), Width));
+
+		for (; i + WordBits <= count; i += WordBits)
+		{
+			const word_t* src = &words[(first + i) / WordBits * Width];
+			OutT* dst = out + i;
+			for (unsigned j = 0; j < WordBits; j++)
+			{
+				const unsigned bit = j * Width;
+				const unsigned w = bit / WordBits;
+				const unsigned off = bit % WordBits;
+				word_t v = src[w] >> off;
+				if (off + Width > WordBits)
+					v |= src[w + 1] << (WordBits - off);
+				dst[j] = OutT(v & mask);
+			}
+		}
+
+		for (; i < count; i++)
+			out[i] = OutT(GetSequence(words, int((first + i) * Width), Width));
+	}
+}
+
+template<unsigned Width, typename InT>
+void BitArray::EncodeRange(size_t first, size_t count, const InT* in)
+{
+	static_assert(Width <= MaxWidth);
+	if constexpr (Width != 0)
 	{
-		ret |= data_[i] << (i - index);
+		constexpr word_t mask = lowMask(Width);
+		size_t i = 0;
+		for (; i < count && (first + i) % WordBits; i++)
+			SetSequence(int((first + i) * Width), Width, unsigned(in[i]));
+
+		// whole groups own their words, so they can be overwritten outright
+		for (; i + WordBits <= count; i += WordBits)
+		{
+			word_t words[Width] = {};
+			const InT* src = in + i;
+			for (unsigned j = 0; j < WordBits; j++)
+			{
+				const unsigned bit = j * Width;
+				const unsigned w = bit / WordBits;
+				const unsigned off = bit % WordBits;
+				word_t v = word_t(src[j]) & mask;
+				words[w] |= v << off;
+				if (off + Width > WordBits)
+					words[w + 1] |= v >> (WordBits - off);
+			}
+			word_t* dst = &data_[(first + i) / WordBits * Width];
+			for (unsigned w = 0; w < Width; w++)
+				dst[w] = words[w];
+		}
+
+		for (; i < count; i++)
+			SetSequence(int((first + i) * Width), Width, unsigned(in[i]));
 	}
-	return ret;
-}
\ No newline at end of file
+}
+
+template<unsigned... Ws, typename Fn>
+void BitArray::dispatchWidth(unsigned width, Fn&& fn, std::integer_sequence<unsigned, Ws...>)
+{
+	((width == Ws ? (fn(std::integral_constant<unsigned, Ws>{}), true) : false) || ...);
+}
+
+template<typename OutT>
+void BitArray::DecodeRange(unsigned width, size_t first, size_t count, OutT* out) const
+{
+	DecodeRange(data_.data(), width, first, count, out);
+}
+
+template<typename OutT>
+void BitArray::DecodeRange(const uint64_t* words, unsigned width, size_t first, size_t count, OutT* out)
+{
+	dispatchWidth(width, [&](auto w)
+	{
+		decodeRange<decltype(w)::value>(words, first, count, out);
+	}, std::make_integer_sequence<unsigned, MaxWidth + 1>{});
+}
+
+template<typename InT>
+void BitArray::EncodeRange(unsigned width, size_t first, size_t count, const InT* in)
+{
+	dispatchWidth(width, [&](auto w)
+	{
+		EncodeRange<decltype(w)::value>(first, count, in);
+	}, std::make_integer_sequence<unsigned, MaxWidth + 1>{});
+}
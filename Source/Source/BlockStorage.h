@@ -2,6 +2,7 @@
 #include "block.h"
 #include "BitArray.h"
 #include "Palette.h"
+#include "LightStorage.h"
 #include <array>
 
 // uncompressed block storage for chunks
@@ -19,8 +20,8 @@ public:
 	Block& GetBlockRef(int index);
 	Block GetBlock(int index);
 	BlockType GetBlockType(int index);
-	void SetBlock(int index, BlockType);
-	void SetLight(int index, Light);
+	bool SetBlock(int index, BlockType); // false, the storage never changes size
+	bool SetLight(int index, Light);
 	Light GetLight(int index);
 
 private:
@@ -30,22 +31,48 @@ private:
 };
 
 
+// immutable copy of a PaletteBlockStorage, safe to read from any thread without locking
+template<unsigned _Size>
+struct BlockStorageSnapshot
+{
+	Palette<BlockType, _Size> types;
+	Palette<Light, _Size> light;
+};
+
+
 // https://www.reddit.com/r/VoxelGameDev/comments/9yu8qy/palettebased_compression_for_chunked_discrete/
 // compressed block storage
 // can't really return references w/o doing crazy proxy class stuff
-template<unsigned _Size>
+// LightT is one of the policies in LightStorage.h
+template<unsigned _Size, typename LightT = AdaptiveLightStorage<_Size>>
 class PaletteBlockStorage
 {
 public:
-	void SetBlock(int index, BlockType);
+	// true if the write resized the storage (see UpdateMemoryStats)
+	bool SetBlock(int index, BlockType);
 	Block GetBlock(int index);
 	BlockType GetBlockType(int index);
-	void SetLight(int index, Light);
+	bool SetLight(int index, Light);
 	Light GetLight(int index);
 
+	// whole-chunk copies, each takes the palette lock at most once
+	void ExportTypes(std::array<BlockType, _Size>& out) const;
+	void ExportLight(std::array<Light, _Size>& out) const;
+	void ImportTypes(const std::array<BlockType, _Size>& in);
+	void ImportLight(const std::array<Light, _Size>& in);
+
+	// set if every block in the storage is the same type
+	std::optional<BlockType> UniformType() const;
+
+	// types and light are each copied atomically, but not together
+	BlockStorageSnapshot<_Size> Snapshot() const;
+
+	PaletteMemory TypeMemory() const;
+	PaletteMemory LightMemory() const;
+
 private:
 	ConcurrentPalette<BlockType, _Size> pblock_;
-	ConcurrentPalette<Light, _Size> plight_;
+	LightT plight_;
 };
 
 #include "BlockStorage.inl"
\ No newline at end of file
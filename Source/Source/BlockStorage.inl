@@ -49,15 +49,17 @@ inline BlockType ArrayBlockStorage<_Size>::GetBlockType(int index)
 }
 
 template<unsigned _Size>
-inline void ArrayBlockStorage<_Size>::SetBlock(int index, BlockType type)
+inline bool ArrayBlockStorage<_Size>::SetBlock(int index, BlockType type)
 {
 	blocks_[index].SetType(type);
+	return false;
 }
 
 template<unsigned _Size>
-inline void ArrayBlockStorage<_Size>::SetLight(int index, Light light)
+inline bool ArrayBlockStorage<_Size>::SetLight(int index, Light light)
 {
 	blocks_[index].GetLightRef() = light;
+	return false;
 }
 
 template<unsigned _Size>
@@ -71,32 +73,80 @@ inline Light ArrayBlockStorage<_Size>::GetLight(int index)
 
 
 
-template<unsigned _Size>
-inline void PaletteBlockStorage<_Size>::SetBlock(int index, BlockType type)
+template<unsigned _Size, typename LightT>
+inline bool PaletteBlockStorage<_Size, LightT>::SetBlock(int index, BlockType type)
 {
-	pblock_.SetVal(index, type);
+	return pblock_.SetVal(index, type);
 }
 
-template<unsigned _Size>
-inline Block PaletteBlockStorage<_Size>::GetBlock(int index)
+template<unsigned _Size, typename LightT>
+inline Block PaletteBlockStorage<_Size, LightT>::GetBlock(int index)
 {
 	return Block(GetBlockType(index), GetLight(index));
 }
 
-template<unsigned _Size>
-inline BlockType PaletteBlockStorage<_Size>::GetBlockType(int index)
+template<unsigned _Size, typename LightT>
+inline BlockType PaletteBlockStorage<_Size, LightT>::GetBlockType(int index)
 {
 	return pblock_.GetVal(index);
 }
 
-template<unsigned _Size>
-inline void PaletteBlockStorage<_Size>::SetLight(int index, Light light)
+template<unsigned _Size, typename LightT>
+inline bool PaletteBlockStorage<_Size, LightT>::SetLight(int index, Light light)
 {
-	plight_.SetVal(index, light);
+	return plight_.SetVal(index, light);
 }
 
-template<unsigned _Size>
-inline Light PaletteBlockStorage<_Size>::GetLight(int index)
+template<unsigned _Size, typename LightT>
+inline Light PaletteBlockStorage<_Size, LightT>::GetLight(int index)
 {
 	return plight_.GetVal(index);
+}
+
+template<unsigned _Size, typename LightT>
+inline void PaletteBlockStorage<_Size, LightT>::ExportTypes(std::array<BlockType, _Size>& out) const
+{
+	pblock_.Export(out.data());
+}
+
+template<unsigned _Size, typename LightT>
+inline void PaletteBlockStorage<_Size, LightT>::ExportLight(std::array<Light, _Size>& out) const
+{
+	plight_.Export(out.data());
+}
+
+template<unsigned _Size, typename LightT>
+inline void PaletteBlockStorage<_Size, LightT>::ImportTypes(const std::array<BlockType, _Size>& in)
+{
+	pblock_.Import(in.data());
+}
+
+template<unsigned _Size, typename LightT>
+inline void PaletteBlockStorage<_Size, LightT>::ImportLight(const std::array<Light, _Size>& in)
+{
+	plight_.Import(in.data());
+}
+
+template<unsigned _Size, typename LightT>
+inline std::optional<BlockType> PaletteBlockStorage<_Size, LightT>::UniformType() const
+{
+	return pblock_.Uniform();
+}
+
+template<unsigned _Size, typename LightT>
+inline BlockStorageSnapshot<_Size> PaletteBlockStorage<_Size, LightT>::Snapshot() const
+{
+	return { pblock_.Copy(), plight_.Copy() };
+}
+
+template<unsigned _Size, typename LightT>
+inline PaletteMemory PaletteBlockStorage<_Size, LightT>::TypeMemory() const
+{
+	return pblock_.GetMemoryInfo();
+}
+
+template<unsigned _Size, typename LightT>
+inline PaletteMemory PaletteBlockStorage<_Size, LightT>::LightMemory() const
+{
+	return plight_.GetMemoryInfo();
 }
\ No newline at end of file
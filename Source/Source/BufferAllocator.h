@@ -14,7 +14,9 @@ public:
 	~BufferAllocator();
 
 	// Change data of the allocator
-	uint64_t Allocate(void* data, GLuint size, UserT userdata = {});
+	uint64_t Allocate(const void* data, GLuint size, UserT userdata = {});
+	// same, but the data is copied on the GPU from another buffer
+	uint64_t Allocate(GLuint srcBuffer, GLuint srcOffset, GLuint size, UserT userdata = {});
 	bool Free(uint64_t handle);
 	bool FreeOldest();
 
@@ -22,6 +24,8 @@ public:
 	// Query information about the allocator
 	const auto& GetAllocs() { return allocs_; }
 	GLuint ActiveAllocs() { return numActiveAllocs_; }
+	GLuint UsedBytes() { return usedBytes_; }
+	GLuint Capacity() { return capacity_; }
 
 	GLuint GetGPUHandle() { return gpuHandle; }
 	GLuint GetAllocDataGPUHandle() { return allocDataGpuHandle_; }
@@ -69,6 +73,9 @@ private:
 	// called whenever anything about the allocator changed
 	void stateChanged();
 
+	// finds room for size bytes (after alignment), returns the new allocation or nullptr if it doesn't fit
+	allocationData<UserT>* allocate(GLuint size, UserT userdata);
+
 	// merges adjacent null allocations to iterator
 	void maybeMerge(Iterator it);
 
@@ -80,6 +87,7 @@ private:
 	GLuint gpuHandle = 0;
 	uint64_t nextHandle = 1;
 	GLuint numActiveAllocs_ = 0;
+	GLuint usedBytes_ = 0; // sum of active allocation sizes (after alignment)
 	const GLuint capacity_; // for fixed size buffers
 
 	GLuint allocDataGpuHandle_ = 0;
@@ -40,7 +40,31 @@ BufferAllocator<UserT>::~BufferAllocator<UserT>()
 
 
 template<typename UserT>
-uint64_t BufferAllocator<UserT>::Allocate(void* data, GLuint size, UserT userdata)
+uint64_t BufferAllocator<UserT>::Allocate(const void* data, GLuint size, UserT userdata)
+{
+	auto alloc = allocate(size, userdata);
+	if (!alloc)
+		return NULL;
+
+	glNamedBufferSubData(gpuHandle, alloc->offset, alloc->size, data);
+	return alloc->handle;
+}
+
+
+template<typename UserT>
+uint64_t BufferAllocator<UserT>::Allocate(GLuint srcBuffer, GLuint srcOffset, GLuint size, UserT userdata)
+{
+	auto alloc = allocate(size, userdata);
+	if (!alloc)
+		return NULL;
+
+	glCopyNamedBufferSubData(srcBuffer, gpuHandle, srcOffset, alloc->offset, size);
+	return alloc->handle;
+}
+
+
+template<typename UserT>
+auto BufferAllocator<UserT>::allocate(GLuint size, UserT userdata) -> allocationData<UserT>*
 {
 	size += (align_ - (size % align_)) % align_;
 	// find smallest NULL allocation that will fit
@@ -57,7 +81,7 @@ uint64_t BufferAllocator<UserT>::Allocate(void* data, GLuint size, UserT userdat
 	}
 	// allocation failure
 	if (small == allocs_.end())
-		return NULL;
+		return nullptr;
 
 	// split free allocation
 	allocationData<UserT> newAlloc(userdata);
@@ -74,12 +98,12 @@ uint64_t BufferAllocator<UserT>::Allocate(void* data, GLuint size, UserT userdat
 	if (small->size == 0)
 		*small = newAlloc;
 	else
-		allocs_.insert(small, newAlloc);
+		small = allocs_.insert(small, newAlloc);
 
-	glNamedBufferSubData(gpuHandle, newAlloc.offset, newAlloc.size, data);
 	++numActiveAllocs_;
+	usedBytes_ += newAlloc.size;
 	stateChanged();
-	return newAlloc.handle;
+	return &*small;
 }
 
 
@@ -92,6 +116,7 @@ bool BufferAllocator<UserT>::Free(uint64_t handle)
 		return false;
 
 	it->handle = NULL;
+	usedBytes_ -= it->size;
 	maybeMerge(it);
 	--numActiveAllocs_;
 	stateChanged();
@@ -120,6 +145,7 @@ bool BufferAllocator<UserT>::FreeOldest()
 		return false;
 
 	old->handle = NULL;
+	usedBytes_ -= old->size;
 	maybeMerge(old);
 	--numActiveAllocs_;
 	stateChanged();
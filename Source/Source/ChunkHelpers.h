@@ -1,5 +1,7 @@
 #pragma once
 //#include "chunk.h"
+#include "light.h"
+#include <array>
 
 namespace ChunkHelpers
 {
@@ -23,6 +25,15 @@ namespace ChunkHelpers
 
 	GLuint EncodeSplat(const glm::uvec3& modelPos, const glm::vec3& color);
 
+	// the two triangles of a quad of w*h faces, as 6 (encoded, light) vertex pairs
+	void ExpandQuad(const glm::uvec3& lpos, GLuint face, GLuint texIdx, Light light,
+		const int (&ao)[4], int w, int h, GLuint (&vertices)[12]);
+
+	// the same quad as one 8 byte record, expanded by the vertex shader (chunk_compact.vs)
+	glm::uvec2 EncodeQuad(const glm::uvec3& lpos, GLuint face, GLuint texIdx, Light light,
+		const int (&ao)[4], int w, int h);
+	void DecodeQuad(glm::uvec2 quad, GLuint (&vertices)[12]);
+
 	inline constexpr glm::ivec3 faces[6] =
 	{
 		{ 0, 0, 1 }, // 'far' face    (+z direction)
@@ -32,6 +43,33 @@ namespace ChunkHelpers
 		{ 0, 1, 0 }, // 'top' face    (+y direction)
 		{ 0,-1, 0 }, // 'bottom' face (-y direction)
 	};
+
+	// every offset to an adjacent chunk or block: faces (same order as above), then edges, then corners
+	inline constexpr glm::ivec3 neighbors[26] =
+	{
+		{ 0, 0, 1 }, { 0, 0,-1 }, {-1, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0,-1, 0 },
+
+		{-1,-1, 0 }, { 1,-1, 0 }, {-1, 1, 0 }, { 1, 1, 0 },
+		{-1, 0,-1 }, { 1, 0,-1 }, {-1, 0, 1 }, { 1, 0, 1 },
+		{ 0,-1,-1 }, { 0, 1,-1 }, { 0,-1, 1 }, { 0, 1, 1 },
+
+		{-1,-1,-1 }, { 1,-1,-1 }, {-1, 1,-1 }, { 1, 1,-1 },
+		{-1,-1, 1 }, { 1,-1, 1 }, {-1, 1, 1 }, { 1, 1, 1 },
+	};
+
+	// index into neighbors of an offset with components in [-1, 1], or -1 for no offset
+	inline constexpr int neighborIndex(const glm::ivec3& dir)
+	{
+		constexpr auto table = []
+		{
+			std::array<int, 27> ret{};
+			ret[13] = -1;
+			for (int i = 0; i < 26; i++)
+				ret[(neighbors[i].x + 1) + 3 * ((neighbors[i].y + 1) + 3 * (neighbors[i].z + 1))] = i;
+			return ret;
+		}();
+		return table[(dir.x + 1) + 3 * ((dir.y + 1) + 3 * (dir.z + 1))];
+	}
 }
 
 #include "ChunkHelpers.inl"
\ No newline at end of file
@@ -2,6 +2,7 @@
 #pragma once
 //#include "ChunkHelpers.h"
 //#include "chunk.h"
+#include <Vertices.h>
 
 namespace ChunkHelpers
 {
@@ -123,6 +124,104 @@ namespace ChunkHelpers
 	}
 
 
+	// packs the size of a merged quad (in blocks, along the texture's horizontal and vertical
+	// axes) into the unused top bits of an encoded light, so textures repeat instead of stretching
+	inline GLuint EncodeQuadSize(GLuint lightEncoded, glm::uvec2 size)
+	{
+		ASSERT(glm::all(glm::greaterThanEqual(size, glm::uvec2(1))) && glm::all(glm::lessThanEqual(size, glm::uvec2(32))));
+		return lightEncoded | (size.x - 1) << 19 | (size.y - 1) << 24;
+	}
+
+
+	// lpos is the lowest block of the quad, w runs along the axis after the face's
+	// normal axis (x -> y -> z -> x) and h along the one after that
+	// ao is the occlusion at each corner of the face, from 0 (darkest) to 3 (unoccluded)
+	inline void ExpandQuad(const glm::uvec3& lpos, GLuint face, GLuint texIdx, Light light,
+		const int (&ao)[4], int w, int h, GLuint (&vertices)[12])
+	{
+		int normalAxis = faces[face].x ? 0 : faces[face].y ? 1 : 2;
+		int uAxis = (normalAxis + 1) % 3;
+		int vAxis = (normalAxis + 2) % 3;
+
+		const GLfloat* data = Vertices::cube_light + face * 12;
+
+		// corners 0 and 3 only differ along the texture's horizontal axis
+		bool texAlongU = glm::ceil(data[0 + uAxis]) != glm::ceil(data[9 + uAxis]);
+		glm::uvec2 quadSize = texAlongU ? glm::uvec2(w, h) : glm::uvec2(h, w);
+
+		// add 4 vertices representing a quad
+		GLuint encodeds[4] = { 0 };
+		GLuint lightdeds[4] = { 0 };
+		for (int cindex = 0; cindex < 4; cindex++) // cindex = corner index
+		{
+			// transform vertices relative to chunk, stretching the far corners over the rectangle
+			glm::vec3 vert(data[cindex * 3 + 0], data[cindex * 3 + 1], data[cindex * 3 + 2]);
+			glm::uvec3 corner = glm::ceil(vert);
+			glm::uvec3 finalVert = corner + lpos;
+			finalVert[uAxis] += corner[uAxis] * (w - 1);
+			finalVert[vAxis] += corner[vAxis] * (h - 1);
+
+			// compress attributes into 32 bits
+			encodeds[cindex] = Encode(finalVert, face, texIdx, cindex);
+
+			int invOcclusion = 6 - 2 * ao[cindex];
+			auto tLight = light;
+			tLight.Set(tLight.Get() - glm::min(tLight.Get(), glm::u8vec4(invOcclusion)));
+			glm::ivec3 dirCent = -glm::ivec3(corner); // direction from the corner to the block it belongs to
+			lightdeds[cindex] = EncodeQuadSize(EncodeLight(tLight.Raw(), dirCent), quadSize);
+		}
+
+		const GLuint indicesA[6] = { 0, 1, 3, 3, 1, 2 }; // normal indices
+		const GLuint indicesB[6] = { 0, 1, 2, 2, 3, 0 }; // anisotropy fix (flip tris)
+		const GLuint* indices = indicesA;
+		// partially solve anisotropy issue
+		if (ao[0] + ao[2] > ao[1] + ao[3])
+			indices = indicesB;
+		for (int i = 0; i < 6; i++)
+		{
+			vertices[i * 2 + 0] = encodeds[indices[i]];
+			vertices[i * 2 + 1] = lightdeds[indices[i]];
+		}
+	}
+
+
+	// x: lpos (5 bits each) | face (3) | texture (9) | h - 1 (5)
+	// y: unused (3) | w - 1 (5) | AO of corners 3 to 0 (2 bits each) | light (16)
+	// every vertex attribute can be derived from these, since the corner lights are
+	// the face's light darkened by each corner's AO
+	inline glm::uvec2 EncodeQuad(const glm::uvec3& lpos, GLuint face, GLuint texIdx, Light light,
+		const int (&ao)[4], int w, int h)
+	{
+		ASSERT(glm::all(glm::lessThan(lpos, glm::uvec3(32))) && face < 6 && texIdx < 512);
+		ASSERT(w >= 1 && w <= 32 && h >= 1 && h <= 32);
+
+		glm::uvec2 quad;
+		quad.x = lpos.x << 27 | lpos.y << 22 | lpos.z << 17 | face << 14 | texIdx << 5 | GLuint(h - 1);
+		quad.y = GLuint(light.Raw()) | GLuint(w - 1) << 24;
+		for (int i = 0; i < 4; i++)
+			quad.y |= GLuint(ao[i]) << (16 + 2 * i);
+		return quad;
+	}
+
+
+	inline void DecodeQuad(glm::uvec2 quad, GLuint (&vertices)[12])
+	{
+		glm::uvec3 lpos(quad.x >> 27, (quad.x >> 22) & 0x1F, (quad.x >> 17) & 0x1F);
+		GLuint face = (quad.x >> 14) & 0x7;
+		GLuint texIdx = (quad.x >> 5) & 0x1FF;
+		int h = (quad.x & 0x1F) + 1;
+
+		Light light;
+		light.Raw() = uint16_t(quad.y & 0xFFFF);
+		int ao[4];
+		for (int i = 0; i < 4; i++)
+			ao[i] = (quad.y >> (16 + 2 * i)) & 0x3;
+		int w = ((quad.y >> 24) & 0x1F) + 1;
+
+		ExpandQuad(lpos, face, texIdx, light, ao, w, h, vertices);
+	}
+
+
 	inline GLuint EncodeSplat(const glm::uvec3& modelPos, const glm::vec3& color)
 	{
 		GLuint encoded = 0;
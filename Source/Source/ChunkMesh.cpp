@@ -4,13 +4,56 @@
 #include <vbo.h>
 #include <dib.h>
 #include <iomanip>
+#include <thread>
 #include "chunk.h"
 #include "ChunkHelpers.h"
 #include "ChunkStorage.h"
-#include <Vertices.h>
 #include "settings.h"
 #include "BufferAllocator.h"
 #include "ChunkRenderer.h"
+#include "FaceMask.h"
+#include "GatherBuffer.h"
+#include "VertexKernel.h"
+#include "LodGrid.h"
+
+
+namespace
+{
+	// a chunk made entirely of one solid block, which hides any face touching it
+	bool isOpaqueUniform(std::optional<BlockType> type)
+	{
+		return type && (FaceMask::ClassTable[uint16_t(*type)] & FaceMask::Occluder);
+	}
+
+	static_assert(ChunkMesh::SECTION_HEIGHT * ChunkMesh::SECTION_COUNT == Chunk::CHUNK_SIZE,
+		"sections have to cover the chunk");
+}
+
+
+// quads are expanded a batch at a time, into the space they already took in the output
+struct ChunkMesh::QuadBatch
+{
+	static constexpr size_t Capacity = 64;
+
+	void Flush()
+	{
+		VertexKernel::Expand(quads, size, reinterpret_cast<uint32_t*>(out));
+		size = 0;
+	}
+
+	VertexKernel::Quad quads[Capacity];
+	size_t size = 0;
+	GLint* out = nullptr; // where the first quad goes
+};
+
+
+// spans of the staging ring have to be given back, or the ring would stop reusing space at the first one
+ChunkMesh::~ChunkMesh()
+{
+	for (const Section& section : sections_)
+		if (section.ring.size)
+			ChunkRenderer::stagingRing->Release(section.ring);
+}
 
 
 void ChunkMesh::Render()
@@ -57,8 +100,27 @@ void ChunkMesh::BuildBuffers()
 {
 	std::lock_guard lk(mtx);
 
-	vertexCount_ = encodedStuffArr.size();
-	pointCount_ = sPosArr.size();
+	// this path draws the chunk from one buffer, so it needs every section built
+	// the staged meshes are owned here until they're uploaded, then their memory goes back to its arena
+	// (only meshes on the CPU, this path is never used with the allocators or their staging ring)
+	std::vector<GLint> vertices;
+	std::vector<GLint> points;
+	vertexCount_ = 0;
+	pointCount_ = 0;
+	for (int i = 0; i < SECTION_COUNT; i++)
+	{
+		MeshBuffer mesh = std::move(sections_[i].staged);
+		if (!mesh)
+			continue;
+		// keep the first header
+		size_t vertexSkip = vertices.empty() ? 0 : 4;
+		size_t pointSkip = points.empty() ? 0 : 3;
+		vertices.insert(vertices.end(), mesh.Vertices() + vertexSkip, mesh.Vertices() + mesh.VertexInts());
+		points.insert(points.end(), mesh.Points() + pointSkip, mesh.Points() + mesh.PointInts());
+		vertexCount_ += GLsizei((mesh.VertexInts() - 4) / 2 * (sections_[i].stagedCompact ? 6 : 1));
+	}
+	stagedSections_ = 0;
+	pointCount_ = GLsizei(points.size());
 
 	// nothing emitted, don't try to make buffers
 	if (pointCount_ == 0)
@@ -69,25 +131,7 @@ void ChunkMesh::BuildBuffers()
 
 	vao_->Bind();
 
-#if 0
-	encodedStuffVbo_ = std::make_unique<VBO>(encodedStuffArr.data(), sizeof(GLfloat) * encodedStuffArr.size());
-	encodedStuffVbo_->Bind();
-	glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 0, (void*)0); // encoded stuff
-	glEnableVertexAttribArray(0);
-
-	lightingVbo_ = std::make_unique<VBO>(lightingArr.data(), sizeof(GLfloat) * lightingArr.size());
-	lightingVbo_->Bind();
-	glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 0, (void*)0); // encoded lighting
-	glEnableVertexAttribArray(1);
-
-	glm::ivec3 pos = Chunk::CHUNK_SIZE * parent->GetPos();
-	posVbo_ = std::make_unique<VBO>(glm::value_ptr(pos), sizeof(glm::vec3));
-	posVbo_->Bind();
-	glEnableVertexAttribArray(2);
-	glVertexAttribDivisor(2, 1);
-	glVertexAttribIPointer(2, 3, GL_INT, sizeof(GLint), (void*)0);
-#else
-	encodedStuffVbo_ = std::make_unique<VBO>(interleavedArr.data(), sizeof(GLint) * interleavedArr.size());
+	encodedStuffVbo_ = std::make_unique<VBO>(vertices.data(), sizeof(GLint) * vertices.size());
 	encodedStuffVbo_->Bind();
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -101,14 +145,13 @@ void ChunkMesh::BuildBuffers()
 	offset += 1 * sizeof(GLfloat);
 
 	glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (void*)offset); // lighting
-#endif
 
 	// SPLATTING STUFF
 	if (!svao_)
 		svao_ = std::make_unique<VAO>();
 
 	svao_->Bind();
-	svbo_ = std::make_unique<VBO>(sPosArr.data(), sizeof(GLfloat) * sPosArr.size());
+	svbo_ = std::make_unique<VBO>(points.data(), sizeof(GLfloat) * points.size());
 	svbo_->Bind();
 	glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), (void*)0);
 	glEnableVertexAttribArray(0);
@@ -120,11 +163,6 @@ void ChunkMesh::BuildBuffers()
 	cmd.first = 0;
 	cmd.baseInstance = 0; // must be zero for glDrawElementsIndirect
 	dib_ = std::make_unique<DIB>(&cmd, sizeof(DrawArraysIndirectCommand));
-
-	encodedStuffArr.clear();
-	lightingArr.clear();
-	sPosArr.clear();
-	interleavedArr.clear();
 }
 
 
@@ -134,95 +172,262 @@ void ChunkMesh::BuildBuffers2()
 
 	namespace CR = ChunkRenderer;
 
-	vertexCount_ = encodedStuffArr.size();
-	pointCount_ = sPosArr.size();
+	// only the sections that were rebuilt are reuploaded, the others keep their allocations
+	for (int i = 0; i < SECTION_COUNT; i++)
+	{
+		if (!(stagedSections_ >> i & 1))
+			continue;
+		Section& section = sections_[i];
+
+		// the staged mesh is owned here until it's uploaded, then its memory goes back to its arena
+		// (or its span of the staging ring, once the GPU is done copying from it)
+		size_t vertexInts = section.stagedVertexInts();
+		size_t pointInts = section.stagedPointInts();
+		MeshBuffer mesh = std::move(section.staged);
+		StagingRing::Span ring = std::exchange(section.ring, {});
+		section.vertexCount = vertexInts ? GLsizei((vertexInts - 4) / 2 * (section.stagedCompact ? 6 : 1)) : 0;
+		section.pointCount = pointInts ? GLsizei(pointInts - 3) : 0;
+
+		CR::allocator->Free(section.bufferHandle);
+		CR::allocatorSplat->Free(section.bufferHandleSplat);
+		section.bufferHandle = NULL;
+		section.bufferHandleSplat = NULL;
+
+		// nothing emitted, don't try to make buffers
+		if (section.vertexCount == 0)
+		{
+			if (ring.size)
+				CR::stagingRing->Release(ring);
+			continue;
+		}
 
-	CR::allocator->Free(bufferHandle);
-	CR::allocatorSplat->Free(bufferHandleSplat);
+		FaceRanges::AllocInfo info = allocInfo(i);
 
-	// nothing emitted, don't try to make buffers
-	if (pointCount_ == 0)
-		return;
-	
-	// free oldest allocations until there is enough space to allocate this buffer
-	bufferHandle = 1;
-	do
+		// a mesh in the ring is only a copy on the GPU, one that didn't fit is sent from here
+		auto allocate = [&](auto& allocator, const GLint* data, size_t ints, GLuint ringOffset)
+		{
+			GLuint bytes = GLuint(ints * sizeof(GLint));
+			if (ring.size)
+				return allocator->Allocate(CR::stagingRing->GetGPUHandle(), ring.offset + ringOffset, bytes, info);
+			return allocator->Allocate(data, bytes, info);
+		};
+
+		// free oldest allocations until there is enough space to allocate this buffer
+		section.bufferHandle = 1;
+		do
+		{
+			if (section.bufferHandle == NULL)
+				CR::allocator->FreeOldest();
+			section.bufferHandle = allocate(CR::allocator, mesh.Vertices(), vertexInts, 0);
+		} while (section.bufferHandle == NULL);
+
+		// LOD meshes have no splats
+		if (section.pointCount != 0)
+		{
+			section.bufferHandleSplat = 1;
+			do
+			{
+				if (section.bufferHandleSplat == NULL)
+					CR::allocatorSplat->FreeOldest();
+				section.bufferHandleSplat = allocate(CR::allocatorSplat, mesh.Points(), pointInts, GLuint(vertexInts * sizeof(GLint)));
+			} while (section.bufferHandleSplat == NULL);
+		}
+
+		// the copies are recorded, so nothing reads the span after them
+		if (ring.size)
+			CR::stagingRing->Release(ring);
+	}
+	stagedSections_ = 0;
+
+	vertexCount_ = 0;
+	pointCount_ = 0;
+	for (const Section& section : sections_)
 	{
-		if (bufferHandle == NULL)
-			CR::allocator->FreeOldest();
-		bufferHandle = CR::allocator->Allocate(
-			interleavedArr.data(), interleavedArr.size() * sizeof(GLint), this->parent->GetAABB());
-	} while (bufferHandle == NULL);
-
-	bufferHandleSplat = 1;
-	do
+		vertexCount_ += section.vertexCount;
+		pointCount_ += section.pointCount;
+	}
+}
+
+
+bool ChunkMesh::BuildMesh()
+{
+	// taken before the snapshot, so edits made after it mark the sections again
+	// the version is read first, so an edit that's taken here but not stamped yet makes this mesh stale,
+	// and the mesh queued by that edit (with nothing left to build) stamps it fresh
+	unsigned version = version_;
+	uint8_t sections = dirtySections_.exchange(0);
+	if (sections)
 	{
-		if (bufferHandleSplat == NULL)
-			CR::allocator->FreeOldest();
-		bufferHandleSplat = CR::allocatorSplat->Allocate(
-			sPosArr.data(), sPosArr.size() * sizeof(GLint), this->parent->GetAABB());
-	} while (bufferHandleSplat == NULL);
-
-	encodedStuffArr.clear();
-	lightingArr.clear();
-	sPosArr.clear();
-	interleavedArr.clear();
+		if (!build(Settings::Graphics.greedyMeshing, Settings::Graphics.compactVertices, sections, true))
+		{
+			// a neighbor was being written the whole time, the caller queues it again
+			MarkDirty(sections);
+			return false;
+		}
+		buildCount_++; // scratch builds aren't counted
+	}
+	stagedVersion_ = version;
+	return true;
 }
 
 
-void ChunkMesh::BuildMesh()
+void ChunkMesh::BuildMesh(bool greedy, bool compact, uint8_t sections)
+{
+	// scratch meshes have no queue to go back to
+	while (!build(greedy, compact, sections, false))
+		std::this_thread::yield();
+}
+
+
+// useRing: the mesh is going to be uploaded, so it can go in the staging ring
+// returns false without building anything if the chunk and its neighbors couldn't be read consistently
+bool ChunkMesh::build(bool greedy, bool compact, uint8_t sections, bool useRing)
 {
 	high_resolution_clock::time_point benchmark_clock_ = high_resolution_clock::now();
 
-	for (int i = 0; i < fCount; i++)
+	// LOD cells can span sections and are cheap to mesh, so LOD meshes are always rebuilt whole
+	int lod = lod_;
+	if (lod > 0)
+		sections = ALL_SECTIONS;
+
+	// work on a consistent copy of the chunk, so writers don't need to be locked out
+	// and can't tear what we are reading (the neighbors are read under their versions in Gather)
+	std::shared_ptr<const ChunkSnapshot> snapshot = parent->Snapshot();
+
+	// uniform chunks have no faces if they're invisible or buried in opaque chunks
+	if (auto uniform = snapshot->UniformType())
 	{
-		nearChunks[i] = ChunkStorage::GetChunk(
-			parent->GetPos() + ChunkHelpers::faces[i]);
+		bool buried = isOpaqueUniform(uniform);
+		for (int i = 0; buried && i < fCount; i++)
+		{
+			Chunk* neighbor = parent->Neighbor(i);
+			buried = neighbor && isOpaqueUniform(neighbor->UniformType());
+		}
+		bool hidden = Block::PropertiesTable[uint16_t(*uniform)].visibility == Visibility::Invisible || buried;
+		if (hidden)
+		{
+			std::lock_guard lk(mtx);
+			Section empty;
+			for (int i = 0; i < SECTION_COUNT; i++)
+				if (sections >> i & 1)
+					stage(i, empty);
+			stagedSections_ |= sections;
+			return true;
+		}
 	}
 
 
-	mtx.lock();
+	// decode the parent and the blocks around it once up front,
+	// instead of going through palettes (and neighbors) per access
+	thread_local static auto gather = std::make_unique<GatherBuffer>();
+	thread_local static auto faceMasks = std::make_unique<std::array<uint32_t, fCount * Chunk::CHUNK_SIZE_SQRED>>();
+	thread_local static QuadBatch batch;
+	thread_local static auto lodGrid = std::make_unique<LodGrid>();
+	if (!gather->Gather(*snapshot, parent))
+		return false;
+
+	// built without holding mtx, so uploading (or reading) what's staged doesn't wait for the build
+	std::array<Section, SECTION_COUNT> built;
+	gather_ = gather.get();
+	faceMasks_ = faceMasks->data();
+	batch_ = &batch;
+	if (lod > 0)
+	{
+		lodGrid->Build(*gather, lod, Settings::Graphics.lodMajority ? LodGrid::Reduction::Majority : LodGrid::Reduction::Surface);
+		lodGrid_ = lodGrid.get();
+	}
+	else
+		buildFaceMasks();
+	compact_ = compact;
 
 	glm::ivec3 ap = parent->GetPos() * Chunk::CHUNK_SIZE;
-	interleavedArr.push_back(ap.x);
-	interleavedArr.push_back(ap.y);
-	interleavedArr.push_back(ap.z);
-	interleavedArr.push_back(42069); // necessary padding
-	sPosArr.push_back(ap.x);
-	sPosArr.push_back(ap.y);
-	sPosArr.push_back(ap.z);
-	// no padding necessary
-
-	glm::ivec3 pos;
-	for (pos.z = 0; pos.z < Chunk::CHUNK_SIZE; pos.z++)
+	for (int i = 0; i < SECTION_COUNT; i++)
 	{
-		// precompute first flat index part
-		int zcsq = pos.z * Chunk::CHUNK_SIZE_SQRED;
-		for (pos.y = 0; pos.y < Chunk::CHUNK_SIZE; pos.y++)
+		if (!(sections >> i & 1))
+			continue;
+		int yBegin = i * SECTION_HEIGHT;
+		int yEnd = yBegin + SECTION_HEIGHT;
+
+		// size the output from the faces that will be meshed (greedy meshing can only make fewer quads)
+		size_t faceCount = 0;
+		size_t blockCount = 0;
+		if (lod > 0)
+		{
+			int factor = lodGrid_->Factor();
+			glm::ivec3 cell;
+			for (cell.z = 0; cell.z < lodGrid_->Size(); cell.z++)
+				for (cell.y = yBegin / factor; cell.y < yEnd / factor; cell.y++)
+					for (cell.x = 0; cell.x < lodGrid_->Size(); cell.x++)
+						faceCount += FaceMask::BitCount(lodFaces(cell));
+		}
+		for (int z = 0; lod == 0 && z < Chunk::CHUNK_SIZE; z++)
 		{
-			// precompute second flat index part
-			int yczcsq = pos.y * Chunk::CHUNK_SIZE + zcsq;
-			for (pos.x = 0; pos.x < Chunk::CHUNK_SIZE; pos.x++)
+			for (int y = yBegin; y < yEnd; y++)
 			{
-				// this is what we would be doing every innermost iteration
-				//int index = x + y * CHUNK_SIZE + z * CHUNK_SIZE_SQRED;
-				// we only need to do addition
-				int index = pos.x + yczcsq;
-
-				// skip fully transparent blocks
-				BlockType block = parent->BlockTypeAt(index);
-				if (Block::PropertiesTable[uint16_t(block)].visibility == Visibility::Invisible)
-					continue;
-
-				voxelReady_ = true;
+				uint32_t blocks = 0;
 				for (int f = Far; f < fCount; f++)
-					buildBlockFace(f, pos, block);
-				//buildBlockVertices_normal({ x, y, z }, block);
+				{
+					uint32_t mask = faceRow(f, y, z);
+					faceCount += FaceMask::BitCount(mask);
+					blocks |= mask;
+				}
+				blockCount += FaceMask::BitCount(blocks);
 			}
 		}
+
+		// an empty section is staged with no buffer at all, so its old mesh gets freed
+		if (faceCount == 0)
+		{
+			built[i].stagedCompact = compact;
+			continue;
+		}
+
+		// every section has its own allocation, so its own chunk position
+		MeshBuffer out = MeshArena::Local().Acquire(4 + faceCount * (compact ? 2 : 12), 3 + blockCount);
+		out_ = &out;
+		out_->PushVertex(ap.x);
+		out_->PushVertex(ap.y);
+		out_->PushVertex(ap.z);
+		out_->PushVertex(42069); // necessary padding
+		out_->PushPoint(ap.x);
+		out_->PushPoint(ap.y);
+		out_->PushPoint(ap.z);
+		// no padding necessary
+
+		// sorted by direction, so draws can skip the directions facing away from the camera
+		GLuint faceEnds[fCount];
+		for (int f = Far; f < fCount; f++)
+		{
+			if (lod > 0)
+				buildLod(yBegin, yEnd, f);
+			else if (greedy)
+				buildGreedy(yBegin, yEnd, f);
+			else
+				buildNaive(yBegin, yEnd, f);
+			faceEnds[f] = GLuint((out_->VertexInts() - 4) / 2);
+		}
+		if (lod == 0)
+			buildSplats(yBegin, yEnd);
+		batch_->Flush();
+
+		prepare(built[i], std::move(out), useRing);
+		built[i].stagedCompact = compact;
+		std::copy(std::begin(faceEnds), std::end(faceEnds), built[i].faceEnds);
 	}
+	out_ = nullptr;
+	gather_ = nullptr;
+	faceMasks_ = nullptr;
+	occupancy_ = nullptr;
+	lodGrid_ = nullptr;
+	batch_ = nullptr;
 
-	mtx.unlock();
+	{
+		std::lock_guard lk(mtx);
+		for (int i = 0; i < SECTION_COUNT; i++)
+			if (sections >> i & 1)
+				stage(i, built[i]);
+		stagedSections_ |= sections;
+	}
 
 	duration<double> benchmark_duration_ = duration_cast<duration<double>>(high_resolution_clock::now() - benchmark_clock_);
 	double milliseconds = benchmark_duration_.count() * 1000;
@@ -237,6 +442,119 @@ void ChunkMesh::BuildMesh()
 	//	<< std::setw(-2) << std::showpoint << std::setprecision(4) << accumtime / accumcount << " ms "
 	//	<< "(" << milliseconds << ")"
 	//	<< std::endl;
+	return true;
+}
+
+
+void ChunkMesh::GetStagingMemory(size_t (&bytes)[MemoryStats::CategoryCount])
+{
+	std::shared_lock lk(mtx);
+	bytes[MemoryStats::MeshStaging] = 0;
+	for (const Section& section : sections_)
+		bytes[MemoryStats::MeshStaging] += section.staged.CapacityBytes();
+}
+
+
+size_t ChunkMesh::GetStagedVertexCount()
+{
+	std::shared_lock lk(mtx);
+	size_t count = 0;
+	for (const Section& section : sections_)
+	{
+		if (!section.hasStaged())
+			continue;
+		// a quad record is expanded to 6 vertices
+		size_t records = (section.stagedVertexInts() - 4) / 2;
+		count += section.stagedCompact ? records * 6 : records;
+	}
+	return count;
+}
+
+
+size_t ChunkMesh::GetStagedBytes()
+{
+	std::shared_lock lk(mtx);
+	size_t bytes = 0;
+	for (const Section& section : sections_)
+		bytes += (section.stagedVertexInts() + section.stagedPointInts()) * sizeof(GLint);
+	return bytes;
+}
+
+
+std::vector<GLuint> ChunkMesh::CopyStagedVertices()
+{
+	std::shared_lock lk(mtx);
+	std::vector<GLuint> vertices;
+	for (const Section& section : sections_)
+		ASSERT_MSG(!section.ring.size, "Staged mesh is in the staging ring!");
+	for (const Section& section : sections_)
+		if (section.staged)
+			vertices.insert(vertices.end(), section.staged.Vertices() + 4, section.staged.Vertices() + section.staged.VertexInts());
+	return vertices;
+}
+
+
+std::vector<std::pair<FaceRanges::AllocInfo, GLuint>> ChunkMesh::GetStagedRanges()
+{
+	std::shared_lock lk(mtx);
+	std::vector<std::pair<FaceRanges::AllocInfo, GLuint>> ranges;
+	for (int i = 0; i < SECTION_COUNT; i++)
+		if (sections_[i].hasStaged())
+			ranges.push_back({ allocInfo(i), GLuint((sections_[i].stagedVertexInts() - 4) / 2) });
+	return ranges;
+}
+
+
+// the output of a build for a section, before it's staged (so without mtx)
+// the mesh goes in the staging ring if useRing and there is one with room for it,
+// so the main thread doesn't have to send it
+void ChunkMesh::prepare(Section& built, MeshBuffer mesh, bool useRing)
+{
+	const auto& ring = ChunkRenderer::stagingRing;
+	if (useRing && ring && mesh)
+	{
+		size_t vertexBytes = mesh.VertexInts() * sizeof(GLint);
+		size_t pointBytes = mesh.PointInts() * sizeof(GLint);
+		if (auto span = ring->Reserve(GLuint(vertexBytes + pointBytes)))
+		{
+			std::memcpy(span->data, mesh.Vertices(), vertexBytes);
+			std::memcpy(span->data + vertexBytes, mesh.Points(), pointBytes);
+			built.ring = *span;
+			built.ringVertexInts = GLuint(mesh.VertexInts());
+			built.ringPointInts = GLuint(mesh.PointInts());
+			mesh = MeshBuffer();
+		}
+	}
+	built.staged = std::move(mesh);
+}
+
+
+// replaces (and frees) any mesh of the section that wasn't uploaded yet with a build, with mtx held
+void ChunkMesh::stage(int section, Section& built)
+{
+	Section& s = sections_[section];
+	if (s.ring.size)
+		ChunkRenderer::stagingRing->Release(s.ring);
+	s.staged = std::move(built.staged);
+	s.stagedCompact = built.stagedCompact;
+	std::copy(std::begin(built.faceEnds), std::end(built.faceEnds), s.faceEnds);
+	s.ring = std::exchange(built.ring, {});
+	s.ringVertexInts = built.ringVertexInts;
+	s.ringPointInts = built.ringPointInts;
+}
+
+
+// what the allocators keep about a section's staged mesh
+// sections are culled on their own, so the box only covers the section's slab
+FaceRanges::AllocInfo ChunkMesh::allocInfo(int section) const
+{
+	AABB box = parent->GetAABB();
+	box.min.y += section * SECTION_HEIGHT;
+	box.max.y = box.min.y + SECTION_HEIGHT;
+
+	FaceRanges::AllocInfo info{ box };
+	std::copy(std::begin(sections_[section].faceEnds), std::end(sections_[section].faceEnds), info.faceEnds);
+	return info;
 }
 
 
@@ -246,155 +564,311 @@ void ChunkMesh::SetParent(Chunk* p)
 }
 
 
-inline void ChunkMesh::buildBlockFace(
-	int face,
-	const glm::ivec3& blockPos,	// position of current block
-	BlockType block)						// block-specific information)
+uint8_t ChunkMesh::SectionsNear(int y)
 {
-	using namespace glm;
-	using namespace ChunkHelpers;
-	thread_local static localpos nearblock; // avoids unnecessary construction of vec3s
-	//glm::ivec3 nearFace = blockPos + faces[face];
+	int first = std::clamp(y - 1, 0, Chunk::CHUNK_SIZE - 1) / SECTION_HEIGHT;
+	int last = std::clamp(y + 1, 0, Chunk::CHUNK_SIZE - 1) / SECTION_HEIGHT;
+	uint8_t sections = 0;
+	for (int i = first; i <= last; i++)
+		sections |= 1 << i;
+	return sections;
+}
 
-	nearblock.block_pos = blockPos + faces[face];
 
-	ChunkPtr nearChunk = parent;
+// finds the faces to mesh for every row of blocks along x
+// each row of the gather buffer (so with the border, 34 bits) is turned into masks,
+// then compared to the rows around it (or itself, shifted) for each face
+void ChunkMesh::buildFaceMasks()
+{
+	using namespace FaceMask;
+	constexpr int size = Chunk::CHUNK_SIZE;
+	constexpr int padded = GatherBuffer::SIZE;
 
-	// if neighbor is out of this chunk, find which chunk it is in
-	if (any(lessThan(nearblock.block_pos, ivec3(0))) || any(greaterThanEqual(nearblock.block_pos, ivec3(Chunk::CHUNK_SIZE))))
+	// indexed [z][y] like the gather buffer, with bit x + 1
+	thread_local static std::array<uint64_t, padded * padded> visible, occluder, water;
+	for (int i = 0; i < padded * padded; i++)
 	{
-		fastWorldPosToLocalPos(chunkPosToWorldPos(nearblock.block_pos, parent->GetPos()), nearblock);
-		nearChunk = nearChunks[face];
+		const BlockType* row = gather_->types.data() + i * padded;
+		uint64_t v = 0, o = 0, w = 0;
+		for (int x = 0; x < padded; x++)
+		{
+			uint64_t c = ClassTable[uint16_t(row[x])];
+			v |= (c & Visible) << x;
+			o |= (c >> 1 & 1) << x;
+			w |= (c >> 2 & 1) << x;
+		}
+		visible[i] = v;
+		occluder[i] = o;
+		water[i] = w;
 	}
+	// air is the only invisible block
+	occupancy_ = visible.data();
 
-	// for now, we won't make a mesh for faces adjacent to NULL chunks
-	// in the future it may be wise to construct the mesh regardless
-	if (nearChunk == nullptr)
+	for (int z = 1; z <= size; z++)
 	{
-		addQuad(blockPos, block, face, nearChunk, Light({ 0, 0, 0, 15 }));
-		return;
+		for (int y = 1; y <= size; y++)
+		{
+			int i = y + padded * z;
+			uint64_t v = visible[i], w = water[i];
+			auto facesOf = [&](uint64_t nearOccluder, uint64_t nearWater, bool up)
+			{
+				// drop the border bits
+				return uint32_t(Faces(v, w, nearOccluder, nearWater, up) >> 1);
+			};
+
+			uint32_t* out = faceMasks_ + (z - 1) * size + (y - 1);
+			out[Far * size * size] = facesOf(occluder[i + padded], water[i + padded], false);
+			out[Near * size * size] = facesOf(occluder[i - padded], water[i - padded], false);
+			out[Left * size * size] = facesOf(occluder[i] << 1, water[i] << 1, false);
+			out[Right * size * size] = facesOf(occluder[i] >> 1, water[i] >> 1, false);
+			out[Top * size * size] = facesOf(occluder[i + 1], water[i + 1], true);
+			out[Bottom * size * size] = facesOf(occluder[i - 1], water[i - 1], false);
+		}
 	}
+}
 
-	// neighboring block and light
-	Block block2 = nearChunk->BlockAt(nearblock.block_pos);
-	Light light = block2.GetLight();
-	//Light light = nearChunk->LightAtCheap(nearblock.block_pos);
 
-	// this block is water and other block isn't water and is above this block
-	if ((block2.GetType() != BlockType::bWater && block == BlockType::bWater && (nearblock.block_pos - blockPos).y > 0) ||
-		Block::PropertiesTable[block2.GetTypei()].visibility > Visibility::Opaque)
-	{
-		addQuad(blockPos, block, face, nearChunk, light);
-		return;
-	}
-	// other block isn't air or water - don't add mesh
-	if (block2.GetType() != BlockType::bAir && block2.GetType() != BlockType::bWater)
-		return;
-	// both blocks are water - don't add mesh
-	if (block2.GetType() == BlockType::bWater && block == BlockType::bWater)
-		return;
-	// this block is invisible - don't add mesh
-	if (Block::PropertiesTable[uint16_t(block)].visibility == Visibility::Invisible)
-		return;
+inline uint32_t ChunkMesh::faceRow(int face, int y, int z) const
+{
+	return faceMasks_[face * Chunk::CHUNK_SIZE_SQRED + z * Chunk::CHUNK_SIZE + y];
+}
+
 
-	// if all tests are passed, generate this face of the block
-	addQuad(blockPos, block, face, nearChunk, light);
+// the light that falls on a face, which is the light of the block it faces
+inline Light ChunkMesh::faceLight(int face, const glm::ivec3& blockPos) const
+{
+	return gather_->LightAt(blockPos + ChunkHelpers::faces[face]);
 }
 
 
-inline void ChunkMesh::addQuad(const glm::ivec3& lpos, BlockType block, int face, Chunk* nearChunk, Light light)
+// AO of the corners of a face (packed like VertexKernel::Quad::ao), from the 3x3 blocks in front of it
+// the blocks looked at can be in the neighboring chunks, since the gather buffer has them
+inline uint8_t ChunkMesh::faceAO(const glm::ivec3& lpos, int face) const
 {
-	if (voxelReady_)
+	if (!Settings::Graphics.blockAO)
+		return 0xFF;
+
+	constexpr int padded = GatherBuffer::SIZE;
+	glm::ivec3 p = lpos + ChunkHelpers::faces[face] + 1; // block in front of the face, in gather coordinates
+	unsigned occlusion = 0;
+	if (face == Left || face == Right)
 	{
-		sPosArr.push_back(ChunkHelpers::EncodeSplat(lpos, 
-			glm::vec3(1)));
-		voxelReady_ = false;
+		// a bit from each of 9 rows
+		for (int b = -1; b <= 1; b++)
+			for (int a = -1; a <= 1; a++)
+				occlusion |= unsigned(occupancy_[(p.y + a) + padded * (p.z + b)] >> p.x & 1) << ((a + 1) + 3 * (b + 1));
 	}
+	else
+	{
+		// 3 bits from each of 3 rows
+		glm::ivec3 bDir = face == Top || face == Bottom ? glm::ivec3(0, 0, 1) : glm::ivec3(0, 1, 0);
+		for (int b = -1; b <= 1; b++)
+		{
+			glm::ivec3 r = p + bDir * b;
+			occlusion |= unsigned(occupancy_[r.y + padded * r.z] >> (p.x - 1) & 7) << (3 * (b + 1));
+		}
+	}
+	return VertexKernel::OcclusionAO(face, occlusion);
+}
+
 
-	int normalIdx = face;
-	int texIdx = (int)block; // temp value
-	uint16_t lighting = light.Raw();
+// emits a w*h block rectangle of faces with lpos at its lowest corner
+// w runs along the axis after the face's normal axis (x -> y -> z -> x), h along the one after that
+inline void ChunkMesh::emitQuad(const glm::ivec3& lpos, BlockType block, int face, Light light,
+	uint8_t ao, int w, int h)
+{
+	GLuint texIdx = (GLuint)block; // temp value
 	light.SetS(15);
 
-	// add 4 vertices representing a quad
-	float aoValues[4] = { 0, 0, 0, 0 }; // AO for each quad
-	GLuint encodeds[4] = { 0 };
-	GLuint lightdeds[4] = { 0 };
-	//int aoValuesIndex = 0;
-	const GLfloat* data = Vertices::cube_light;
-	int endQuad = (face + 1) * 12;
-	for (int i = face * 12, cindex = 0; i < endQuad; i += 3, cindex++) // cindex = corner index
+	if (compact_)
+	{
+		int corners[4] = { ao & 3, ao >> 2 & 3, ao >> 4 & 3, ao >> 6 & 3 };
+		glm::uvec2 quad = ChunkHelpers::EncodeQuad(glm::uvec3(lpos), face, texIdx, light, corners, w, h);
+		out_->PushVertex(quad.x);
+		out_->PushVertex(quad.y);
+		return;
+	}
+
+	// same vertices as ChunkHelpers::ExpandQuad
+	GLint* vertices = out_->ExtendVertices(12);
+	if (batch_->size == 0)
+		batch_->out = vertices;
+	batch_->quads[batch_->size++] = { ChunkHelpers::Encode(glm::uvec3(lpos), 0, 0, 0), light.Raw(),
+		uint16_t(texIdx), uint8_t(face), ao, uint8_t(w), uint8_t(h) };
+	if (batch_->size == QuadBatch::Capacity)
+		batch_->Flush();
+}
+
+
+// a quad for each face pointing along face, for the rows of blocks in [yBegin, yEnd)
+void ChunkMesh::buildNaive(int yBegin, int yEnd, int face)
+{
+	glm::ivec3 pos;
+	for (pos.z = 0; pos.z < Chunk::CHUNK_SIZE; pos.z++)
 	{
-		using namespace ChunkHelpers;
-		// transform vertices relative to chunk
-		glm::vec3 vert(data[i + 0], data[i + 1], data[i + 2]);
-		glm::uvec3 finalVert = glm::ceil(vert) + glm::vec3(lpos);// +0.5f;
-
-		// compress attributes into 32 bits
-		GLuint encoded = Encode(finalVert, normalIdx, texIdx, cindex);
-		encodeds[cindex] = encoded;
-
-		int invOcclusion = 6;
-		if (Settings::Graphics.blockAO)
-			invOcclusion = 2 * vertexFaceAO(lpos, vert, faces[face]);
-		
-		aoValues[cindex] = invOcclusion;
-		invOcclusion = 6 - invOcclusion;
-		auto tLight = light;
-		tLight.Set(tLight.Get() - glm::min(tLight.Get(), glm::u8vec4(invOcclusion)));
-		lighting = tLight.Raw();
-		glm::ivec3 dirCent = glm::vec3(lpos) - glm::vec3(finalVert);
-		//printf("(%d, %d, %d)\n", dirCent.x, dirCent.y, dirCent.z);
-		lightdeds[cindex] = EncodeLight(lighting, dirCent);
+		for (pos.y = yBegin; pos.y < yEnd; pos.y++)
+		{
+			// only visit blocks with faces
+			uint32_t blocks = faceRow(face, pos.y, pos.z);
+			int rowIndex = GatherBuffer::Index(0, pos.y, pos.z);
+			while (blocks)
+			{
+				pos.x = FaceMask::LowestBit(blocks);
+				blocks &= blocks - 1;
+				BlockType block = gather_->types[rowIndex + pos.x];
+				emitQuad(pos, block, face, faceLight(face, pos), faceAO(pos, face), 1, 1);
+			}
+		}
 	}
+}
+
 
-	const GLuint indicesA[6] = { 0, 1, 3, 3, 1, 2 }; // normal indices
-	const GLuint indicesB[6] = { 0, 1, 2, 2, 3, 0 }; // anisotropy fix (flip tris)
-	const GLuint* indices = indicesA;
-	// partially solve anisotropy issue
-	if (aoValues[0] + aoValues[2] > aoValues[1] + aoValues[3])
-		indices = indicesB;
-	for (int i = 0; i < 6; i++)
+// a splat for each block with a face, for the rows of blocks in [yBegin, yEnd)
+void ChunkMesh::buildSplats(int yBegin, int yEnd)
+{
+	glm::ivec3 pos;
+	for (pos.z = 0; pos.z < Chunk::CHUNK_SIZE; pos.z++)
 	{
-		encodedStuffArr.push_back(encodeds[indices[i]]);
-		lightingArr.push_back(lightdeds[indices[i]]);
-		interleavedArr.push_back(encodeds[indices[i]]);
-		interleavedArr.push_back(lightdeds[indices[i]]);
+		for (pos.y = yBegin; pos.y < yEnd; pos.y++)
+		{
+			uint32_t blocks = 0;
+			for (int f = Far; f < fCount; f++)
+				blocks |= faceRow(f, pos.y, pos.z);
+			while (blocks)
+			{
+				pos.x = FaceMask::LowestBit(blocks);
+				blocks &= blocks - 1;
+				out_->PushPoint(ChunkHelpers::EncodeSplat(pos, glm::vec3(1)));
+			}
+		}
 	}
 }
 
 
-// minimize amount of searching in the global chunk map
-inline int ChunkMesh::vertexFaceAO(const glm::vec3& lpos, const glm::vec3& cornerDir, const glm::vec3& norm)
+// merges coplanar faces with the same block, light and AO into rectangles, one slice at a time
+// only faces with the same AO at all four corners are merged, so the result is shaded
+// exactly like the per-face mesh
+// only blocks in [yBegin, yEnd) and faces pointing along face are meshed, so no quad crosses into another section
+void ChunkMesh::buildGreedy(int yBegin, int yEnd, int face)
 {
-	// TODO: make it work over chunk boundaries
-	using namespace glm;
+	using namespace ChunkHelpers;
+	constexpr int size = Chunk::CHUNK_SIZE;
+
+	// faces of the current slice, 0 where there is none
+	// (valid bit | block type | light | AO of the four corners)
+	thread_local static std::array<uint64_t, size * size> cells;
 
-	int occluded = 0;
+	int normalAxis = faces[face].x ? 0 : faces[face].y ? 1 : 2;
+	int uAxis = (normalAxis + 1) % 3;
+	int vAxis = (normalAxis + 2) % 3;
+	glm::ivec3 lo(0), hi(size);
+	lo.y = yBegin;
+	hi.y = yEnd;
 
-	// sides are components of the corner minus the normal direction
-	vec3 sidesDir = cornerDir * 2.0f - norm;
-	for (int i = 0; i < sidesDir.length(); i++)
+	for (int d = lo[normalAxis]; d < hi[normalAxis]; d++)
 	{
-		if (sidesDir[i] != 0)
+		glm::ivec3 pos;
+		pos[normalAxis] = d;
+		for (int v = lo[vAxis]; v < hi[vAxis]; v++)
+		{
+			pos[vAxis] = v;
+			for (int u = lo[uAxis]; u < hi[uAxis]; u++)
+			{
+				pos[uAxis] = u;
+				uint64_t& cell = cells[u + size * v];
+				cell = 0;
+
+				if (!(faceRow(face, pos.y, pos.z) >> pos.x & 1))
+					continue;
+
+				BlockType block = gather_->TypeAt(pos);
+				Light light = faceLight(face, pos);
+
+				cell = 1ull << 63 | uint64_t(block) << 32 | uint64_t(light.Raw()) << 8 | faceAO(pos, face);
+			}
+		}
+
+		for (int v = lo[vAxis]; v < hi[vAxis]; v++)
 		{
-			vec3 sideDir(0);
-			sideDir[i] = sidesDir[i];
-			vec3 sidePos = lpos + sideDir + norm;
-			if (all(greaterThanEqual(sidePos, vec3(0))) && all(lessThan(sidePos, vec3(Chunk::CHUNK_SIZE))))
-				if (parent->BlockAt(ivec3(sidePos)).GetType() != BlockType::bAir)
-					occluded++;
+			for (int u = lo[uAxis]; u < hi[uAxis]; u++)
+			{
+				uint64_t cell = cells[u + size * v];
+				if (!cell)
+					continue;
+
+				uint8_t ao = uint8_t(cell);
+				int w = 1, h = 1;
+				if (ao == 0x00 || ao == 0x55 || ao == 0xAA || ao == 0xFF) // same AO at every corner
+				{
+					while (u + w < hi[uAxis] && cells[u + w + size * v] == cell)
+						w++;
+					for (; v + h < hi[vAxis]; h++)
+					{
+						const uint64_t* row = &cells[u + size * (v + h)];
+						if (!std::all_of(row, row + w, [cell](uint64_t c) { return c == cell; }))
+							break;
+					}
+				}
+
+				for (int j = 0; j < h; j++)
+					std::fill_n(&cells[u + size * (v + j)], w, 0);
+
+				pos[uAxis] = u;
+				pos[vAxis] = v;
+				Light light;
+				light.Raw() = uint16_t(cell >> 8);
+				emitQuad(pos, BlockType(uint16_t(cell >> 32)), face, light, ao, w, h);
+			}
 		}
 	}
+}
 
 
-	if (occluded == 2)
+// faces of a LOD cell, a bit per face
+// the same rules as blocks, with cells standing in for blocks
+inline uint8_t ChunkMesh::lodFaces(const glm::ivec3& cell) const
+{
+	BlockType type = lodGrid_->TypeAt(cell);
+	if (type == BlockType::bAir)
 		return 0;
+	uint8_t faces = 0;
+	for (int f = Far; f < fCount; f++)
+	{
+		BlockType nearType = lodGrid_->TypeAt(cell + ChunkHelpers::faces[f]);
+		faces |= uint8_t(FaceMask::EmitTable[f == Top][uint16_t(type)][uint16_t(nearType)]) << f;
+	}
+	return faces;
+}
 
-	vec3 cornerPos = lpos + (cornerDir * 2.0f);
-	if (all(greaterThanEqual(cornerPos, vec3(0))) && all(lessThan(cornerPos, vec3(Chunk::CHUNK_SIZE))))
-		if (parent->BlockAt(ivec3(cornerPos)).GetType() != BlockType::bAir)
-			occluded++;
 
-	return 3 - occluded;
-}
\ No newline at end of file
+// a quad as big as the cell for each face pointing along face of the LOD cells in [yBegin, yEnd)
+// cells are lit by the block in front of the middle of the face, and have no AO or splats
+void ChunkMesh::buildLod(int yBegin, int yEnd, int face)
+{
+	using namespace ChunkHelpers;
+	int factor = lodGrid_->Factor();
+	int normalAxis = faces[face].x ? 0 : faces[face].y ? 1 : 2;
+
+	glm::ivec3 cell;
+	for (cell.z = 0; cell.z < lodGrid_->Size(); cell.z++)
+	{
+		for (cell.y = yBegin / factor; cell.y < yEnd / factor; cell.y++)
+		{
+			for (cell.x = 0; cell.x < lodGrid_->Size(); cell.x++)
+			{
+				if (!(lodFaces(cell) >> face & 1))
+					continue;
+				BlockType block = lodGrid_->TypeAt(cell);
+
+				// quads are placed on the far side of the block at lpos for faces pointing up an axis
+				glm::ivec3 lpos = cell * factor;
+				if (faces[face][normalAxis] > 0)
+					lpos[normalAxis] += factor - 1;
+
+				glm::ivec3 front = lpos + faces[face] + factor / 2;
+				front[normalAxis] = lpos[normalAxis] + faces[face][normalAxis];
+				emitQuad(lpos, block, face, gather_->LightAt(front), 0xFF, factor, factor);
+			}
+		}
+	}
+}
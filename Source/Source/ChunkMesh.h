@@ -3,38 +3,93 @@
 //#include "chunk.h"
 #include "NuRenderer.h"
 #include <dib.h>
+#include "MemoryStats.h"
+#include "MeshArena.h"
+#include "FaceRanges.h"
+#include "StagingRing.h"
 
 class VAO;
 class VBO;
 class DIB;
 struct Chunk;
+struct ChunkSnapshot;
+struct GatherBuffer;
+class LodGrid;
 
 class ChunkMesh
 {
 public:
+	ChunkMesh() = default;
+	~ChunkMesh();
 
 	void Render();
 	void RenderSplat();
 	void BuildBuffers();
 	void BuildBuffers2();
-	void BuildMesh();
+	bool BuildMesh(); // rebuilds the dirty sections, greedy or not, depending on Settings (false if it has to be retried)
+	// builds a scratch mesh that stays on the CPU (never in the staging ring), so it can be read back
+	void BuildMesh(bool greedy, bool compact = false, uint8_t sections = ALL_SECTIONS);
 	void SetParent(Chunk*);
 
+	// the mesh is split into slabs along y that are built and uploaded on their own,
+	// so an edit only remeshes (and reuploads) the part of the chunk it can change
+	static constexpr int SECTION_HEIGHT = 8;
+	static constexpr int SECTION_COUNT = 4;
+	static constexpr uint8_t ALL_SECTIONS = (1 << SECTION_COUNT) - 1;
+
+	// sections whose faces (or their AO or light) can read a block at local height y,
+	// which is allowed to be one block outside the chunk
+	static uint8_t SectionsNear(int y);
+
+	// sections to rebuild on the next BuildMesh(), all of them for a new mesh
+	// every call stamps a new version, which the next BuildMesh() will have built
+	void MarkDirty(uint8_t sections) { dirtySections_ |= sections; version_++; }
+
+	// the staged mesh was built before the last MarkDirty, so a newer one is on its way
+	// and uploading this one would only mean uploading again when that one is done
+	bool IsStale() const { return stagedVersion_ != version_; }
+
+	// detail of the mesh, 0 for every block or 1 to LodGrid::MAX_LEVEL for cells of 2^level blocks
+	// takes effect on the next BuildMesh
+	void SetLod(int level) { lod_ = level; }
+	int GetLod() const { return lod_; }
+
+	// times BuildMesh() (the pipeline, not scratch builds) has built this mesh, to spot chunks that get remeshed more than they change
+	unsigned GetBuildCount() const { return buildCount_; }
+
 	GLsizei GetVertexCount() { return vertexCount_; }
 	GLsizei GetPointCount() { return pointCount_; }
 
+	// vertices and bytes built by BuildMesh that haven't been uploaded yet
+	size_t GetStagedVertexCount();
+	size_t GetStagedBytes();
+	// copy of the staged vertex stream (vertices or quad records, after the chunk position)
+	// only for scratch meshes (see BuildMesh), a mesh in the staging ring can't be read back
+	std::vector<GLuint> CopyStagedVertices();
+	// allocator info and record count of each staged section that has faces
+	std::vector<std::pair<FaceRanges::AllocInfo, GLuint>> GetStagedRanges();
+
+	// fills in the bytes held by the vertex staging vectors
+	void GetStagingMemory(size_t (&bytes)[MemoryStats::CategoryCount]);
+
 	// debug
 	static inline bool debug_ignore_light_level = false;
 	static inline std::atomic<double> accumtime = 0;
 	static inline std::atomic<unsigned> accumcount = 0;
 private:
 
-	void buildBlockFace(
-		int face,
-		const glm::ivec3& blockPos,
-		BlockType block);
-	void addQuad(const glm::ivec3& lpos, BlockType block, int face, Chunk* nearChunk, Light light);
-	int vertexFaceAO(const glm::vec3& lpos, const glm::vec3& cornerDir, const glm::vec3& norm);
+	void buildFaceMasks();
+	uint32_t faceRow(int face, int y, int z) const;
+	Light faceLight(int face, const glm::ivec3& blockPos) const;
+	uint8_t faceAO(const glm::ivec3& lpos, int face) const;
+	void emitQuad(const glm::ivec3& lpos, BlockType block, int face, Light light, uint8_t ao, int w, int h);
+	void buildNaive(int yBegin, int yEnd, int face);
+	void buildGreedy(int yBegin, int yEnd, int face);
+	uint8_t lodFaces(const glm::ivec3& cell) const;
+	void buildLod(int yBegin, int yEnd, int face);
+	void buildSplats(int yBegin, int yEnd);
+	FaceRanges::AllocInfo allocInfo(int section) const;
+	bool build(bool greedy, bool compact, uint8_t sections, bool useRing);
 
 
 	enum
@@ -50,32 +105,77 @@ private:
 	};
 
 	Chunk* parent = nullptr;
-	Chunk* nearChunks[6];
+
+	// flat copy of the parent's blocks and the blocks around it, only valid during BuildMesh
+	const GatherBuffer* gather_ = nullptr;
+
+	// faces to mesh for each row of blocks along x, indexed [face][z][y] with bit x
+	// only valid during BuildMesh
+	uint32_t* faceMasks_ = nullptr;
+
+	// rows of the gather buffer like faceMasks_, but [z][y] with bit x + 1 and including the shell
+	// a bit is set where the block isn't air, which is what AO looks at
+	const uint64_t* occupancy_ = nullptr;
+
+	// the parent's downsampled cells when building a LOD mesh, only valid during BuildMesh
+	const LodGrid* lodGrid_ = nullptr;
+	std::atomic<int> lod_ = 0;
+	std::atomic<unsigned> buildCount_ = 0;
+
+	// quads waiting to be expanded into vertices, only valid during BuildMesh
+	struct QuadBatch;
+	QuadBatch* batch_ = nullptr;
 
 	std::unique_ptr<VAO> vao_;
 	std::unique_ptr<VBO> encodedStuffVbo_;
 	std::unique_ptr<VBO> lightingVbo_;
 	std::unique_ptr<VBO> posVbo_;
 
-	// vertex data (held until buffers are sent to GPU)
-	std::vector<GLint> encodedStuffArr;
-	std::vector<GLint> lightingArr;
-	std::vector<GLint> interleavedArr;
+	struct Section
+	{
+		// output of the last BuildMesh, held until it's sent to the GPU
+		MeshBuffer staged;
+		bool stagedCompact = false;
+		GLuint faceEnds[6] = {}; // of the staged mesh, see FaceRanges::AllocInfo
+
+		// or the same mesh copied into ChunkRenderer::stagingRing (vertices, then points) when it had room,
+		// then staged is empty and uploading it is only a copy on the GPU
+		StagingRing::Span ring;
+		GLuint ringVertexInts = 0;
+		GLuint ringPointInts = 0;
+
+		bool hasStaged() const { return staged || ring.size; }
+		size_t stagedVertexInts() const { return ring.size ? ringVertexInts : staged.VertexInts(); }
+		size_t stagedPointInts() const { return ring.size ? ringPointInts : staged.PointInts(); }
+
+		GLsizei vertexCount = 0;
+		GLsizei pointCount = 0;
+		uint64_t bufferHandle = NULL;
+		uint64_t bufferHandleSplat = NULL;
+	};
+	std::array<Section, SECTION_COUNT> sections_;
+	static void prepare(Section& built, MeshBuffer mesh, bool useRing);
+	void stage(int section, Section& built);
+	uint8_t stagedSections_ = 0; // built but not uploaded yet
+	std::atomic<uint8_t> dirtySections_ = ALL_SECTIONS;
+	std::atomic<unsigned> version_ = 0;       // of the last MarkDirty
+	std::atomic<unsigned> stagedVersion_ = 0; // of the last BuildMesh()
+
+	MeshBuffer* out_ = nullptr; // only valid during BuildMesh
+	bool compact_ = false; // whether out_ gets quad records (EncodeQuad) instead of vertices
 
-	GLsizei vertexCount_ = 0; // number of block vertices
-	uint64_t bufferHandle = NULL;
-	uint64_t bufferHandleSplat = NULL;
+	GLsizei vertexCount_ = 0; // number of block vertices, in every section
 
 	// SPLATTING STUFF
 	std::unique_ptr<VAO> svao_;
 	std::unique_ptr<VBO> svbo_;
-	std::vector<GLint> sPosArr; // point positions
-	GLsizei pointCount_ = 0;
-	bool voxelReady_ = true; // hack to prevent same voxel from being added multiple times
+	GLsizei pointCount_ = 0; // in every section
 
 	// indirect drawing stuff
 	std::unique_ptr<DIB> dib_;
 
+	// guards the staged sections and GL objects, but not the scratch state of a build (like out_),
+	// as only one build runs on a mesh at a time, so it's only held to swap a finished build in
 	std::shared_mutex mtx;
 };
 
@@ -16,6 +16,8 @@
 #include <param_bo.h>
 #include "ChunkStorage.h"
 #include <Vertices.h>
+#include "settings.h"
+#include "CompactShaderCheck.h"
 
 namespace ChunkRenderer
 {
@@ -48,10 +50,37 @@ namespace ChunkRenderer
 		drawCountGPU = std::make_unique<Param_BO>();
 		drawCountGPUSplat = std::make_unique<Param_BO>();
 
+		// the compact format is only used if the shader expands it the same as ExpandQuad
+		// (this runs before anything is meshed, so every mesh is built in the format that's drawn)
+		if (Settings::Graphics.compactVertices)
+		{
+			CompactShaderCheck::Result check = CompactShaderCheck::Run(4096);
+			if (!check.Passed())
+			{
+				printf("chunk_compact.vs check failed (%s, %zu/%zu vertices differ), using the per-vertex format\n",
+					check.ran ? "ran" : "didn't build", check.mismatched, check.vertices);
+				ASSERT_MSG(false, "chunk_compact.vs doesn't match ExpandQuad!");
+				Settings::Graphics.compactVertices = false;
+			}
+		}
+
 		// allocate big buffer
 		// TODO: vary the allocation size based on some user setting
-		allocator = std::make_unique<BufferAllocator<AABB16>>(3'000'000'000, 2 * sizeof(GLint));
-		allocatorSplat = std::make_unique<BufferAllocator<AABB16>>(200'000'000, sizeof(GLint));
+		// a quad takes 8 bytes in the compact format instead of 48, so the buffer can be 6x smaller
+		// compact quads are read through one SSBO binding of the whole buffer, so it can't be
+		// bigger than the driver's SSBO limit (only 128MB is guaranteed)
+		bool compact = Settings::Graphics.compactVertices;
+		size_t size = 3'000'000'000;
+		if (compact)
+		{
+			GLint64 maxBlockSize = 128 << 20;
+			glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+			size = std::min<size_t>(500'000'000, size_t(maxBlockSize));
+			size -= size % (2 * sizeof(GLint));
+		}
+		allocator = std::make_unique<BufferAllocator<FaceRanges::AllocInfo>>(size, 2 * sizeof(GLint));
+		allocatorSplat = std::make_unique<BufferAllocator<FaceRanges::AllocInfo>>(200'000'000, sizeof(GLint));
+		stagingRing = std::make_unique<StagingRing>(64'000'000);
 		
 		/* :::::::::::BUFFER FORMAT:::::::::::
 		                        CHUNK 1                                    CHUNK 2                   NULL                   CHUNK 3
@@ -66,19 +95,23 @@ namespace ChunkRenderer
 		vao->Bind();
 		// bind big data buffer (interleaved)
 		glBindBuffer(GL_ARRAY_BUFFER, allocator->GetGPUHandle());
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
 		glEnableVertexAttribArray(2);
 		glVertexAttribDivisor(2, 1); // only 1 instance of a chunk should render, so divisor *should* be infinity
 		GLuint offset = 0;
-		// stride is sizeof(vertex) so baseinstance can be set to cmd.first and work (hopefully)
+		// stride is sizeof(vertex) so baseinstance can be set to the chunk's first vertex (or record) and work
 		glVertexAttribIPointer(2, 3, GL_INT, 2 * sizeof(GLuint), (void*)offset); // chunk position (one per instance)
 		offset += sizeof(glm::ivec4); // move forward by TWO vertex sizes (vertex aligned)
 
-		glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (void*)offset); // encoded data
-		offset += 1 * sizeof(GLfloat);
+		// compact quads are read from the buffer as an SSBO by chunk_compact.vs instead
+		if (!compact)
+		{
+			glEnableVertexAttribArray(0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (void*)offset); // encoded data
+			offset += 1 * sizeof(GLfloat);
 
-		glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (void*)offset); // lighting
+			glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (void*)offset); // lighting
+		}
 		vao->Unbind();
 
 		vaoSplat = std::make_unique<VAO>();
@@ -130,10 +163,13 @@ namespace ChunkRenderer
 			sdr->set1FloatArray(uname.c_str(), fr.GetData()[i], 4);
 		}
 		sdr->setFloat("u_cullMinDist", settings.normalMin);
-		sdr->setFloat("u_cullMaxDist", settings.normalMax);
+		// LOD meshes replace the splats, so meshes are drawn as far as splats would be
+		sdr->setFloat("u_cullMaxDist", Settings::Graphics.lodMeshes ? settings.splatMax : settings.normalMax);
 #endif
 		sdr->setUInt("u_reservedVertices", 2);
 		sdr->setUInt("u_vertexSize", sizeof(GLuint) * 2);
+		sdr->setUInt("u_verticesPerRecord", Settings::Graphics.compactVertices ? 6 : 1);
+		sdr->setBool("u_faceRanges", settings.faceRangeCulling);
 
 		//drawCounter->Bind(0);
 		//drawCounter->Reset();
@@ -150,9 +186,10 @@ namespace ChunkRenderer
 		//glBufferData(GL_SHADER_STORAGE_BUFFER, allocator->AllocSize() * allocs.size(), allocs.data(), GL_STATIC_COPY);
 
 		// make DIB output SSBO (binding 1) for the shader
+		// an allocation can be drawn in a few ranges when face directions are culled
 		dib = std::make_unique<DIB>(
 			nullptr, 
-			allocator->ActiveAllocs() * sizeof(DrawArraysIndirectCommand),
+			allocator->ActiveAllocs() * FaceRanges::MaxDraws * sizeof(DrawArraysIndirectCommand),
 			GL_STATIC_COPY);
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, dib->GetID());
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, dib->GetID());
@@ -170,7 +207,7 @@ namespace ChunkRenderer
 		//glDeleteBuffers(1, &indata);
 
 		drawCountGPU->Unbind();
-		activeAllocs = allocator->ActiveAllocs();
+		activeAllocs = allocator->ActiveAllocs() * FaceRanges::MaxDraws;
 
 		PERF_BENCHMARK_END;
 	}
@@ -200,6 +237,8 @@ namespace ChunkRenderer
 #endif
 		sdr->setUInt("u_reservedVertices", 3);
 		sdr->setUInt("u_vertexSize", sizeof(GLuint) * 1);
+		sdr->setUInt("u_verticesPerRecord", 1);
+		sdr->setBool("u_faceRanges", false); // splats have no direction
 
 		//drawCounterSplat->Bind(0);
 		//drawCounterSplat->Reset();
@@ -249,10 +288,12 @@ namespace ChunkRenderer
 
 		vao->Bind();
 		dib->Bind();
+		if (Settings::Graphics.compactVertices)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, allocator->GetGPUHandle());
 		//glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 		//glMultiDrawArraysIndirect(GL_TRIANGLES, (void*)0, renderCount, 0);
 		drawCountGPU->Bind();
-		glMultiDrawArraysIndirectCount(GL_TRIANGLES, (void*)0, (GLintptr)0, allocator->ActiveAllocs(), 0);
+		glMultiDrawArraysIndirectCount(GL_TRIANGLES, (void*)0, (GLintptr)0, allocator->ActiveAllocs() * FaceRanges::MaxDraws, 0);
 	}
 
 
@@ -300,6 +341,8 @@ namespace ChunkRenderer
 
 		vao->Bind();
 		dib->Bind();
+		if (Settings::Graphics.compactVertices)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, allocator->GetGPUHandle());
 		//glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 		//glMultiDrawArraysIndirect(GL_TRIANGLES, (void*)0, renderCount, 0);
 		drawCountGPU->Bind();
@@ -364,6 +407,8 @@ namespace ChunkRenderer
 	{
 		if (allocator)
 			allocator->Update();
+		if (stagingRing)
+			stagingRing->EndFrame();
 	}
 }
 
@@ -1,6 +1,8 @@
 #pragma once
 #include "BufferAllocator.h"
 #include <Shapes.h>
+#include "FaceRanges.h"
+#include "StagingRing.h"
 
 namespace ChunkRenderer
 {
@@ -36,8 +38,10 @@ namespace ChunkRenderer
 
 	void Update();
 
-	inline std::unique_ptr<BufferAllocator<AABB16>> allocator;
-	inline std::unique_ptr<BufferAllocator<AABB16>> allocatorSplat;
+	inline std::unique_ptr<BufferAllocator<FaceRanges::AllocInfo>> allocator;
+	inline std::unique_ptr<BufferAllocator<FaceRanges::AllocInfo>> allocatorSplat;
+	// meshes are copied in here as they're built, and from here into the allocators when they're uploaded
+	inline std::unique_ptr<StagingRing> stagingRing;
 
 	struct Settings
 	{
@@ -46,7 +50,16 @@ namespace ChunkRenderer
 		float normalMax = 800;
 		float splatMin = 800;
 		float splatMax = 8000;
+		// with LOD meshes, where LOD 1 starts (each level after it starts twice as far)
+		// and how far past a boundary (as a fraction of it) a chunk has to be to change level
+		float lodStart = 400;
+		float lodHysteresis = .1f;
 		bool freezeCulling = false;
+		bool faceRangeCulling = true; // leave out the face directions of each chunk that point away from the camera
+		// main thread time and bytes spent uploading meshes per frame, nearest chunks first
+		// the rest are uploaded on the next frames (at least one chunk is uploaded every frame)
+		float uploadBudgetMs = 2;
+		int uploadBudgetKB = 8 * 1024;
 		bool debug_drawOcclusionCulling = false;
 	}inline settings;
 }
\ No newline at end of file
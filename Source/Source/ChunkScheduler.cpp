@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "ChunkScheduler.h"
+#include "chunk.h"
+
+
+bool ChunkScheduler::Push(ChunkPtr chunk, JobSystem::Priority priority)
+{
+	std::lock_guard lk(mtx_);
+	auto found = entries_.find(chunk);
+	if (found != entries_.end())
+	{
+		Entry& entry = found->second;
+		if (priority >= entry.priority)
+			return false;
+		entry.priority = priority;
+		return reband(entry, band(chunk, priority));
+	}
+
+	int b = band(chunk, priority);
+	bands_[b].push_back(chunk);
+	entries_.emplace(chunk, Entry{ b, priority, std::prev(bands_[b].end()) });
+	if (b == Parked)
+		cancelled_++;
+	return b != Parked;
+}
+
+
+ChunkPtr ChunkScheduler::Pop()
+{
+	std::lock_guard lk(mtx_);
+	for (int i = 0; i < BandCount; i++)
+	{
+		auto& band = bands_[i];
+		if (band.empty())
+			continue;
+		ChunkPtr chunk = band.front();
+		band.pop_front();
+		entries_.erase(chunk);
+		return chunk;
+	}
+	return nullptr;
+}
+
+
+bool ChunkScheduler::Remove(ChunkPtr chunk)
+{
+	std::lock_guard lk(mtx_);
+	auto found = entries_.find(chunk);
+	if (found == entries_.end())
+		return false;
+	bands_[found->second.band].erase(found->second.it);
+	entries_.erase(found);
+	return true;
+}
+
+
+size_t ChunkScheduler::Update(const glm::vec3& eye, const glm::vec3& front, const Frustum& frustum, float radius)
+{
+	std::lock_guard lk(mtx_);
+	eye_ = eye;
+	frustum_ = frustum;
+	radius_ = radius;
+
+	// half a band 0 of movement or about 10 degrees of turning can change bands
+	bool moved = glm::distance(eye, rebandEye_) > BandBase / 2 || glm::dot(front, rebandFront_) < .985f ||
+		radius != rebandRadius_;
+	if (rebandNext_ == reband_.size() && moved)
+	{
+		reband_.clear();
+		for (const auto& [chunk, entry] : entries_)
+			reband_.push_back(chunk);
+		rebandNext_ = 0;
+		rebandEye_ = eye;
+		rebandFront_ = front;
+		rebandRadius_ = radius;
+	}
+
+	// chunks popped since the pass started are skipped
+	size_t resumed = 0;
+	size_t end = std::min(reband_.size(), rebandNext_ + RebandPerUpdate);
+	for (; rebandNext_ < end; rebandNext_++)
+	{
+		auto found = entries_.find(reband_[rebandNext_]);
+		if (found == entries_.end())
+			continue;
+		if (reband(found->second, band(found->first, found->second.priority)))
+			resumed++;
+	}
+	return resumed;
+}
+
+
+size_t ChunkScheduler::Size() const
+{
+	std::lock_guard lk(mtx_);
+	return entries_.size() - bands_[Parked].size();
+}
+
+
+size_t ChunkScheduler::ParkedCount() const
+{
+	std::lock_guard lk(mtx_);
+	return bands_[Parked].size();
+}
+
+
+std::array<size_t, ChunkScheduler::BandCount> ChunkScheduler::BandDepths() const
+{
+	std::lock_guard lk(mtx_);
+	std::array<size_t, BandCount> depths;
+	for (int i = 0; i < BandCount; i++)
+		depths[i] = bands_[i].size();
+	return depths;
+}
+
+
+// moves an entry to the back of another band, returns true if it was parked and isn't anymore
+bool ChunkScheduler::reband(Entry& entry, int b)
+{
+	if (b == entry.band)
+		return false;
+	if (b == Parked)
+		cancelled_++;
+	bool resumed = entry.band == Parked;
+	bands_[b].splice(bands_[b].end(), bands_[entry.band], entry.it);
+	entry.band = b;
+	return resumed;
+}
+
+
+// band 0 is within BandBase blocks of the camera, and each band after it is twice as deep
+// past the load radius is Parked, whatever the priority (the chunk would be unloaded)
+int ChunkScheduler::band(ChunkPtr chunk, JobSystem::Priority priority)
+{
+	AABB box = chunk->GetAABB();
+	float distance = glm::distance((box.min + box.max) / 2.f, eye_);
+	if (distance > radius_)
+		return Parked;
+	if (priority == JobSystem::Priority::High)
+		return 0;
+
+	int b = int(std::log2(1 + distance / BandBase));
+	if (frustum_ && frustum_->IsInside(box) == Frustum::Visibility::Invisible)
+		b += OutOfViewBands;
+	if (priority == JobSystem::Priority::Low)
+		b += LowPriorityBands;
+	return std::clamp(b, 0, BandCount - 1);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <Frustum.h>
+#include "JobSystem.h"
+#include <array>
+#include <atomic>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+typedef struct Chunk* ChunkPtr;
+
+// chunks waiting on a stage of the pipeline, nearest and in view first
+// chunks are kept in bands of distance to the camera, each band twice as deep as the one before it,
+// and chunks outside the frustum are pushed back a few bands
+// the camera is snapshotted by Update (once per tick, on the main thread), so workers never read it,
+// and when it moves the queued chunks are rebanded a slice at a time
+// the entry of a queued chunk is its handle: pushing it again raises its priority, and removing it cancels it
+// chunks past the load radius are parked until they're back in range, so their work is dropped before it starts
+class ChunkScheduler
+{
+public:
+	static constexpr int BandCount = 8;
+	static constexpr float BandBase = 32;   // depth of band 0, in blocks
+	static constexpr int OutOfViewBands = 2; // how much further back chunks outside the frustum go
+	static constexpr int LowPriorityBands = 2;
+	static constexpr size_t RebandPerUpdate = 2048;
+
+	// queues a chunk, or raises its priority if it's already queued
+	// High priority chunks (edits) always go in band 0, Low ones go further back
+	// returns true if there is one more chunk to pop: it wasn't queued yet, or it was parked, and it isn't parked now
+	bool Push(ChunkPtr chunk, JobSystem::Priority priority = JobSystem::Priority::Normal);
+
+	// the oldest chunk of the nearest band that has any, null if there are none
+	ChunkPtr Pop();
+
+	// returns true if the chunk was queued (or parked)
+	bool Remove(ChunkPtr chunk);
+
+	// snapshots the camera and load radius, and rebands the next slice of queued chunks
+	// a new pass over every queued chunk starts once the camera has moved or turned, or the radius changed
+	// returns how many parked chunks came back in range, so they can be popped again
+	size_t Update(const glm::vec3& eye, const glm::vec3& front, const Frustum& frustum, float radius);
+
+	size_t Size() const; // chunks that can be popped, not counting parked ones
+	size_t ParkedCount() const;
+	size_t CancelledCount() const { return cancelled_.load(); } // times a chunk was parked, since the start
+	std::array<size_t, BandCount> BandDepths() const;
+
+private:
+	static constexpr int Parked = BandCount; // the band of chunks past the load radius, never popped
+
+	struct Entry
+	{
+		int band;
+		JobSystem::Priority priority;
+		std::list<ChunkPtr>::iterator it;
+	};
+	int band(ChunkPtr chunk, JobSystem::Priority priority);
+	bool reband(Entry& entry, int b);
+
+	std::list<ChunkPtr> bands_[BandCount + 1]; // oldest first
+	std::unordered_map<ChunkPtr, Entry> entries_;
+	std::atomic<size_t> cancelled_ = 0;
+
+	// the camera as of the last Update, none before the first one (and nothing is parked)
+	glm::vec3 eye_{ 0 };
+	std::optional<Frustum> frustum_;
+	float radius_ = std::numeric_limits<float>::infinity();
+
+	// the rebanding pass in progress, and the camera it started from
+	std::vector<ChunkPtr> reband_;
+	size_t rebandNext_ = 0;
+	glm::vec3 rebandEye_{ 0 };
+	glm::vec3 rebandFront_{ 0 };
+	float rebandRadius_ = std::numeric_limits<float>::infinity();
+
+	mutable std::mutex mtx_;
+};
@@ -1,23 +1,24 @@
 #pragma once
 #include "ChunkHelpers.h"
 #include "chunk.h"
+#include "ConcurrentChunkMap.h"
 
+// chunks that are entirely air (and unlit) can be stored as just a position
+// a Chunk is allocated for them the first time anything else is written
 class ChunkStorage
 {
 public:
 
+	// nullptr if there is no chunk (or only an air chunk) at the position
 	static inline ChunkPtr GetChunk(const glm::ivec3& cpos)
 	{
-		auto it = chunks_.find(cpos);
-		if (it != chunks_.end())
-			return it->second;
-		return nullptr;
+		return chunks_.Find(cpos);
 	}
 
 	static inline Block AtWorldC(const glm::ivec3& wpos)
 	{
 		ChunkHelpers::localpos w = ChunkHelpers::worldPosToLocalPos(wpos);
-		Chunk* cnk = chunks_[w.chunk_pos];
+		Chunk* cnk = chunks_.Find(w.chunk_pos);
 		if (cnk)
 			return cnk->BlockAt(w.block_pos);
 		return Block();
@@ -25,7 +26,7 @@ public:
 
 	static inline Block AtWorldD(const ChunkHelpers::localpos& p)
 	{
-		Chunk* cnk = chunks_[p.chunk_pos];
+		Chunk* cnk = chunks_.Find(p.chunk_pos);
 		if (cnk)
 			return cnk->BlockAt(p.block_pos);
 		return Block();
@@ -34,21 +35,164 @@ public:
 	static inline std::optional<Block> AtWorldE(const glm::ivec3& wpos)
 	{
 		ChunkHelpers::localpos w = ChunkHelpers::worldPosToLocalPos(wpos);
-		Chunk* cnk = chunks_[w.chunk_pos];
+		Chunk* cnk = chunks_.Find(w.chunk_pos);
 		if (cnk)
 			return cnk->BlockAt(w.block_pos);
+		if (IsAir(w.chunk_pos))
+			return Block();
 		return std::nullopt;
 	}
 
-	static inline auto& GetMapRaw()
+	// true if the chunk exists, but only as air without storage
+	static inline bool IsAir(const glm::ivec3& cpos)
+	{
+		return air_.Contains(cpos) && GetChunk(cpos) == nullptr;
+	}
+
+	static inline void MarkAir(const glm::ivec3& cpos)
+	{
+		air_.InsertOrAssign(cpos, true);
+	}
+
+	// allocates the chunk for a position, unless one is already there
+	static inline ChunkPtr Materialize(const glm::ivec3& cpos)
+	{
+		if (ChunkPtr cnk = GetChunk(cpos))
+			return cnk;
+		ChunkPtr cnk = new Chunk();
+		cnk->SetPos(cpos);
+		// an air chunk was generated (and has nothing to light), it just had no storage
+		if (air_.Contains(cpos))
+			cnk->SetState(ChunkState::Lit);
+		std::lock_guard lk(linkMtx_);
+		auto [winner, inserted] = chunks_.TryEmplace(cpos, cnk);
+		if (!inserted) // another thread got there first
+		{
+			delete cnk;
+			return winner;
+		}
+		air_.Erase(cpos);
+		link(cnk);
+		return cnk;
+	}
+
+	// adds a chunk at its position, replacing (and returning) any chunk that was there
+	static inline ChunkPtr Insert(ChunkPtr chunk)
+	{
+		std::lock_guard lk(linkMtx_);
+		ChunkPtr old = chunks_.Erase(chunk->GetPos());
+		if (old)
+			unlink(old);
+		chunks_.InsertOrAssign(chunk->GetPos(), chunk);
+		air_.Erase(chunk->GetPos());
+		link(chunk);
+		return old;
+	}
+
+	// removes the chunk at a position without deleting it
+	static inline ChunkPtr Remove(const glm::ivec3& cpos)
+	{
+		std::lock_guard lk(linkMtx_);
+		ChunkPtr chunk = chunks_.Erase(cpos);
+		if (chunk)
+			unlink(chunk);
+		return chunk;
+	}
+
+	// removes (without deleting) every chunk for which pred(cpos, chunk) returns true
+	template<typename Pred>
+	static inline void RemoveIf(Pred&& pred)
+	{
+		std::lock_guard lk(linkMtx_);
+		std::vector<ChunkPtr> removed;
+		chunks_.EraseIf([&](const glm::ivec3& cpos, ChunkPtr chunk)
+		{
+			if (!pred(cpos, chunk))
+				return false;
+			removed.push_back(chunk);
+			return true;
+		});
+		for (ChunkPtr chunk : removed)
+			unlink(chunk);
+	}
+
+	// removes every chunk (and air chunk), deleting the chunks
+	static inline void Clear()
+	{
+		std::lock_guard lk(linkMtx_);
+		chunks_.ForEach([](const glm::ivec3&, ChunkPtr chunk)
+		{
+			delete chunk;
+		});
+		chunks_.Clear();
+		air_.Clear();
+	}
+
+	// chunks can only be added and removed through ChunkStorage, which keeps their neighbors linked
+	static inline const ConcurrentChunkMap<ChunkPtr>& GetMapRaw()
 	{
 		return chunks_;
 	}
 
+	// a block position that remembers its chunk, so stepping to an adjacent block
+	// only needs a neighbor pointer instead of a map lookup
+	struct Cursor
+	{
+		ChunkPtr chunk; // null if the chunk is unallocated (air) or missing
+		glm::ivec3 cpos;
+		glm::ivec3 lpos;
+
+		glm::ivec3 WorldPos() const { return cpos * Chunk::CHUNK_SIZE + lpos; }
+	};
+
+	static inline Cursor CursorAt(const glm::ivec3& wpos)
+	{
+		ChunkHelpers::localpos w = ChunkHelpers::worldPosToLocalPos(wpos);
+		return { GetChunk(w.chunk_pos), w.chunk_pos, w.block_pos };
+	}
+
+	// the cursor moved by dir (components in [-1, 1])
+	static inline Cursor Step(const Cursor& c, const glm::ivec3& dir)
+	{
+		glm::ivec3 lpos = c.lpos + dir;
+		glm::ivec3 cdir = glm::ivec3(glm::greaterThanEqual(lpos, glm::ivec3(Chunk::CHUNK_SIZE))) -
+			glm::ivec3(glm::lessThan(lpos, glm::ivec3(0)));
+		if (cdir == glm::ivec3(0))
+			return { c.chunk, c.cpos, lpos };
+
+		glm::ivec3 cpos = c.cpos + cdir;
+		ChunkPtr chunk = c.chunk ? c.chunk->Neighbor(cdir) : GetChunk(cpos);
+		return { chunk, cpos, lpos - cdir * Chunk::CHUNK_SIZE };
+	}
+
+	// same as AtWorldE
+	// a cursor without a chunk looks again, in case the chunk was allocated since
+	static inline std::optional<Block> At(const Cursor& c)
+	{
+		if (ChunkPtr chunk = c.chunk ? c.chunk : GetChunk(c.cpos))
+			return chunk->BlockAt(c.lpos);
+		if (IsAir(c.cpos))
+			return Block();
+		return std::nullopt;
+	}
+
+	// same as SetLight, the cursor is updated if its chunk had to be allocated
+	static inline void SetLight(Cursor& c, Light l)
+	{
+		if (!c.chunk)
+			c.chunk = GetChunk(c.cpos);
+		if (!c.chunk && IsAir(c.cpos) && !(l == Light()))
+			c.chunk = Materialize(c.cpos);
+		if (c.chunk)
+			c.chunk->SetLightAt(c.lpos, l);
+	}
+
 	static inline bool SetBlock(const glm::ivec3& wpos, Block b)
 	{
 		ChunkHelpers::localpos w = ChunkHelpers::worldPosToLocalPos(wpos);
-		Chunk* cnk = chunks_[w.chunk_pos];
+		Chunk* cnk = chunks_.Find(w.chunk_pos);
+		if (!cnk && IsAir(w.chunk_pos) && !(b.GetType() == BlockType::bAir && b.GetLight() == Light()))
+			cnk = Materialize(w.chunk_pos);
 		if (cnk)
 		{
 			cnk->SetBlockTypeAt(w.block_pos, b.GetType());
@@ -60,7 +204,9 @@ public:
 	static inline bool SetBlockType(const glm::ivec3& wpos, BlockType bt)
 	{
 		ChunkHelpers::localpos w = ChunkHelpers::worldPosToLocalPos(wpos);
-		Chunk* cnk = chunks_[w.chunk_pos];
+		Chunk* cnk = chunks_.Find(w.chunk_pos);
+		if (!cnk && IsAir(w.chunk_pos) && bt != BlockType::bAir)
+			cnk = Materialize(w.chunk_pos);
 		if (cnk)
 		{
 			cnk->SetBlockTypeAt(w.block_pos, bt);
@@ -71,7 +217,9 @@ public:
 	static inline bool SetLight(const glm::ivec3& wpos, Light l)
 	{
 		ChunkHelpers::localpos w = ChunkHelpers::worldPosToLocalPos(wpos);
-		Chunk* cnk = chunks_[w.chunk_pos];
+		Chunk* cnk = chunks_.Find(w.chunk_pos);
+		if (!cnk && IsAir(w.chunk_pos) && !(l == Light()))
+			cnk = Materialize(w.chunk_pos);
 		if (cnk)
 		{
 			cnk->SetLightAt(w.block_pos, l);
@@ -80,6 +228,34 @@ public:
 	}
 
 private:
-	static inline Concurrency::concurrent_unordered_map // TODO: make CustomGrow(tm) concurrent map solution for portability
-		<glm::ivec3, Chunk*, Utils::ivec3Hash> chunks_;
+	static inline ConcurrentChunkMap<ChunkPtr> chunks_;
+
+	// positions of all-air chunks without storage
+	static inline ConcurrentChunkMap<bool> air_;
+
+	// links a newly inserted chunk and the chunks around it to each other
+	static inline void link(ChunkPtr chunk)
+	{
+		for (int i = 0; i < 26; i++)
+		{
+			ChunkPtr adjacent = chunks_.Find(chunk->GetPos() + ChunkHelpers::neighbors[i]);
+			chunk->neighbors_[i].store(adjacent, std::memory_order_release);
+			if (adjacent)
+				adjacent->neighbors_[ChunkHelpers::neighborIndex(-ChunkHelpers::neighbors[i])].store(chunk, std::memory_order_release);
+		}
+	}
+
+	// clears the pointers to a removed chunk from the chunks around it
+	static inline void unlink(ChunkPtr chunk)
+	{
+		for (int i = 0; i < 26; i++)
+		{
+			ChunkPtr adjacent = chunk->neighbors_[i].exchange(nullptr, std::memory_order_acq_rel);
+			if (adjacent)
+				adjacent->neighbors_[ChunkHelpers::neighborIndex(-ChunkHelpers::neighbors[i])].store(nullptr, std::memory_order_release);
+		}
+	}
+
+	// inserting or removing a chunk and (un)linking its neighbors happens as one step
+	static inline std::mutex linkMtx_;
 };
\ No newline at end of file
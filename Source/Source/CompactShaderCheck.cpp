@@ -0,0 +1,162 @@
+#include "stdafx.h"
+#include "CompactShaderCheck.h"
+#include "ChunkHelpers.h"
+#include <Vertices.h>
+#include <fstream>
+#include <sstream>
+#include <random>
+
+
+namespace CompactShaderCheck
+{
+	namespace
+	{
+		// the outputs both chunk shaders write, captured interleaved
+		const char* varyings[] = { "vPos", "vNormal", "vTexCoord", "vLighting", "vBlockPos" };
+		constexpr int FloatsPerVertex = 3 + 3 + 3 + 4 + 3;
+
+		// records before the first quad, see chunk_compact.vs
+		constexpr int ReservedRecords = 2;
+
+		// a program of just the vertex shader, with its outputs captured
+		GLuint captureProgram(const char* name)
+		{
+			std::ifstream is(std::string("./resources/Shaders/") + name);
+			std::stringstream ss;
+			ss << is.rdbuf();
+			std::string source = ss.str();
+			if (source.empty())
+				return 0;
+
+			const char* src = source.c_str();
+			GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+			glShaderSource(vs, 1, &src, nullptr);
+			glCompileShader(vs);
+			GLuint program = glCreateProgram();
+			glAttachShader(program, vs);
+			glTransformFeedbackVaryings(program, GLsizei(std::size(varyings)), varyings, GL_INTERLEAVED_ATTRIBS);
+			glLinkProgram(program);
+			glDeleteShader(vs);
+
+			GLint linked = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &linked);
+			if (!linked)
+			{
+				glDeleteProgram(program);
+				return 0;
+			}
+			return program;
+		}
+
+		// draws a point per vertex without rasterizing, and reads back what the program wrote
+		std::vector<float> capture(GLuint program, GLuint vao, GLsizei vertices)
+		{
+			GLsizeiptr bytes = GLsizeiptr(vertices) * FloatsPerVertex * sizeof(float);
+			GLuint feedback;
+			glCreateBuffers(1, &feedback);
+			glNamedBufferStorage(feedback, bytes, nullptr, 0);
+
+			glUseProgram(program);
+			glBindVertexArray(vao);
+			glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, feedback);
+			glEnable(GL_RASTERIZER_DISCARD);
+			glBeginTransformFeedback(GL_POINTS);
+			glDrawArrays(GL_POINTS, 0, vertices);
+			glEndTransformFeedback();
+			glDisable(GL_RASTERIZER_DISCARD);
+
+			std::vector<float> ret(size_t(vertices) * FloatsPerVertex);
+			glGetNamedBufferSubData(feedback, 0, bytes, ret.data());
+			glDeleteBuffers(1, &feedback);
+			return ret;
+		}
+	}
+
+
+	Result Run(int quads)
+	{
+		Result ret;
+		GLuint compact = captureProgram("chunk_compact.vs");
+		GLuint optimized = captureProgram("chunk_optimized.vs");
+		if (!compact || !optimized)
+		{
+			glDeleteProgram(compact);
+			glDeleteProgram(optimized);
+			return ret;
+		}
+
+		// the same random quads as records and as expanded vertices
+		std::mt19937 rng(13);
+		std::vector<glm::uvec2> records(ReservedRecords, glm::uvec2(0));
+		std::vector<GLuint> vertices;
+		records.reserve(ReservedRecords + quads);
+		vertices.reserve(size_t(quads) * 12);
+		for (int i = 0; i < quads; i++)
+		{
+			glm::uvec3 lpos(rng() % 32, rng() % 32, rng() % 32);
+			GLuint face = rng() % 6;
+			GLuint texIdx = rng() % 512;
+			Light light;
+			light.Raw() = uint16_t(rng());
+			int ao[4] = { int(rng() % 4), int(rng() % 4), int(rng() % 4), int(rng() % 4) };
+			int w = rng() % 32 + 1;
+			int h = rng() % 32 + 1;
+
+			GLuint expanded[12];
+			ChunkHelpers::ExpandQuad(lpos, face, texIdx, light, ao, w, h, expanded);
+			vertices.insert(vertices.end(), std::begin(expanded), std::end(expanded));
+			records.push_back(ChunkHelpers::EncodeQuad(lpos, face, texIdx, light, ao, w, h));
+		}
+
+		GLuint buffers[2];
+		glCreateBuffers(2, buffers);
+		glNamedBufferStorage(buffers[0], records.size() * sizeof(glm::uvec2), records.data(), 0);
+		glNamedBufferStorage(buffers[1], vertices.size() * sizeof(GLuint), vertices.data(), 0);
+
+		// the chunk position is per instance in the game, here it's the same constant for every vertex
+		GLuint vaos[2];
+		glCreateVertexArrays(2, vaos);
+		glVertexArrayVertexBuffer(vaos[1], 0, buffers[1], 0, 2 * sizeof(GLuint));
+		for (GLuint attrib : { 0u, 1u })
+		{
+			glEnableVertexArrayAttrib(vaos[1], attrib);
+			glVertexArrayAttribIFormat(vaos[1], attrib, 1, GL_UNSIGNED_INT, attrib * sizeof(GLuint));
+			glVertexArrayAttribBinding(vaos[1], attrib, 0);
+		}
+		glVertexAttribI4i(2, 3, -2, 5, 0);
+
+		glm::mat4 viewProj(1);
+		for (GLuint program : { compact, optimized })
+			glProgramUniformMatrix4fv(program, glGetUniformLocation(program, "u_viewProj"), 1, GL_FALSE, &viewProj[0][0]);
+		glProgramUniform1fv(compact, glGetUniformLocation(compact, "u_cubeCorners"), 72, Vertices::cube_light);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[0]);
+
+		GLsizei count = GLsizei(quads) * 6;
+		std::vector<float> fromRecords = capture(compact, vaos[0], count);
+		std::vector<float> fromVertices = capture(optimized, vaos[1], count);
+
+		glBindVertexArray(0);
+		glUseProgram(0);
+		glDeleteVertexArrays(2, vaos);
+		glDeleteBuffers(2, buffers);
+		glDeleteProgram(compact);
+		glDeleteProgram(optimized);
+
+		ret.ran = true;
+		ret.vertices = count;
+		for (size_t v = 0; v < size_t(count); v++)
+		{
+			const float* a = fromRecords.data() + v * FloatsPerVertex;
+			const float* b = fromVertices.data() + v * FloatsPerVertex;
+			for (int f = 0; f < FloatsPerVertex; f++)
+			{
+				if (std::abs(a[f] - b[f]) > 1e-4f)
+				{
+					ret.mismatched++;
+					break;
+				}
+			}
+		}
+		return ret;
+	}
+}
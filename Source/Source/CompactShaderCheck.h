@@ -0,0 +1,19 @@
+#pragma once
+
+// checks on the GPU that chunk_compact.vs expands quad records (ChunkHelpers::EncodeQuad) to the same
+// vertices chunk_optimized.vs makes of their ExpandQuad output, by capturing the outputs of both
+// with transform feedback, needs a GL context
+namespace CompactShaderCheck
+{
+	struct Result
+	{
+		bool ran = false;      // false if a shader couldn't be read or built
+		size_t vertices = 0;
+		size_t mismatched = 0; // vertices with any output that differs
+
+		bool Passed() const { return ran && mismatched == 0; }
+	};
+
+	// on random quads, with every field at every value it can take
+	Result Run(int quads);
+}
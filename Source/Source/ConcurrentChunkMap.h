@@ -0,0 +1,95 @@
+#pragma once
+#include "Epoch.h"
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+
+// sharded open-addressing (linear probing) hash map from chunk position to V
+// V must be trivially copyable (e.g. a pointer), and V{} means "no value"
+// - Find is lock-free: slots are published with release stores, and a table that
+//   gets replaced is retired (see Epoch) instead of freed
+// - TryEmplace, InsertOrAssign and Erase lock a single shard
+// - ForEach is safe to call while other threads modify the map; it sees every
+//   element that is present for the whole call
+// a slot's key is written once (before the slot is published) and never changes
+// within one table, so readers can't see a torn key; an erased slot can only be
+// reused for the same key, and erased slots are dropped when the shard is rehashed
+template<typename V>
+class ConcurrentChunkMap
+{
+public:
+	ConcurrentChunkMap();
+	ConcurrentChunkMap(const ConcurrentChunkMap&) = delete;
+	ConcurrentChunkMap& operator=(const ConcurrentChunkMap&) = delete;
+
+	// V{} if the key is not present
+	V Find(const glm::ivec3& key) const;
+	bool Contains(const glm::ivec3& key) const;
+
+	// inserts if the key is not present
+	// returns the value now associated with the key, and whether it was inserted
+	std::pair<V, bool> TryEmplace(const glm::ivec3& key, V value);
+	void InsertOrAssign(const glm::ivec3& key, V value);
+
+	// returns the erased value, or V{} if the key was not present
+	V Erase(const glm::ivec3& key);
+
+	// fn(const glm::ivec3& key, V value)
+	template<typename Fn>
+	void ForEach(Fn&& fn) const;
+
+	// erases every element for which pred(key, value) returns true
+	template<typename Pred>
+	size_t EraseIf(Pred&& pred);
+
+	void Clear();
+	size_t Size() const;
+
+	static constexpr unsigned ShardCount = 64;
+
+private:
+	enum : uint8_t { Empty, Full, Erased };
+
+	struct Slot
+	{
+		std::atomic<uint8_t> state = Empty;
+		glm::ivec3 key;
+		std::atomic<V> value;
+	};
+
+	struct Table
+	{
+		Table(size_t capacity) : mask(capacity - 1), slots(std::make_unique<Slot[]>(capacity)) {}
+		size_t mask; // capacity - 1, capacity is a power of two
+		std::unique_ptr<Slot[]> slots;
+	};
+
+	struct alignas(64) Shard
+	{
+		mutable std::mutex mtx;
+		std::atomic<const Table*> table = nullptr;
+		std::atomic<size_t> count = 0; // full slots
+		size_t used = 0; // full + erased slots
+		std::unique_ptr<Table> owned;
+	};
+
+	static uint64_t hash(const glm::ivec3& key);
+	Shard& shardFor(uint64_t h) { return shards_[h >> (64 - ShardBits)]; }
+	const Shard& shardFor(uint64_t h) const { return shards_[h >> (64 - ShardBits)]; }
+
+	// the following must be called while holding the shard lock
+	// findSlot returns the full slot for the key, or sets erased to a dead slot that held it
+	Slot* findSlot(const Shard& shard, const glm::ivec3& key, uint64_t h, Slot** erased = nullptr) const;
+	void insertNew(Shard& shard, const glm::ivec3& key, V value, uint64_t h, Slot* erased = nullptr);
+	void eraseSlot(Shard& shard, Slot& slot);
+	void rehash(Shard& shard, size_t capacity);
+
+	static constexpr unsigned ShardBits = 6;
+	static_assert((1u << ShardBits) == ShardCount);
+	static constexpr size_t InitialCapacity = 16;
+
+	Shard shards_[ShardCount];
+};
+
+#include "ConcurrentChunkMap.inl"
@@ -0,0 +1,249 @@
+#pragma once
+#include "ConcurrentChunkMap.h"
+
+template<typename V>
+ConcurrentChunkMap<V>::ConcurrentChunkMap()
+{
+	for (auto& shard : shards_)
+	{
+		shard.owned = std::make_unique<Table>(InitialCapacity);
+		shard.table.store(shard.owned.get());
+	}
+}
+
+template<typename V>
+inline uint64_t ConcurrentChunkMap<V>::hash(const glm::ivec3& key)
+{
+	// mix the components, then spread the bits (fibonacci hashing)
+	// the top bits pick the shard and the low bits pick the slot
+	uint64_t h = uint64_t(uint32_t(key.x)) * 73856093u ^
+		uint64_t(uint32_t(key.y)) * 19349663u ^
+		uint64_t(uint32_t(key.z)) * 83492791u;
+	h *= 0x9E3779B97F4A7C15ull;
+	return h ^ (h >> 29);
+}
+
+template<typename V>
+V ConcurrentChunkMap<V>::Find(const glm::ivec3& key) const
+{
+	uint64_t h = hash(key);
+	const Shard& shard = shardFor(h);
+	Epoch::Guard guard;
+
+	const Table* table = shard.table.load();
+	for (size_t i = h & table->mask, n = 0; n <= table->mask; i = (i + 1) & table->mask, n++)
+	{
+		const Slot& slot = table->slots[i];
+		uint8_t state = slot.state.load(std::memory_order_acquire);
+		if (state == Empty)
+			break;
+		// erased slots keep their key, but the key may have been inserted again further along
+		if (state == Full && slot.key == key)
+			return slot.value.load(std::memory_order_acquire);
+	}
+	return V{};
+}
+
+template<typename V>
+inline bool ConcurrentChunkMap<V>::Contains(const glm::ivec3& key) const
+{
+	return Find(key) != V{};
+}
+
+template<typename V>
+std::pair<V, bool> ConcurrentChunkMap<V>::TryEmplace(const glm::ivec3& key, V value)
+{
+	uint64_t h = hash(key);
+	Shard& shard = shardFor(h);
+	std::lock_guard lk(shard.mtx);
+
+	Slot* erased = nullptr;
+	if (Slot* slot = findSlot(shard, key, h, &erased))
+		return { slot->value.load(std::memory_order_relaxed), false };
+	insertNew(shard, key, value, h, erased);
+	return { value, true };
+}
+
+template<typename V>
+void ConcurrentChunkMap<V>::InsertOrAssign(const glm::ivec3& key, V value)
+{
+	uint64_t h = hash(key);
+	Shard& shard = shardFor(h);
+	std::lock_guard lk(shard.mtx);
+
+	Slot* erased = nullptr;
+	if (Slot* slot = findSlot(shard, key, h, &erased))
+		slot->value.store(value, std::memory_order_release);
+	else
+		insertNew(shard, key, value, h, erased);
+}
+
+template<typename V>
+V ConcurrentChunkMap<V>::Erase(const glm::ivec3& key)
+{
+	uint64_t h = hash(key);
+	Shard& shard = shardFor(h);
+	std::lock_guard lk(shard.mtx);
+
+	Slot* slot = findSlot(shard, key, h);
+	if (!slot)
+		return V{};
+	V ret = slot->value.load(std::memory_order_relaxed);
+	eraseSlot(shard, *slot);
+	return ret;
+}
+
+template<typename V>
+template<typename Fn>
+void ConcurrentChunkMap<V>::ForEach(Fn&& fn) const
+{
+	for (const auto& shard : shards_)
+	{
+		Epoch::Guard guard;
+		const Table* table = shard.table.load();
+		for (size_t i = 0; i <= table->mask; i++)
+		{
+			const Slot& slot = table->slots[i];
+			if (slot.state.load(std::memory_order_acquire) == Full)
+				fn(slot.key, slot.value.load(std::memory_order_acquire));
+		}
+	}
+}
+
+template<typename V>
+template<typename Pred>
+size_t ConcurrentChunkMap<V>::EraseIf(Pred&& pred)
+{
+	size_t erased = 0;
+	for (auto& shard : shards_)
+	{
+		std::lock_guard lk(shard.mtx);
+		Table& table = *shard.owned;
+		for (size_t i = 0; i <= table.mask; i++)
+		{
+			Slot& slot = table.slots[i];
+			if (slot.state.load(std::memory_order_relaxed) == Full &&
+				pred(slot.key, slot.value.load(std::memory_order_relaxed)))
+			{
+				eraseSlot(shard, slot);
+				erased++;
+			}
+		}
+	}
+	return erased;
+}
+
+template<typename V>
+void ConcurrentChunkMap<V>::Clear()
+{
+	for (auto& shard : shards_)
+	{
+		std::lock_guard lk(shard.mtx);
+		rehash(shard, 0);
+	}
+}
+
+template<typename V>
+size_t ConcurrentChunkMap<V>::Size() const
+{
+	size_t ret = 0;
+	for (const auto& shard : shards_)
+		ret += shard.count.load(std::memory_order_relaxed);
+	return ret;
+}
+
+template<typename V>
+typename ConcurrentChunkMap<V>::Slot* ConcurrentChunkMap<V>::findSlot(
+	const Shard& shard, const glm::ivec3& key, uint64_t h, Slot** erased) const
+{
+	Table& table = *shard.owned;
+	for (size_t i = h & table.mask, n = 0; n <= table.mask; i = (i + 1) & table.mask, n++)
+	{
+		Slot& slot = table.slots[i];
+		uint8_t state = slot.state.load(std::memory_order_relaxed);
+		if (state == Empty)
+			break;
+		if (slot.key == key)
+		{
+			if (state == Full)
+				return &slot;
+			if (erased)
+				*erased = &slot;
+		}
+	}
+	return nullptr;
+}
+
+template<typename V>
+void ConcurrentChunkMap<V>::insertNew(Shard& shard, const glm::ivec3& key, V value, uint64_t h, Slot* erased)
+{
+	// a slot that held the same key can come back to life, since readers never see its key change
+	// (chunks that are unloaded and loaded again don't fill the table with erased slots)
+	if (erased)
+	{
+		erased->value.store(value, std::memory_order_relaxed);
+		erased->state.store(Full, std::memory_order_release);
+		shard.count.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// keep the load (including erased slots) at or below 3/4
+	// grow if the live elements alone would pass 1/2, otherwise just drop erased slots
+	size_t capacity = shard.owned->mask + 1;
+	if ((shard.used + 1) * 4 > capacity * 3)
+		rehash(shard, (shard.count + 1) * 2 > capacity ? capacity * 2 : capacity);
+
+	Table& table = *shard.owned;
+	size_t i = h & table.mask;
+	while (table.slots[i].state.load(std::memory_order_relaxed) != Empty)
+		i = (i + 1) & table.mask;
+
+	Slot& slot = table.slots[i];
+	slot.key = key;
+	slot.value.store(value, std::memory_order_relaxed);
+	slot.state.store(Full, std::memory_order_release); // publishes the key and value
+	shard.used++;
+	shard.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename V>
+void ConcurrentChunkMap<V>::eraseSlot(Shard& shard, Slot& slot)
+{
+	slot.value.store(V{}, std::memory_order_release);
+	slot.state.store(Erased, std::memory_order_release);
+	shard.count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// copies the live elements to a new table (capacity 0 means empty, at the initial size)
+template<typename V>
+void ConcurrentChunkMap<V>::rehash(Shard& shard, size_t capacity)
+{
+	auto table = std::make_unique<Table>(capacity ? capacity : InitialCapacity);
+	size_t count = 0;
+	if (capacity)
+	{
+		const Table& old = *shard.owned;
+		for (size_t i = 0; i <= old.mask; i++)
+		{
+			const Slot& src = old.slots[i];
+			if (src.state.load(std::memory_order_relaxed) != Full)
+				continue;
+
+			size_t j = hash(src.key) & table->mask;
+			while (table->slots[j].state.load(std::memory_order_relaxed) != Empty)
+				j = (j + 1) & table->mask;
+			Slot& dst = table->slots[j];
+			dst.key = src.key;
+			dst.value.store(src.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			dst.state.store(Full, std::memory_order_relaxed);
+			count++;
+		}
+	}
+
+	shard.table.store(table.get());
+	size_t bytes = (shard.owned->mask + 1) * sizeof(Slot);
+	Epoch::Retire(std::move(shard.owned), bytes);
+	shard.owned = std::move(table);
+	shard.used = count;
+	shard.count.store(count, std::memory_order_relaxed);
+}
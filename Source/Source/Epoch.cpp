@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "Epoch.h"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace Epoch
+{
+	namespace
+	{
+		struct Retired
+		{
+			uint64_t epoch; // the epoch it was retired in
+			size_t bytes;
+			std::shared_ptr<void> object;
+		};
+
+		struct Registry
+		{
+			std::mutex mtx;
+			std::vector<Record*> records; // never freed, threads that exit leave theirs for the next one
+			std::deque<Retired> retired;  // oldest first
+		};
+
+		// never destroyed, so threads that exit after static destruction can still give back their record
+		Registry& registry()
+		{
+			static Registry* r = new Registry;
+			return *r;
+		}
+
+		std::atomic<size_t> pendingBytes = 0;
+	}
+
+
+	Local::~Local()
+	{
+		if (!record)
+			return;
+		std::lock_guard lk(registry().mtx);
+		record->used = false;
+	}
+
+
+	Record* AcquireRecord()
+	{
+		Registry& r = registry();
+		std::lock_guard lk(r.mtx);
+		for (Record* record : r.records)
+		{
+			if (!record->used)
+			{
+				record->used = true;
+				return record;
+			}
+		}
+		r.records.push_back(new Record);
+		r.records.back()->used = true;
+		return r.records.back();
+	}
+
+
+	// readers that enter after the epoch is advanced here can't have seen the object,
+	// so it only waits for the ones marked with this epoch or an older one
+	void Retire(std::shared_ptr<void> object, size_t bytes)
+	{
+		{
+			Registry& r = registry();
+			std::lock_guard lk(r.mtx);
+			r.retired.push_back({ current.fetch_add(1), bytes, std::move(object) });
+		}
+		pendingBytes += bytes;
+		Collect();
+	}
+
+
+	void Collect()
+	{
+		std::vector<Retired> freed;
+		{
+			Registry& r = registry();
+			std::lock_guard lk(r.mtx);
+			if (r.retired.empty())
+				return;
+
+			// a reader that hasn't marked its record yet will load the pointers that replaced these
+			uint64_t oldest = current.load();
+			for (const Record* record : r.records)
+				oldest = std::min(oldest, record->epoch.load());
+			while (!r.retired.empty() && r.retired.front().epoch < oldest)
+			{
+				pendingBytes -= r.retired.front().bytes;
+				freed.push_back(std::move(r.retired.front()));
+				r.retired.pop_front();
+			}
+		}
+		// destroyed without the lock held
+	}
+
+
+	size_t PendingBytes()
+	{
+		return pendingBytes;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// epoch based reclamation, for storage that lock-free readers may still be looking at
+// a reader marks its thread with the current epoch for as long as it reads (Guard), which
+// only writes memory owned by that thread, and a writer hands storage it replaced to Retire
+// instead of freeing it. the storage is freed once every thread that was reading when it
+// was retired is done, no matter how many readers started after that
+// a reader must enter the guard before it loads the pointer to the storage, and a writer
+// must store the new pointer before it retires the old storage
+namespace Epoch
+{
+	constexpr uint64_t Idle = UINT64_MAX; // the epoch of a thread that isn't reading
+
+	struct alignas(64) Record
+	{
+		std::atomic<uint64_t> epoch = Idle;
+		bool used = false; // by a live thread (only with the registry lock held)
+	};
+
+	// the calling thread's record, and how many guards it is in
+	struct Local
+	{
+		Record* record = nullptr;
+		int depth = 0;
+		~Local();
+	};
+
+	inline std::atomic<uint64_t> current = 1;
+	inline thread_local Local local;
+	Record* AcquireRecord();
+
+	// keeps everything retired while it is alive from being freed
+	// guards nest, only the outermost one of a thread touches its record
+	class Guard
+	{
+	public:
+		Guard()
+		{
+			if (local.depth++ > 0)
+				return;
+			if (!local.record)
+				local.record = AcquireRecord();
+			local.record->epoch.store(current.load());
+		}
+		~Guard()
+		{
+			if (--local.depth == 0)
+				local.record->epoch.store(Idle, std::memory_order_release);
+		}
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+	};
+
+	// frees the object once no reader can be using it
+	// bytes is the heap memory it owns, reported until then by PendingBytes
+	void Retire(std::shared_ptr<void> object, size_t bytes);
+	template<typename T>
+	void Retire(T&& object, size_t bytes)
+	{
+		Retire(std::shared_ptr<void>(std::make_shared<std::decay_t<T>>(std::forward<T>(object))), bytes);
+	}
+
+	// frees the retired objects no reader can be using anymore
+	// Retire collects too, this is for the objects still left once the writers stop (called every frame)
+	void Collect();
+
+	size_t PendingBytes();
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "block.h"
+#include <array>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// decides which block faces get meshed, a whole row of blocks at a time
+// a row is a bitmask with one bit per block, so the faces of 32 blocks come
+// out of a few shifts and ANDs with the neighboring rows
+namespace FaceMask
+{
+	// whether the face of block b that touches block n is meshed (up: the face points up)
+	constexpr bool Emits(BlockType b, BlockType n, bool up)
+	{
+		// invisible blocks have no faces
+		if (VisibilityOf(b) == Visibility::Invisible)
+			return false;
+		bool bWater = b == BlockType::bWater;
+		bool nWater = n == BlockType::bWater;
+		// the top of water (under anything but water), and anything next to a see-through block
+		if ((bWater && !nWater && up) || VisibilityOf(n) > Visibility::Opaque)
+			return true;
+		// other block isn't air or water
+		if (n != BlockType::bAir && !nWater)
+			return false;
+		// both blocks are water
+		if (bWater && nWater)
+			return false;
+		return true;
+	}
+
+	constexpr size_t TypeCount = size_t(BlockType::bCount);
+
+	// Emits for every pair of types, indexed [up][b][n]
+	inline constexpr auto EmitTable = []
+	{
+		std::array<std::array<std::array<bool, TypeCount>, TypeCount>, 2> table{};
+		for (size_t up = 0; up < 2; up++)
+			for (size_t b = 0; b < TypeCount; b++)
+				for (size_t n = 0; n < TypeCount; n++)
+					table[up][b][n] = Emits(BlockType(b), BlockType(n), up);
+		return table;
+	}();
+
+	// the row masks a block type sets a bit in
+	enum Class : uint8_t
+	{
+		Visible = 1 << 0, // has faces
+		Occluder = 1 << 1, // hides the faces of blocks next to it (opaque, but not water)
+		Water = 1 << 2,
+	};
+
+	inline constexpr auto ClassTable = []
+	{
+		std::array<uint8_t, TypeCount> table{};
+		for (size_t i = 0; i < TypeCount; i++)
+		{
+			BlockType t = BlockType(i);
+			if (VisibilityOf(t) != Visibility::Invisible)
+				table[i] |= Visible;
+			if (VisibilityOf(t) == Visibility::Opaque && t != BlockType::bWater)
+				table[i] |= Occluder;
+			if (t == BlockType::bWater)
+				table[i] |= Water;
+		}
+		return table;
+	}();
+
+	// the faces of a row of blocks, given the masks of the row and of the blocks they face
+	template<typename Mask>
+	constexpr Mask Faces(Mask visible, Mask water, Mask nearOccluder, Mask nearWater, bool up)
+	{
+		Mask solid = visible & ~water;
+		return (solid & ~nearOccluder) | (water & ~nearWater & (up ? ~Mask(0) : ~nearOccluder));
+	}
+
+	// the masks have to agree with the table for every pair of types
+	constexpr bool facesMatchTable()
+	{
+		for (size_t up = 0; up < 2; up++)
+		{
+			for (size_t b = 0; b < TypeCount; b++)
+			{
+				for (size_t n = 0; n < TypeCount; n++)
+				{
+					unsigned cb = ClassTable[b], cn = ClassTable[n];
+					unsigned face = Faces<unsigned>(
+						(cb & Visible) != 0, (cb & Water) != 0, (cn & Occluder) != 0, (cn & Water) != 0, up);
+					if ((face & 1) != unsigned(EmitTable[up][b][n]))
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+	static_assert(facesMatchTable(), "face masks don't follow the emission rules");
+
+	inline int BitCount(uint32_t mask)
+	{
+#ifdef _MSC_VER
+		return int(__popcnt(mask));
+#else
+		return __builtin_popcount(mask);
+#endif
+	}
+
+	// index of the lowest set bit (mask must not be 0)
+	inline int LowestBit(uint32_t mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return int(index);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+}
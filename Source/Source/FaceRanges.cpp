@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "FaceRanges.h"
+
+
+namespace FaceRanges
+{
+	uint8_t FacingDirections(const AABB16& box, const glm::vec3& pos)
+	{
+		uint8_t dirs = 0;
+		dirs |= (pos.z > box.min.z) << 0; // far (+z)
+		dirs |= (pos.z < box.max.z) << 1; // near (-z)
+		dirs |= (pos.x < box.max.x) << 2; // left (-x)
+		dirs |= (pos.x > box.min.x) << 3; // right (+x)
+		dirs |= (pos.y > box.min.y) << 4; // top (+y)
+		dirs |= (pos.y < box.max.y) << 5; // bottom (-y)
+		return dirs;
+	}
+
+
+	int Commands(const AllocInfo& info, GLuint offset, const glm::vec3& viewpos,
+		GLuint vertexSize, GLuint verticesPerRecord, DrawArraysIndirectCommand* out)
+	{
+		GLuint firstRecord = offset / vertexSize;
+		uint8_t facing = FacingDirections(info.box, viewpos);
+
+		// one draw per run of facing directions, empty directions don't end a run
+		int count = 0;
+		GLuint runBegin = 0;
+		GLuint runEnd = 0;
+		for (int face = 0; face < 6; face++)
+		{
+			GLuint begin = face == 0 ? 0 : info.faceEnds[face - 1];
+			GLuint end = info.faceEnds[face];
+			if (begin == end)
+				continue;
+			if (facing >> face & 1)
+			{
+				if (runBegin == runEnd)
+					runBegin = begin;
+				runEnd = end;
+				continue;
+			}
+			if (runBegin != runEnd)
+			{
+				out[count++] = { (runEnd - runBegin) * verticesPerRecord, 1, (firstRecord + runBegin) * verticesPerRecord, firstRecord };
+				runBegin = runEnd = 0;
+			}
+		}
+		if (runBegin != runEnd)
+			out[count++] = { (runEnd - runBegin) * verticesPerRecord, 1, (firstRecord + runBegin) * verticesPerRecord, firstRecord };
+		return count;
+	}
+}
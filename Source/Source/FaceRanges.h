@@ -0,0 +1,31 @@
+#pragma once
+#include <Shapes.h>
+#include <dib.h>
+
+// chunk meshes are sorted by face direction, and the allocator keeps where each direction ends,
+// so draws can leave out the directions that point away from the camera
+// compact_batch.cs does this on the GPU, these are the same rules on the CPU
+namespace FaceRanges
+{
+	// what the chunk allocators keep about each allocation, laid out like InDrawInfo's userdata in compact_batch.cs
+	struct AllocInfo
+	{
+		AABB16 box;
+		// where the records of each direction (ChunkHelpers::faces order) end, counted after the header
+		// direction i is [faceEnds[i - 1], faceEnds[i]), starting at 0
+		GLuint faceEnds[6];
+		GLuint _pad[2]; // GPU padding
+	};
+
+	// most draws an allocation can be split into: the facing directions leave at most 3 runs
+	constexpr int MaxDraws = 3;
+
+	// bit i is set if faces pointing along ChunkHelpers::faces[i] inside box can face pos
+	// a face pointing up an axis can only be seen from past its plane, and every plane is inside the box
+	uint8_t FacingDirections(const AABB16& box, const glm::vec3& pos);
+
+	// writes the draws of an allocation's facing directions (at most MaxDraws) and returns how many
+	// offset is in bytes like the allocator's, and the commands are in the same units as compact_batch.cs's
+	int Commands(const AllocInfo& info, GLuint offset, const glm::vec3& viewpos,
+		GLuint vertexSize, GLuint verticesPerRecord, DrawArraysIndirectCommand* out);
+}
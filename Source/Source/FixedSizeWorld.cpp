@@ -17,22 +17,23 @@ void FixedSizeWorld::GenWorld(glm::ivec3 lowChunkDim, glm::ivec3 highChunkDim)
 			{
 				Chunk* newChunk = new Chunk();
 				newChunk->SetPos({ x, y, z });
-				ChunkStorage::GetMapRaw()[{ x, y, z }] = newChunk;
+				ChunkStorage::Insert(newChunk);
 				WorldGen::GenerateChunk({ x, y, z });
 			}
 		}
 	}
 
-	auto& chunks = ChunkStorage::GetMapRaw();
+	std::vector<ChunkPtr> chunks;
+	ChunkStorage::GetMapRaw().ForEach([&](const glm::ivec3&, ChunkPtr chunk)
+	{
+		chunks.push_back(chunk);
+	});
 	auto lambruh = [&]()
 	{
 		std::for_each(std::execution::par,
-			chunks.begin(), chunks.end(), [](auto& p)
+			chunks.begin(), chunks.end(), [](ChunkPtr chunk)
 		{
-			if (p.second)
-				p.second->BuildMesh();
-			else
-				printf("null chunk?!?!?\n");
+			chunk->BuildMesh();
 		});
 	};
 	lambruh();
@@ -0,0 +1,60 @@
+#include "stdafx.h"
+#include "GatherBuffer.h"
+#include "ChunkHelpers.h"
+
+
+bool GatherBuffer::Gather(const ChunkSnapshot& center, const Chunk* parent)
+{
+	using namespace glm;
+	constexpr int size = Chunk::CHUNK_SIZE;
+
+	// the chunk itself, decoded straight into the padded rows
+	center.ExportTypes(types.data() + Index(0, 0, 0), SIZE, SIZE * SIZE);
+	center.ExportLight(lights.data() + Index(0, 0, 0), SIZE, SIZE * SIZE);
+
+	// the shell, one neighbor at a time
+	for (int i = 0; i < 26; i++)
+	{
+		ivec3 dir = ChunkHelpers::neighbors[i];
+		Chunk* nearChunk = parent->Neighbor(i);
+
+		// along each axis, the shell in this neighbor is either as long as the chunk or one layer thick
+		ivec3 lo, hi;
+		for (int a = 0; a < 3; a++)
+		{
+			lo[a] = dir[a] == 0 ? 0 : dir[a] > 0 ? size : -1;
+			hi[a] = dir[a] == 0 ? size : lo[a] + 1;
+		}
+
+		auto copyShell = [&]
+		{
+			std::optional<BlockType> uniform = nearChunk ? nearChunk->UniformType() : std::nullopt;
+			ivec3 p;
+			for (p.z = lo.z; p.z < hi.z; p.z++)
+			{
+				for (p.y = lo.y; p.y < hi.y; p.y++)
+				{
+					for (p.x = lo.x; p.x < hi.x; p.x++)
+					{
+						int index = Index(p);
+						if (!nearChunk)
+						{
+							types[index] = BlockType::bAir;
+							lights[index] = Light({ 0, 0, 0, 15 });
+							continue;
+						}
+						ivec3 src = p - dir * size;
+						types[index] = uniform ? *uniform : nearChunk->BlockTypeAt(src);
+						lights[index] = nearChunk->LightAt(src);
+					}
+				}
+			}
+		};
+
+		if (!nearChunk)
+			copyShell();
+		else if (!nearChunk->ReadConsistent(copyShell))
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "chunk.h"
+
+// a chunk's blocks and light with a one block shell from its 26 neighbors,
+// decoded into flat arrays so meshing never has to go through a palette or a neighbor
+// blocks in missing neighbors are air, lit like the sky
+// only the shell is read from each neighbor (not a copy of the whole chunk), straight from the
+// live chunk and again if a write overlapped it
+struct GatherBuffer
+{
+	static constexpr int SIZE = Chunk::CHUNK_SIZE + 2;
+	static constexpr int VOLUME = SIZE * SIZE * SIZE;
+
+	// positions are relative to the chunk, with components in [-1, CHUNK_SIZE]
+	static constexpr int Index(int x, int y, int z)
+	{
+		return (x + 1) + SIZE * ((y + 1) + SIZE * (z + 1));
+	}
+	static constexpr int Index(const glm::ivec3& p)
+	{
+		return Index(p.x, p.y, p.z);
+	}
+
+	BlockType TypeAt(const glm::ivec3& p) const { return types[Index(p)]; }
+	Light LightAt(const glm::ivec3& p) const { return lights[Index(p)]; }
+
+	// copies the center and the blocks touching it in the parent's neighbors
+	// false if a neighbor was being written every time its shell was read
+	bool Gather(const ChunkSnapshot& center, const Chunk* parent);
+
+	std::array<BlockType, VOLUME> types;
+	std::array<Light, VOLUME> lights;
+};
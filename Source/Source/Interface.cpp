@@ -15,6 +15,8 @@
 #include "ChunkHelpers.h"
 #include "ChunkMesh.h"
 #include "ChunkRenderer.h"
+#include "Benchmarks.h"
+#include "MemoryStats.h"
 
 namespace Interface
 {
@@ -68,9 +70,26 @@ namespace Interface
 				ImGui::Text("Chunk size: %d", Chunk::CHUNK_SIZE);
 
 				// displaying zero just means the queue was taken, not finished!
-				ImGui::Text("Gen queue:    %d", World::chunkManager_.generation_queue_.size());
-				ImGui::Text("Mesh queue:   %-4d (%d)", World::chunkManager_.mesher_queue_.size(), World::chunkManager_.debug_cur_pool_left.load());
-				ImGui::Text("Buffer queue: %d", World::chunkManager_.buffer_queue_.size());
+				ImGui::Text("Gen queue:    %d", World::chunkManager_.generation_queue_.Size());
+				ImGui::Text("Mesh queue:   %-4d (%d)", World::chunkManager_.mesher_queue_.Size(), World::chunkManager_.debug_cur_pool_left.load());
+				{
+					// nearest band first
+					auto bands = World::chunkManager_.mesher_queue_.BandDepths();
+					std::string depths;
+					for (size_t depth : bands)
+						depths += std::to_string(depth) + " ";
+					ImGui::Text("Mesh bands:   %s", depths.c_str());
+				}
+				ImGui::Text("Mesh waiting: %d", World::chunkManager_.waiting_.size());
+				ImGui::Text("Parked:       %d gen, %d mesh (%d, %d cancelled)",
+					World::chunkManager_.generation_queue_.ParkedCount(), World::chunkManager_.mesher_queue_.ParkedCount(),
+					World::chunkManager_.generation_queue_.CancelledCount(), World::chunkManager_.mesher_queue_.CancelledCount());
+				ImGui::Text("Buffer queue: %d (%d superseded)", World::chunkManager_.buffer_queue_.size(), World::chunkManager_.debug_superseded);
+				ImGui::Text("Uploaded:     %d last frame", World::chunkManager_.debug_uploaded);
+				if (const StagingRing* ring = ChunkRenderer::stagingRing.get())
+					ImGui::Text("Staging ring: %.1f / %.1f MB", ring->UsedBytes() / 1e6, ring->Capacity() / 1e6);
+				if (const JobSystem* jobs = World::chunkManager_.jobs_.get())
+					ImGui::Text("Jobs:         %zu queued, %zu running on %d workers", jobs->QueuedJobs(), jobs->RunningJobs(), jobs->WorkerCount());
 
 				static bool countChunks = true;
 				ImGui::Checkbox("Count chunks (slow)", &countChunks);
@@ -80,26 +99,70 @@ namespace Interface
 					int active = 0;
 					int numVerts = 0;
 					int numPoints = 0;
+					size_t meshes = 0;
+					unsigned maxMeshes = 0;
+					int states[int(ChunkState::Uploaded) + 1] = {};
 					// this causes lag with many chunks
-					for (auto& p : ChunkStorage::GetMapRaw())
+					ChunkStorage::GetMapRaw().ForEach([&](const glm::ivec3&, ChunkPtr chunk)
 					{
-						if (p.second)
-						{
-							nonNull++;
-							numVerts += p.second->GetMesh().GetVertexCount();
-							numPoints += p.second->GetMesh().GetPointCount();
-						}
-					}
-					ImGui::Text("Total chunks:    %d", ChunkStorage::GetMapRaw().size());
+						nonNull++;
+						numVerts += chunk->GetMesh().GetVertexCount();
+						numPoints += chunk->GetMesh().GetPointCount();
+						meshes += chunk->GetMesh().GetBuildCount();
+						maxMeshes = std::max(maxMeshes, chunk->GetMesh().GetBuildCount());
+						states[int(chunk->GetState())]++;
+					});
+					ImGui::Text("Total chunks:    %d", int(ChunkStorage::GetMapRaw().Size()));
 					ImGui::Text("Non-null chunks: %d", nonNull);
 					ImGui::Text("Drawn chunks:    %d", NuRenderer::drawCalls);
 					ImGui::Text("Culled chunks:   %d", nonNull - NuRenderer::drawCalls);
+					ImGui::Text("Meshes/chunk:    %.2f (max %u)", nonNull ? double(meshes) / nonNull : 0.0, maxMeshes);
+					ImGui::Text("Allocated %d, generated %d, lit %d, meshed %d, uploaded %d",
+						states[0], states[1], states[2], states[3], states[4]);
 
 					ImGui::NewLine();
 					ImGui::Text("Vertices: %d", numVerts);
 					ImGui::Text("Points:   %d", numPoints);
 					ImGui::NewLine();
 				}
+
+				// memory (maintained by the chunks themselves, so this is cheap)
+				if (ImGui::CollapsingHeader("Memory"))
+				{
+					MemoryStats::Totals mem = MemoryStats::GetTotals();
+					ImGui::Text("Tracked chunks: %zu", mem.chunks);
+					ImGui::Text("Total:          %.2f MB", mem.Total() / 1048576.0);
+					for (int i = 0; i < MemoryStats::CategoryCount; i++)
+						ImGui::Text("  %-16s %.2f MB", MemoryStats::CategoryName(i), mem.bytes[i] / 1048576.0);
+					if (ChunkRenderer::allocator)
+						ImGui::Text("GPU mesh:  %.2f / %.2f MB (%u allocs)",
+							ChunkRenderer::allocator->UsedBytes() / 1048576.0,
+							ChunkRenderer::allocator->Capacity() / 1048576.0,
+							ChunkRenderer::allocator->ActiveAllocs());
+					if (ChunkRenderer::allocatorSplat)
+						ImGui::Text("GPU splat: %.2f / %.2f MB (%u allocs)",
+							ChunkRenderer::allocatorSplat->UsedBytes() / 1048576.0,
+							ChunkRenderer::allocatorSplat->Capacity() / 1048576.0,
+							ChunkRenderer::allocatorSplat->ActiveAllocs());
+					ImGui::Text("Mesh arenas: %.2f MB pooled, %.2f MB staged",
+						MeshArena::PooledBytes() / 1048576.0,
+						MeshArena::OutstandingBytes() / 1048576.0);
+
+					float sizeHist[MemoryStats::SizeBuckets];
+					for (int i = 0; i < MemoryStats::SizeBuckets; i++)
+						sizeHist[i] = float(mem.sizeHistogram[i]);
+					ImGui::PlotHistogram("Chunk size\n(1KB..1MB)", sizeHist, MemoryStats::SizeBuckets,
+						0, 0, 0, FLT_MAX, ImVec2(200, 60));
+
+					float widthHist[MemoryStats::WidthBuckets];
+					for (int i = 0; i < MemoryStats::WidthBuckets; i++)
+						widthHist[i] = float(mem.widthHistogram[i]);
+					ImGui::PlotHistogram("Type bits\n(0..16)", widthHist, MemoryStats::WidthBuckets,
+						0, 0, 0, FLT_MAX, ImVec2(200, 60));
+
+					if (ImGui::Button("Dump memory JSON"))
+						MemoryStats::DumpJson("./memory_stats.json");
+				}
 				
 				ImGui::End();
 			}
@@ -155,6 +218,8 @@ namespace Interface
 				{
 					delete Shader::shaders["chunk_optimized"];
 					Shader::shaders["chunk_optimized"] = new Shader("chunk_optimized.vs", "chunk_optimized.fs");
+					delete Shader::shaders["chunk_compact"];
+					Shader::shaders["chunk_compact"] = new Shader("chunk_compact.vs", "chunk_optimized.fs");
 				}
 				if (ImGui::Button("Recompile Splat Chunk Shader"))
 				{
@@ -170,15 +235,15 @@ namespace Interface
 				if (ImGui::Button("Delete far chunks (unsafe)"))
 				{
 					std::vector<ChunkPtr> deleteList;
-					std::for_each(ChunkStorage::GetMapRaw().begin(), ChunkStorage::GetMapRaw().end(),
-						[&](auto& p)
+					ChunkStorage::RemoveIf([&](const glm::ivec3& cpos, ChunkPtr chunk)
 					{
-						float dist = glm::distance(glm::vec3(p.first * Chunk::CHUNK_SIZE), Renderer::GetPipeline()->GetCamera(0)->GetPos());
-						if (p.second && dist > World::chunkManager_.loadDistance_ + World::chunkManager_.unloadLeniency_)
+						float dist = glm::distance(glm::vec3(cpos * Chunk::CHUNK_SIZE), Renderer::GetPipeline()->GetCamera(0)->GetPos());
+						if (dist > World::chunkManager_.loadDistance_ + World::chunkManager_.unloadLeniency_)
 						{
-							deleteList.push_back(p.second);
-							p.second = nullptr;
+							deleteList.push_back(chunk);
+							return true;
 						}
+						return false;
 					});
 
 					for (ChunkPtr p : deleteList)
@@ -311,8 +376,14 @@ namespace Interface
 					World::chunkManager_.ReloadAllChunks();
 				if (ImGui::Checkbox("Skip lighting", &ChunkMesh::debug_ignore_light_level))
 					World::chunkManager_.ReloadAllChunks();
+				if (ImGui::Checkbox("Greedy meshing", &Settings::GFX::greedyMeshing))
+					World::chunkManager_.ReloadAllChunks();
+				ImGui::Checkbox("LOD meshes", &Settings::GFX::lodMeshes);
+				if (ImGui::Checkbox("LOD by majority", &Settings::GFX::lodMajority))
+					World::chunkManager_.ReloadAllChunks();
 				ImGui::Checkbox("Gamma correction", &NuRenderer::settings.gammaCorrection);
 				ImGui::Checkbox("Freeze Culling", &ChunkRenderer::settings.freezeCulling);
+				ImGui::Checkbox("Face direction culling", &ChunkRenderer::settings.faceRangeCulling);
 				ImGui::Checkbox("Draw Occ. Culling", &ChunkRenderer::settings.debug_drawOcclusionCulling);
 				ImGui::SliderFloat("Fog Start", &NuRenderer::settings.fogStart, 0, 5000);
 				ImGui::SliderFloat("Fog End", &NuRenderer::settings.fogEnd, 0, 5000);
@@ -322,6 +393,35 @@ namespace Interface
 				ImGui::SliderFloat("normalMax", &ChunkRenderer::settings.normalMax, 0, 5000);
 				ImGui::SliderFloat("splatMin", &ChunkRenderer::settings.splatMin, 0, 5000);
 				ImGui::SliderFloat("splatMax", &ChunkRenderer::settings.splatMax, 0, 5000);
+				ImGui::SliderFloat("lodStart", &ChunkRenderer::settings.lodStart, 0, 2000);
+				ImGui::SliderFloat("lodHysteresis", &ChunkRenderer::settings.lodHysteresis, 0, .5f);
+				ImGui::SliderFloat("Upload budget (ms)", &ChunkRenderer::settings.uploadBudgetMs, 0, 16);
+				ImGui::SliderInt("Upload budget (KB)", &ChunkRenderer::settings.uploadBudgetKB, 0, 64 * 1024);
+				ImGui::End();
+			}
+
+			// benchmarks (results are printed to the console)
+			ImGui::SetNextWindowBgAlpha(.5f);
+			{
+				ImGui::Begin("Benchmarks", 0, activeCursor ? 0 : ImGuiWindowFlags_NoMouseInputs);
+				if (ImGui::Button("BitArray codec"))
+					Benchmarks::BitArrayCodec();
+				if (ImGui::Button("Palette contention"))
+					Benchmarks::PaletteContention();
+				if (ImGui::Button("Light storage"))
+					Benchmarks::LightStorage();
+				if (ImGui::Button("Chunk map contention"))
+					Benchmarks::ChunkMapContention();
+				if (ImGui::Button("Meshers"))
+					Benchmarks::Meshers();
+				if (ImGui::Button("Quad format"))
+					Benchmarks::QuadFormat();
+				if (ImGui::Button("Vertex kernels"))
+					Benchmarks::VertexKernels();
+				if (ImGui::Button("LOD meshes"))
+					Benchmarks::LodMeshes();
+				if (ImGui::Button("Backface ranges"))
+					Benchmarks::BackfaceRanges();
 				ImGui::End();
 			}
 
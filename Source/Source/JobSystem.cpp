@@ -0,0 +1,128 @@
+#include "stdafx.h"
+#include "JobSystem.h"
+
+
+namespace
+{
+	// the worker the calling thread is, so jobs submitted by a job stay on its deque
+	thread_local const JobSystem* currentSystem = nullptr;
+	thread_local int currentWorker = -1;
+}
+
+
+JobSystem::JobSystem(int workers)
+{
+	if (workers <= 0)
+		workers = std::max(1, int(std::thread::hardware_concurrency()) - 1);
+
+	// every worker exists before any of them can try to steal from the others
+	for (int i = 0; i < workers; i++)
+		workers_.push_back(std::make_unique<Worker>());
+	for (int i = 0; i < workers; i++)
+		workers_[i]->thread = std::thread([this, i] { run(i); });
+}
+
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard lk(sleepMtx_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (auto& worker : workers_)
+		worker->thread.join();
+}
+
+
+void JobSystem::Submit(Job job, Priority priority)
+{
+	int index = currentSystem == this ? currentWorker : int(nextWorker_++ % workers_.size());
+	{
+		Worker& worker = *workers_[index];
+		std::lock_guard lk(worker.mtx);
+		worker.jobs[int(priority)].push_back(std::move(job));
+		queuedPerPriority_[int(priority)]++;
+		queued_++;
+	}
+
+	// a worker checks queued_ under sleepMtx_ before it sleeps, so it has either seen the job or is waiting
+	{
+		std::lock_guard lk(sleepMtx_);
+	}
+	wake_.notify_one();
+}
+
+
+void JobSystem::WaitIdle()
+{
+	ASSERT(currentSystem != this);
+	std::unique_lock lk(sleepMtx_);
+	idle_.wait(lk, [this] { return queued_ == 0 && running_ == 0; });
+}
+
+
+void JobSystem::run(int index)
+{
+	currentSystem = this;
+	currentWorker = index;
+
+	Job job;
+	while (!stop_)
+	{
+		if (tryTake(index, job))
+		{
+			job();
+			job = nullptr;
+
+			// queued_ only drops when running_ rises, so this is the only way to become idle
+			if (--running_ == 0)
+			{
+				std::lock_guard lk(sleepMtx_);
+				idle_.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock lk(sleepMtx_);
+		wake_.wait(lk, [this] { return stop_ || queued_ > 0; });
+	}
+}
+
+
+// the newest job of this worker's deque, or the oldest of another's, highest priority first
+bool JobSystem::tryTake(int index, Job& job)
+{
+	auto take = [&](Worker& worker, int priority, bool newest)
+	{
+		std::lock_guard lk(worker.mtx);
+		std::deque<Job>& jobs = worker.jobs[priority];
+		if (jobs.empty())
+			return false;
+		if (newest)
+		{
+			job = std::move(jobs.back());
+			jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		running_++;
+		queuedPerPriority_[priority]--;
+		queued_--;
+		return true;
+	};
+
+	int count = int(workers_.size());
+	for (int priority = 0; priority < int(Priority::Count); priority++)
+	{
+		if (take(*workers_[index], priority, true))
+			return true;
+		for (int i = 1; i < count; i++)
+			if (take(*workers_[(index + i) % count], priority, false))
+				return true;
+	}
+	return false;
+}
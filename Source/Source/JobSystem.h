@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed pool of worker threads for the chunk pipeline (generation, lighting, meshing)
+// every worker has a deque of jobs per priority: it takes the newest job of its own,
+// and steals the oldest job of another worker when it runs out
+// a job of a higher priority always goes first, wherever it was queued
+// idle workers sleep until a job is submitted
+class JobSystem
+{
+public:
+	enum class Priority
+	{
+		High,   // edits the player is waiting to see
+		Normal, // generation and meshing of new chunks
+		Low,    // work nobody is waiting on (e.g. changing LOD)
+
+		Count
+	};
+
+	using Job = std::function<void()>;
+
+	// 0 workers is one per hardware thread, minus one for the main thread
+	explicit JobSystem(int workers = 0);
+
+	// jobs that haven't started yet are dropped, running jobs are finished first
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// from any thread, including from a job
+	void Submit(Job job, Priority priority = Priority::Normal);
+
+	// blocks until every submitted job has finished, including the jobs they submitted
+	// must not be called from a job
+	void WaitIdle();
+
+	int WorkerCount() const { return int(workers_.size()); }
+	size_t QueuedJobs() const { return queued_.load(); }
+	size_t QueuedJobs(Priority priority) const { return queuedPerPriority_[int(priority)].load(); }
+	size_t RunningJobs() const { return running_.load(); }
+
+private:
+	struct Worker
+	{
+		std::mutex mtx;
+		std::deque<Job> jobs[int(Priority::Count)];
+		std::thread thread;
+	};
+
+	void run(int index);
+	bool tryTake(int index, Job& job);
+
+	std::vector<std::unique_ptr<Worker>> workers_;
+	std::atomic<unsigned> nextWorker_ = 0; // where jobs from outside the pool go, round robin
+
+	std::atomic<size_t> queued_ = 0;
+	std::atomic<size_t> queuedPerPriority_[int(Priority::Count)] = {};
+	std::atomic<size_t> running_ = 0;
+
+	// workers sleep on wake_ and WaitIdle on idle_, both check their condition under sleepMtx_
+	std::mutex sleepMtx_;
+	std::condition_variable wake_; // workers, when a job is queued
+	std::condition_variable idle_; // WaitIdle, when the last job finishes
+	std::atomic<bool> stop_ = false;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include "light.h"
+#include "Palette.h"
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+// light storage policies for PaletteBlockStorage
+// every policy provides SetVal, GetVal, Export, Import, Copy, MemoryUsage and GetMemoryInfo,
+// and must be safe to read while another thread is writing
+// SetVal returns true if the write changed how much memory the storage uses
+
+// palettized light, small when lighting is flat (e.g. all sunlight or all dark)
+template<unsigned _Size>
+using PaletteLightStorage = ConcurrentPalette<Light, _Size>;
+
+
+// uncompressed light, 16 bits per voxel
+// reads and writes are a single relaxed atomic access, so there is no palette to
+// grow or search, which makes it the faster option for light propagation
+template<unsigned _Size>
+class DenseLightStorage
+{
+public:
+	DenseLightStorage();
+	DenseLightStorage(const DenseLightStorage&) = delete;
+	DenseLightStorage& operator=(const DenseLightStorage&) = delete;
+
+	bool SetVal(int index, Light light);
+	Light GetVal(int index) const;
+	void Export(Light* out) const;
+	void Import(const Light* in);
+	Palette<Light, _Size> Copy() const;
+	size_t MemoryUsage() const;
+	PaletteMemory GetMemoryInfo() const;
+
+private:
+	std::unique_ptr<std::atomic<uint16_t>[]> data_;
+};
+
+
+// starts out palettized, switches (one way) to dense storage once the chunk's
+// light gets too noisy for the palette to pay off:
+// - SetVal switches when the palette index grows to DenseWidth bits
+// - Import switches when the entropy of the incoming light exceeds DenseEntropy bits
+// the old palette is retired (see Epoch), since readers may not have seen the switch yet
+template<unsigned _Size>
+class AdaptiveLightStorage
+{
+public:
+	static constexpr unsigned DenseWidth = 6;
+	static constexpr double DenseEntropy = 3.0;
+
+	AdaptiveLightStorage();
+	~AdaptiveLightStorage();
+	AdaptiveLightStorage(const AdaptiveLightStorage&) = delete;
+	AdaptiveLightStorage& operator=(const AdaptiveLightStorage&) = delete;
+
+	bool SetVal(int index, Light light);
+	Light GetVal(int index) const;
+	void Export(Light* out) const;
+	void Import(const Light* in);
+	Palette<Light, _Size> Copy() const;
+	size_t MemoryUsage() const;
+	PaletteMemory GetMemoryInfo() const;
+
+	bool IsDense() const { return dense_.load(std::memory_order_acquire); }
+
+private:
+	// must be called while holding mtx
+	void makeDense(std::unique_ptr<DenseLightStorage<_Size>> dense);
+
+	std::atomic<PaletteLightStorage<_Size>*> palette_; // owned, null once dense
+	std::unique_ptr<DenseLightStorage<_Size>> denseStorage_;
+	std::atomic_bool dense_ = false;
+	std::mutex mtx; // serializes writes while still palettized
+};
+
+#include "LightStorage.inl"
@@ -0,0 +1,210 @@
+#pragma once
+#include "LightStorage.h"
+#include <unordered_map>
+#include <cmath>
+#include <array>
+
+template<unsigned _Size>
+DenseLightStorage<_Size>::DenseLightStorage()
+	: data_(std::make_unique<std::atomic<uint16_t>[]>(_Size))
+{
+	for (unsigned i = 0; i < _Size; i++)
+		data_[i].store(0, std::memory_order_relaxed);
+}
+
+template<unsigned _Size>
+inline bool DenseLightStorage<_Size>::SetVal(int index, Light light)
+{
+	data_[index].store(light.Raw(), std::memory_order_relaxed);
+	return false;
+}
+
+template<unsigned _Size>
+inline Light DenseLightStorage<_Size>::GetVal(int index) const
+{
+	Light ret;
+	ret.Raw() = data_[index].load(std::memory_order_relaxed);
+	return ret;
+}
+
+template<unsigned _Size>
+void DenseLightStorage<_Size>::Export(Light* out) const
+{
+	for (unsigned i = 0; i < _Size; i++)
+		out[i].Raw() = data_[i].load(std::memory_order_relaxed);
+}
+
+template<unsigned _Size>
+void DenseLightStorage<_Size>::Import(const Light* in)
+{
+	for (unsigned i = 0; i < _Size; i++)
+		data_[i].store(in[i].Raw(), std::memory_order_relaxed);
+}
+
+template<unsigned _Size>
+Palette<Light, _Size> DenseLightStorage<_Size>::Copy() const
+{
+	auto values = std::make_unique<std::array<Light, _Size>>();
+	Export(values->data());
+	Palette<Light, _Size> ret;
+	ret.Import(values->data());
+	return ret;
+}
+
+template<unsigned _Size>
+size_t DenseLightStorage<_Size>::MemoryUsage() const
+{
+	return _Size * sizeof(std::atomic<uint16_t>);
+}
+
+template<unsigned _Size>
+PaletteMemory DenseLightStorage<_Size>::GetMemoryInfo() const
+{
+	PaletteMemory ret;
+	ret.bitstream = MemoryUsage();
+	ret.entryLength = 16;
+	return ret;
+}
+
+
+
+
+template<unsigned _Size>
+AdaptiveLightStorage<_Size>::AdaptiveLightStorage()
+	: palette_(new PaletteLightStorage<_Size>())
+{
+}
+
+template<unsigned _Size>
+AdaptiveLightStorage<_Size>::~AdaptiveLightStorage()
+{
+	delete palette_.load();
+}
+
+template<unsigned _Size>
+bool AdaptiveLightStorage<_Size>::SetVal(int index, Light light)
+{
+	if (IsDense())
+		return denseStorage_->SetVal(index, light);
+
+	std::lock_guard w(mtx);
+	if (IsDense()) // switched while we were waiting
+		return denseStorage_->SetVal(index, light);
+
+	PaletteLightStorage<_Size>* palette = palette_.load(std::memory_order_relaxed);
+	bool resized = palette->SetVal(index, light);
+	if (palette->EntryLength() >= DenseWidth)
+	{
+		auto dense = std::make_unique<DenseLightStorage<_Size>>();
+		auto values = std::make_unique<std::array<Light, _Size>>();
+		palette->Export(values->data());
+		dense->Import(values->data());
+		makeDense(std::move(dense));
+		return true;
+	}
+	return resized;
+}
+
+// a reader that still finds the palette keeps it alive with its guard,
+// one that finds it gone is sure to see the dense storage that replaced it
+template<unsigned _Size>
+Light AdaptiveLightStorage<_Size>::GetVal(int index) const
+{
+	if (!IsDense())
+	{
+		Epoch::Guard guard;
+		if (const auto* palette = palette_.load())
+			return palette->GetVal(index);
+	}
+	return denseStorage_->GetVal(index);
+}
+
+template<unsigned _Size>
+void AdaptiveLightStorage<_Size>::Export(Light* out) const
+{
+	if (!IsDense())
+	{
+		Epoch::Guard guard;
+		if (const auto* palette = palette_.load())
+		{
+			palette->Export(out);
+			return;
+		}
+	}
+	denseStorage_->Export(out);
+}
+
+template<unsigned _Size>
+void AdaptiveLightStorage<_Size>::Import(const Light* in)
+{
+	std::lock_guard w(mtx);
+	if (IsDense())
+	{
+		denseStorage_->Import(in);
+		return;
+	}
+
+	// shannon entropy (bits per voxel) of the incoming light
+	std::unordered_map<uint16_t, unsigned> histogram;
+	for (unsigned i = 0; i < _Size; i++)
+		histogram[in[i].Raw()]++;
+	double entropy = 0;
+	for (const auto& [light, count] : histogram)
+	{
+		double p = double(count) / _Size;
+		entropy -= p * std::log2(p);
+	}
+
+	if (entropy > DenseEntropy)
+	{
+		auto dense = std::make_unique<DenseLightStorage<_Size>>();
+		dense->Import(in);
+		makeDense(std::move(dense));
+	}
+	else
+	{
+		palette_.load(std::memory_order_relaxed)->Import(in);
+	}
+}
+
+template<unsigned _Size>
+Palette<Light, _Size> AdaptiveLightStorage<_Size>::Copy() const
+{
+	if (!IsDense())
+	{
+		Epoch::Guard guard;
+		if (const auto* palette = palette_.load())
+			return palette->Copy();
+	}
+	return denseStorage_->Copy();
+}
+
+template<unsigned _Size>
+size_t AdaptiveLightStorage<_Size>::MemoryUsage() const
+{
+	return GetMemoryInfo().Total();
+}
+
+template<unsigned _Size>
+PaletteMemory AdaptiveLightStorage<_Size>::GetMemoryInfo() const
+{
+	if (!IsDense())
+	{
+		Epoch::Guard guard;
+		if (const auto* palette = palette_.load())
+			return palette->GetMemoryInfo();
+	}
+	return denseStorage_->GetMemoryInfo();
+}
+
+template<unsigned _Size>
+void AdaptiveLightStorage<_Size>::makeDense(std::unique_ptr<DenseLightStorage<_Size>> dense)
+{
+	// publish the filled storage before readers are pointed at it
+	denseStorage_ = std::move(dense);
+	dense_.store(true);
+
+	std::unique_ptr<PaletteLightStorage<_Size>> palette(palette_.exchange(nullptr));
+	size_t bytes = sizeof(*palette) + palette->MemoryUsage();
+	Epoch::Retire(std::move(palette), bytes);
+}
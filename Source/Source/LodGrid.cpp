@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "LodGrid.h"
+#include "GatherBuffer.h"
+#include "ChunkHelpers.h"
+
+
+namespace
+{
+	constexpr size_t typeCount = size_t(BlockType::bCount);
+
+	// most common type in a histogram (air if it's empty)
+	BlockType mostCommon(const uint16_t (&counts)[typeCount])
+	{
+		size_t best = 0;
+		for (size_t i = 1; i < typeCount; i++)
+			if (counts[i] > counts[best])
+				best = i;
+		return counts[best] ? BlockType(best) : BlockType::bAir;
+	}
+}
+
+
+void LodGrid::Build(const GatherBuffer& gather, int level, Reduction reduction)
+{
+	ASSERT(level >= 1 && level <= MAX_LEVEL);
+	using namespace glm;
+	level_ = level;
+	const int factor = Factor();
+	const int size = Size();
+	std::fill(types_.begin(), types_.end(), BlockType::bAir);
+
+	// the cells of the chunk
+	ivec3 c;
+	for (c.z = 0; c.z < size; c.z++)
+	{
+		for (c.y = 0; c.y < size; c.y++)
+		{
+			for (c.x = 0; c.x < size; c.x++)
+			{
+				ivec3 base = c * factor;
+				uint16_t counts[typeCount] = {};
+				int solid = 0;
+				for (int z = 0; z < factor; z++)
+				{
+					for (int x = 0; x < factor; x++)
+					{
+						for (int y = factor - 1; y >= 0; y--)
+						{
+							BlockType type = gather.TypeAt(base + ivec3(x, y, z));
+							if (type == BlockType::bAir)
+								continue;
+							counts[uint16_t(type)]++;
+							solid++;
+							// only the top block of each column counts
+							if (reduction == Reduction::Surface)
+								break;
+						}
+					}
+				}
+
+				bool isSolid = reduction == Reduction::Surface ? solid > 0 : solid * 2 >= factor * factor * factor;
+				if (isSolid)
+					types_[index(c)] = mostCommon(counts);
+			}
+		}
+	}
+
+	// the shell, from the layer of blocks each neighbor cell touches the chunk with
+	for (int face = 0; face < 6; face++)
+	{
+		ivec3 normal = ChunkHelpers::faces[face];
+		int normalAxis = normal.x ? 0 : normal.y ? 1 : 2;
+		int uAxis = (normalAxis + 1) % 3;
+		int vAxis = (normalAxis + 2) % 3;
+
+		ivec3 cell;
+		cell[normalAxis] = normal[normalAxis] > 0 ? size : -1;
+		for (cell[vAxis] = 0; cell[vAxis] < size; cell[vAxis]++)
+		{
+			for (cell[uAxis] = 0; cell[uAxis] < size; cell[uAxis]++)
+			{
+				ivec3 block;
+				block[normalAxis] = normal[normalAxis] > 0 ? Chunk::CHUNK_SIZE : -1;
+				block[uAxis] = cell[uAxis] * factor;
+				block[vAxis] = cell[vAxis] * factor;
+				BlockType first = gather.TypeAt(block);
+
+				bool uniform = true;
+				for (int v = 0; uniform && v < factor; v++)
+				{
+					for (int u = 0; uniform && u < factor; u++)
+					{
+						ivec3 p = block;
+						p[uAxis] += u;
+						p[vAxis] += v;
+						uniform = gather.TypeAt(p) == first;
+					}
+				}
+				types_[index(cell)] = uniform ? first : BlockType::bAir;
+			}
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "chunk.h"
+#include <array>
+
+struct GatherBuffer;
+
+// a chunk's blocks reduced to cubes of 2, 4 or 8 blocks, meshed instead of the blocks when the chunk is far away
+// the cells have a one cell shell made from the gather buffer's shell, so faces between chunks can be culled
+class LodGrid
+{
+public:
+	static constexpr int MAX_LEVEL = 3; // cells of 8 blocks
+
+	enum class Reduction
+	{
+		Majority, // a cell is solid if at least half of its blocks are, and takes their most common type
+		Surface,  // a cell is solid if any of its blocks is, and takes the type most common at the top of its columns
+	};
+
+	// level is from 1 to MAX_LEVEL
+	void Build(const GatherBuffer& gather, int level, Reduction reduction);
+
+	int Factor() const { return 1 << level_; } // blocks per cell along each axis
+	int Size() const { return Chunk::CHUNK_SIZE >> level_; } // cells per chunk along each axis
+
+	// cell positions are relative to the chunk, with components in [-1, Size()]
+	// shell cells are air unless the blocks of the neighbor touching them are all the same type
+	BlockType TypeAt(const glm::ivec3& c) const { return types_[index(c)]; }
+
+private:
+	int index(const glm::ivec3& c) const
+	{
+		int padded = Size() + 2;
+		return (c.x + 1) + padded * ((c.y + 1) + padded * (c.z + 1));
+	}
+
+	int level_ = 1;
+	std::array<BlockType, (Chunk::CHUNK_SIZE / 2 + 2) * (Chunk::CHUNK_SIZE / 2 + 2) * (Chunk::CHUNK_SIZE / 2 + 2)> types_;
+};
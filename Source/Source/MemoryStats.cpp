@@ -0,0 +1,214 @@
+#include "stdafx.h"
+#include "MemoryStats.h"
+#include "ChunkRenderer.h"
+#include "MeshArena.h"
+#include "Epoch.h"
+#include <stringbuffer.h>
+#include <prettywriter.h>
+#include <fstream>
+#include <atomic>
+
+namespace MemoryStats
+{
+	namespace
+	{
+		std::atomic<size_t> totalBytes[CategoryCount];
+		std::atomic<size_t> totalChunks = 0;
+		std::atomic<size_t> sizeHistogram[SizeBuckets];
+		std::atomic<size_t> widthHistogram[WidthBuckets];
+
+		const char* categoryNames[CategoryCount] =
+		{
+			"typePalette",
+			"typeBitstream",
+			"lightPalette",
+			"lightBitstream",
+			"retiredStorage",
+			"snapshots",
+			"meshStaging",
+			"chunkObject",
+		};
+
+		template<typename UserT>
+		void writeAllocator(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer,
+			const char* name, BufferAllocator<UserT>* allocator)
+		{
+			// null if there is no allocator (no GL context, as with --dump-memory)
+			writer.Key(name);
+			if (!allocator)
+			{
+				writer.Null();
+				return;
+			}
+			writer.StartObject();
+			writer.Key("capacity");
+			writer.Uint64(allocator->Capacity());
+			writer.Key("used");
+			writer.Uint64(allocator->UsedBytes());
+			writer.Key("activeAllocs");
+			writer.Uint(allocator->ActiveAllocs());
+			writer.EndObject();
+		}
+	}
+
+
+	const char* CategoryName(int category)
+	{
+		return categoryNames[category];
+	}
+
+
+	int SizeBucket(size_t bytes)
+	{
+		int bucket = 0;
+		for (size_t limit = 1024; bytes >= limit && bucket < SizeBuckets - 1; limit <<= 1)
+			bucket++;
+		return bucket;
+	}
+
+
+	void Report(ChunkRecord& record, const size_t (&bytes)[CategoryCount], unsigned typeWidth)
+	{
+		std::lock_guard lk(record.mtx);
+
+		size_t total = 0;
+		for (int i = 0; i < CategoryCount; i++)
+		{
+			totalBytes[i] += bytes[i] - record.bytes[i]; // wraps around correctly when shrinking
+			record.bytes[i] = bytes[i];
+			total += bytes[i];
+		}
+
+		if (record.sizeBucket == -1)
+			totalChunks++;
+		else
+		{
+			sizeHistogram[record.sizeBucket]--;
+			widthHistogram[record.widthBucket]--;
+		}
+		record.sizeBucket = SizeBucket(total);
+		record.widthBucket = std::min(int(typeWidth), WidthBuckets - 1);
+		sizeHistogram[record.sizeBucket]++;
+		widthHistogram[record.widthBucket]++;
+	}
+
+
+	void Retract(ChunkRecord& record)
+	{
+		std::lock_guard lk(record.mtx);
+		if (record.sizeBucket == -1)
+			return;
+
+		for (int i = 0; i < CategoryCount; i++)
+		{
+			totalBytes[i] -= record.bytes[i];
+			record.bytes[i] = 0;
+		}
+		totalChunks--;
+		sizeHistogram[record.sizeBucket]--;
+		widthHistogram[record.widthBucket]--;
+		record.sizeBucket = -1;
+		record.widthBucket = -1;
+	}
+
+
+	void Add(Category category, size_t bytes)
+	{
+		totalBytes[category] += bytes;
+	}
+
+
+	void Remove(Category category, size_t bytes)
+	{
+		totalBytes[category] -= bytes;
+	}
+
+
+	size_t Totals::Total() const
+	{
+		size_t ret = 0;
+		for (size_t b : bytes)
+			ret += b;
+		return ret;
+	}
+
+
+	Totals GetTotals()
+	{
+		Totals ret;
+		for (int i = 0; i < CategoryCount; i++)
+			ret.bytes[i] = totalBytes[i];
+		ret.bytes[RetiredStorage] = Epoch::PendingBytes();
+		ret.chunks = totalChunks;
+		for (int i = 0; i < SizeBuckets; i++)
+			ret.sizeHistogram[i] = sizeHistogram[i];
+		for (int i = 0; i < WidthBuckets; i++)
+			ret.widthHistogram[i] = widthHistogram[i];
+		return ret;
+	}
+
+
+	std::string DumpJson()
+	{
+		Totals totals = GetTotals();
+
+		rapidjson::StringBuffer buffer;
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+		writer.StartObject();
+
+		writer.Key("chunks");
+		writer.Uint64(totals.chunks);
+		writer.Key("totalBytes");
+		writer.Uint64(totals.Total());
+
+		writer.Key("bytes");
+		writer.StartObject();
+		for (int i = 0; i < CategoryCount; i++)
+		{
+			writer.Key(CategoryName(i));
+			writer.Uint64(totals.bytes[i]);
+		}
+		writer.EndObject();
+
+		// bucket i holds chunks of [2^(i-1), 2^i) KB, the first is < 1KB and the last is open-ended
+		writer.Key("chunkSizeHistogram");
+		writer.StartArray();
+		for (size_t count : totals.sizeHistogram)
+			writer.Uint64(count);
+		writer.EndArray();
+
+		writer.Key("typeWidthHistogram");
+		writer.StartArray();
+		for (size_t count : totals.widthHistogram)
+			writer.Uint64(count);
+		writer.EndArray();
+
+		writer.Key("gpu");
+		writer.StartObject();
+		writeAllocator(writer, "mesh", ChunkRenderer::allocator.get());
+		writeAllocator(writer, "splat", ChunkRenderer::allocatorSplat.get());
+		writer.EndObject();
+
+		// mesh output blocks, whether pooled by the workers or held by chunks
+		writer.Key("meshArenas");
+		writer.StartObject();
+		writer.Key("pooled");
+		writer.Uint64(MeshArena::PooledBytes());
+		writer.Key("outstanding");
+		writer.Uint64(MeshArena::OutstandingBytes());
+		writer.EndObject();
+
+		writer.EndObject();
+		return buffer.GetString();
+	}
+
+
+	bool DumpJson(const std::string& path)
+	{
+		std::ofstream of(path);
+		if (!of)
+			return false;
+		of << DumpJson();
+		return bool(of);
+	}
+}
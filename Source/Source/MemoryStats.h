@@ -0,0 +1,67 @@
+#pragma once
+#include <mutex>
+#include <string>
+
+// memory accounting for voxel data
+// each chunk keeps a record of what it last reported and only the difference is
+// applied to the totals when it reports again, so reading the totals never
+// requires walking the chunk map
+namespace MemoryStats
+{
+	enum Category
+	{
+		TypePalette,    // block type palette entries + lookup table
+		TypeBitstream,  // block type indices
+		LightPalette,   // light palette entries + lookup table
+		LightBitstream, // light indices, or the dense light array
+		RetiredStorage, // storage retired for lock-free readers, not freed yet (Epoch, not per chunk)
+		Snapshots,      // chunk copies held by mesh builds and saves (not per chunk)
+		MeshStaging,    // mesh output waiting to be uploaded
+		ChunkObject,    // sizeof(Chunk)
+
+		CategoryCount
+	};
+
+	const char* CategoryName(int category);
+
+	// histogram of total bytes per chunk, in powers of two from 1KB to 1MB
+	constexpr int SizeBuckets = 12;
+	// histogram of block type palette index lengths (0 is a uniform chunk)
+	constexpr int WidthBuckets = 17;
+
+	int SizeBucket(size_t bytes);
+
+	struct ChunkRecord
+	{
+		size_t bytes[CategoryCount] = {};
+		int sizeBucket = -1; // -1 until the first report
+		int widthBucket = -1;
+		std::mutex mtx;
+	};
+
+	// replaces what the record last reported with new values
+	void Report(ChunkRecord& record, const size_t (&bytes)[CategoryCount], unsigned typeWidth);
+
+	// removes everything the record reported (when the chunk is destroyed)
+	void Retract(ChunkRecord& record);
+
+	// for memory that doesn't belong to any one chunk's record
+	void Add(Category category, size_t bytes);
+	void Remove(Category category, size_t bytes);
+
+	struct Totals
+	{
+		size_t bytes[CategoryCount] = {};
+		size_t chunks = 0;
+		size_t sizeHistogram[SizeBuckets] = {};
+		size_t widthHistogram[WidthBuckets] = {};
+
+		size_t Total() const;
+	};
+
+	Totals GetTotals();
+
+	// totals, histograms and GPU allocator occupancy (null without a GL context) as a JSON document
+	std::string DumpJson();
+	bool DumpJson(const std::string& path);
+}
@@ -0,0 +1,121 @@
+#include "stdafx.h"
+#include "MeshArena.h"
+#include <utility>
+
+
+MeshBuffer::MeshBuffer(MeshBuffer&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+
+MeshBuffer& MeshBuffer::operator=(MeshBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		owner_ = std::move(other.owner_);
+		data_ = std::exchange(other.data_, nullptr);
+		blockInts_ = std::exchange(other.blockInts_, 0);
+		vertexSize_ = std::exchange(other.vertexSize_, 0);
+		vertexCapacity_ = std::exchange(other.vertexCapacity_, 0);
+		pointSize_ = std::exchange(other.pointSize_, 0);
+		pointCapacity_ = std::exchange(other.pointCapacity_, 0);
+	}
+	return *this;
+}
+
+
+MeshBuffer::~MeshBuffer()
+{
+	release();
+}
+
+
+void MeshBuffer::release()
+{
+	if (data_)
+		owner_->release(data_, blockInts_);
+	owner_.reset();
+	data_ = nullptr;
+	blockInts_ = vertexSize_ = vertexCapacity_ = pointSize_ = pointCapacity_ = 0;
+}
+
+
+MeshArena::~MeshArena()
+{
+	for (int c = 0; c < ClassCount; c++)
+	{
+		for (GLint* block : free_[c])
+		{
+			pooledBytes_ -= (size_t(1) << (MinClassLog2 + c)) * sizeof(GLint);
+			delete[] block;
+		}
+	}
+}
+
+
+MeshArena& MeshArena::Local()
+{
+	thread_local static std::shared_ptr<MeshArena> arena = std::make_shared<MeshArena>();
+	return *arena;
+}
+
+
+// the smallest class that fits, or -1 if it's too big to pool
+int MeshArena::sizeClass(size_t ints)
+{
+	for (int c = 0; c < ClassCount; c++)
+		if (ints <= size_t(1) << (MinClassLog2 + c))
+			return c;
+	return -1;
+}
+
+
+MeshBuffer MeshArena::Acquire(size_t vertexInts, size_t pointInts)
+{
+	size_t ints = vertexInts + pointInts;
+	int c = sizeClass(ints);
+	size_t blockInts = c == -1 ? ints : size_t(1) << (MinClassLog2 + c);
+
+	GLint* block = nullptr;
+	if (c != -1)
+	{
+		std::lock_guard lk(mtx_);
+		if (!free_[c].empty())
+		{
+			block = free_[c].back();
+			free_[c].pop_back();
+			pooledBytes_ -= blockInts * sizeof(GLint);
+		}
+	}
+	if (!block)
+		block = new GLint[blockInts];
+	outstandingBytes_ += blockInts * sizeof(GLint);
+
+	MeshBuffer ret;
+	ret.owner_ = shared_from_this();
+	ret.data_ = block;
+	ret.blockInts_ = blockInts;
+	ret.vertexCapacity_ = vertexInts;
+	ret.pointCapacity_ = pointInts;
+	return ret;
+}
+
+
+void MeshArena::release(GLint* block, size_t ints)
+{
+	outstandingBytes_ -= ints * sizeof(GLint);
+	int c = sizeClass(ints);
+	if (c != -1 && (size_t(1) << (MinClassLog2 + c)) == ints)
+	{
+		std::lock_guard lk(mtx_);
+		if (free_[c].size() < MaxPooledPerClass)
+		{
+			free_[c].push_back(block);
+			pooledBytes_ += ints * sizeof(GLint);
+			return;
+		}
+	}
+	delete[] block;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class MeshArena;
+
+// the mesh output of one chunk: the interleaved vertex stream, followed by the splat points
+// its memory comes from the arena of the thread that built the mesh, and goes back to
+// that arena when the buffer is destroyed (usually on the thread that uploaded it)
+class MeshBuffer
+{
+public:
+	MeshBuffer() = default;
+	MeshBuffer(MeshBuffer&& other) noexcept;
+	MeshBuffer& operator=(MeshBuffer&& other) noexcept;
+	~MeshBuffer();
+
+	explicit operator bool() const { return data_ != nullptr; }
+
+	void PushVertex(GLint v)
+	{
+		ASSERT(vertexSize_ < vertexCapacity_);
+		data_[vertexSize_++] = v;
+	}
+
+	// room for n more vertex ints, for the caller to fill in
+	GLint* ExtendVertices(size_t n)
+	{
+		ASSERT(vertexSize_ + n <= vertexCapacity_);
+		GLint* p = data_ + vertexSize_;
+		vertexSize_ += n;
+		return p;
+	}
+
+	void PushPoint(GLint p)
+	{
+		ASSERT(pointSize_ < pointCapacity_);
+		data_[vertexCapacity_ + pointSize_++] = p;
+	}
+
+	const GLint* Vertices() const { return data_; }
+	size_t VertexInts() const { return vertexSize_; }
+	const GLint* Points() const { return data_ + vertexCapacity_; }
+	size_t PointInts() const { return pointSize_; }
+
+	// bytes of the block backing this buffer
+	size_t CapacityBytes() const { return blockInts_ * sizeof(GLint); }
+
+private:
+	friend class MeshArena;
+	void release();
+
+	std::shared_ptr<MeshArena> owner_; // keeps the arena alive after its thread exits
+	GLint* data_ = nullptr;
+	size_t blockInts_ = 0;
+	size_t vertexSize_ = 0;
+	size_t vertexCapacity_ = 0;
+	size_t pointSize_ = 0;
+	size_t pointCapacity_ = 0;
+};
+
+
+// per-thread pool of mesh output blocks, in power of two sizes
+// once every size a thread needs has been used, meshing allocates nothing
+class MeshArena : public std::enable_shared_from_this<MeshArena>
+{
+public:
+	~MeshArena();
+
+	// the calling thread's arena
+	static MeshArena& Local();
+
+	// a buffer with room for exactly this many ints in each stream
+	MeshBuffer Acquire(size_t vertexInts, size_t pointInts);
+
+	// totals over every arena
+	static size_t PooledBytes() { return pooledBytes_; }
+	static size_t OutstandingBytes() { return outstandingBytes_; }
+
+private:
+	friend class MeshBuffer;
+
+	// called by buffers from any thread
+	void release(GLint* block, size_t ints);
+
+	static constexpr int MinClassLog2 = 8; // 1KB, a section with a few faces
+	static constexpr int ClassCount = 14;  // up to 8MB, bigger blocks aren't pooled
+	static constexpr size_t MaxPooledPerClass = 4;
+
+	static int sizeClass(size_t ints);
+
+	std::mutex mtx_;
+	std::vector<GLint*> free_[ClassCount];
+
+	static inline std::atomic<size_t> pooledBytes_ = 0;
+	static inline std::atomic<size_t> outstandingBytes_ = 0;
+};
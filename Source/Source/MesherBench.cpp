@@ -0,0 +1,168 @@
+#include "stdafx.h"
+#include "MesherBench.h"
+#include "WorldGen2.h"
+#include "ChunkStorage.h"
+#include "MeshArena.h"
+#include "settings.h"
+#include "JobSystem.h"
+#include <vao.h>
+#include <vbo.h>
+#include <cstring>
+
+
+namespace MesherBench
+{
+	namespace
+	{
+		const char* mesherName(const Options& opts)
+		{
+			static const char* lods[] = { "lod1", "lod2", "lod3" };
+			if (opts.lod > 0)
+				return lods[opts.lod - 1];
+			return opts.greedy ? "greedy" : "naive";
+		}
+
+		// the value at quantile q of sorted samples
+		double quantile(const std::vector<double>& sorted, double q)
+		{
+			size_t i = std::min(sorted.size() - 1, size_t(q * sorted.size()));
+			return sorted[i];
+		}
+	}
+
+
+	ParseResult ParseArgs(int argc, char** argv, Options& opts)
+	{
+		// without --bench-mesher the arguments are the game's
+		bool bench = std::any_of(argv + 1, argv + argc, [](const char* arg)
+		{
+			return std::strcmp(arg, "--bench-mesher") == 0;
+		});
+		if (!bench)
+			return ParseResult::NotRequested;
+
+		bool valid = true;
+		for (int i = 1; i < argc; i++)
+		{
+			const char* arg = argv[i];
+			int left = argc - i - 1; // values after this argument
+			if (std::strcmp(arg, "--bench-mesher") == 0)
+				continue;
+			if (std::strcmp(arg, "--threads") == 0 && left >= 1)
+				opts.threads = std::max(0, std::atoi(argv[++i]));
+			else if (std::strcmp(arg, "--passes") == 0 && left >= 1)
+				opts.passes = std::max(1, std::atoi(argv[++i]));
+			else if (std::strcmp(arg, "--compact") == 0)
+				opts.compact = true;
+			else if (std::strcmp(arg, "--majority") == 0)
+				opts.majority = true;
+			else if (std::strcmp(arg, "--mesher") == 0 && left >= 1)
+			{
+				const char* mode = argv[++i];
+				if (std::strcmp(mode, "naive") == 0 || std::strcmp(mode, "greedy") == 0)
+				{
+					opts.greedy = mode[0] == 'g';
+					opts.lod = 0;
+				}
+				else if (std::strncmp(mode, "lod", 3) == 0 && mode[3] >= '1' && mode[3] <= '3' && mode[4] == '\0')
+					opts.lod = mode[3] - '0';
+				else
+				{
+					printf("Unknown mesher '%s' (naive, greedy, lod1, lod2 or lod3)\n", mode);
+					valid = false;
+				}
+			}
+			else if (std::strcmp(arg, "--region") == 0 && left >= 6)
+			{
+				for (int c = 0; c < 3; c++)
+					opts.low[c] = std::atoi(argv[++i]);
+				for (int c = 0; c < 3; c++)
+					opts.high[c] = std::atoi(argv[++i]);
+				opts.high = glm::max(opts.high, opts.low + 1);
+			}
+			else if (std::strcmp(arg, "--dump-memory") == 0 && left >= 1)
+				i++; // main's option
+			else
+			{
+				printf("Unknown or incomplete argument '%s'\n", arg);
+				valid = false;
+			}
+		}
+		return valid ? ParseResult::Ok : ParseResult::Invalid;
+	}
+
+
+	int Run(const Options& opts)
+	{
+		int threads = opts.threads > 0 ? opts.threads : std::max(1, int(std::thread::hardware_concurrency()));
+		Settings::Graphics.lodMajority = opts.majority;
+
+		// WorldGen2 is seeded with constants, so the same region always has the same blocks
+		high_resolution_clock::time_point genStart = high_resolution_clock::now();
+		WorldGen2::SetBounds(opts.low, opts.high);
+		WorldGen2::Init();
+		WorldGen2::GenerateWorld();
+		double genSeconds = duration_cast<duration<double>>(high_resolution_clock::now() - genStart).count();
+		printf("\n");
+
+		// sorted, so the order chunks are meshed in doesn't depend on the map
+		std::vector<ChunkPtr> chunks;
+		ChunkStorage::GetMapRaw().ForEach([&](const glm::ivec3&, ChunkPtr chunk)
+		{
+			chunks.push_back(chunk);
+		});
+		std::sort(chunks.begin(), chunks.end(), [](ChunkPtr a, ChunkPtr b)
+		{
+			glm::ivec3 pa = a->GetPos(), pb = b->GetPos();
+			return std::tie(pa.x, pa.y, pa.z) < std::tie(pb.x, pb.y, pb.z);
+		});
+		if (chunks.empty())
+		{
+			printf("Mesher benchmark: the region has no solid chunks\n");
+			return 1;
+		}
+		for (ChunkPtr chunk : chunks)
+			chunk->GetMesh().SetLod(opts.lod);
+
+		// a job per chunk on the same job system as the game's chunk pipeline
+		// passes don't overlap, so a chunk is never meshed by two threads at once
+		JobSystem jobs(threads);
+		std::vector<double> samples(chunks.size() * opts.passes);
+		high_resolution_clock::time_point start = high_resolution_clock::now();
+		for (int pass = 0; pass < opts.passes; pass++)
+		{
+			double* passSamples = samples.data() + pass * chunks.size();
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				jobs.Submit([&, i]
+				{
+					high_resolution_clock::time_point begin = high_resolution_clock::now();
+					chunks[i]->GetMesh().BuildMesh(opts.greedy, opts.compact);
+					passSamples[i] = duration_cast<duration<double>>(high_resolution_clock::now() - begin).count() * 1000;
+				});
+			}
+			jobs.WaitIdle();
+		}
+		double seconds = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+
+		// the last pass's meshes are still staged
+		size_t vertices = 0;
+		size_t bytes = 0;
+		for (ChunkPtr chunk : chunks)
+		{
+			vertices += chunk->GetMesh().GetStagedVertexCount();
+			bytes += chunk->GetMesh().GetStagedBytes();
+		}
+		std::sort(samples.begin(), samples.end());
+		double n = double(chunks.size());
+
+		printf("Mesher benchmark: %s%s, %d threads, %zu chunks x %d passes, region (%d %d %d)-(%d %d %d), generated in %.2f s\n",
+			mesherName(opts), opts.compact ? " compact" : "", threads, chunks.size(), opts.passes,
+			opts.low.x, opts.low.y, opts.low.z, opts.high.x, opts.high.y, opts.high.z, genSeconds);
+		printf("chunks/s | p50 ms  | p99 ms  | vertices/chunk | staged KB/chunk | arena MB\n");
+		printf("%8.1f | %7.3f | %7.3f | %14.1f | %15.2f | %8.2f\n",
+			samples.size() / seconds, quantile(samples, .5), quantile(samples, .99),
+			vertices / n, bytes / n / 1024, (MeshArena::PooledBytes() + MeshArena::OutstandingBytes()) / 1048576.0);
+		return 0;
+	}
+}
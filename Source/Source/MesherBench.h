@@ -0,0 +1,32 @@
+#pragma once
+
+// headless mesher benchmark: generates a fixed WorldGen2 region and meshes every chunk
+// on a number of threads, without a window or a GL context
+// run as: Source --bench-mesher [--threads N] [--mesher naive|greedy|lod1|lod2|lod3] [--compact]
+//         [--majority] [--passes N] [--region x0 y0 z0 x1 y1 z1]
+namespace MesherBench
+{
+	struct Options
+	{
+		glm::ivec3 low{ 0, 0, 0 };    // chunks [low, high) of the world to generate
+		glm::ivec3 high{ 10, 10, 10 };
+		int threads = 0;              // 0 is one per hardware thread
+		bool greedy = false;
+		bool compact = false;
+		int lod = 0;
+		bool majority = false;        // LOD reduction (surface otherwise)
+		int passes = 1;               // times every chunk is meshed
+	};
+
+	enum class ParseResult
+	{
+		NotRequested, // no --bench-mesher
+		Ok,           // the options are parsed into opts
+		Invalid,      // an unknown or malformed option was reported, the benchmark shouldn't run
+	};
+
+	ParseResult ParseArgs(int argc, char** argv, Options& opts);
+
+	// prints chunks/s, p50/p99 ms per chunk, vertices and bytes per chunk, and returns the exit code
+	int Run(const Options& opts);
+}
@@ -12,6 +12,8 @@
 #include "block.h"
 #include "TextureArray.h"
 #include <texture.h>
+#include <Vertices.h>
+#include "settings.h"
 
 namespace NuRenderer
 {
@@ -50,6 +52,7 @@ namespace NuRenderer
 	void CompileShaders()
 	{
 		Shader::shaders["chunk_optimized"] = new Shader("chunk_optimized.vs", "chunk_optimized.fs");
+		Shader::shaders["chunk_compact"] = new Shader("chunk_compact.vs", "chunk_optimized.fs");
 		Shader::shaders["chunk_splat"] = new Shader("chunk_splat.vs", "chunk_splat.fs");
 		Shader::shaders["compact_batch"] = new Shader("compact_batch.cs");
 		Shader::shaders["textured_array"] = new Shader("textured_array.vs", "textured_array.fs");
@@ -105,8 +108,12 @@ namespace NuRenderer
 		glCullFace(GL_BACK); // don't forget to reset original culling face
 
 		// render blocks in each active chunk
-		ShaderPtr currShader = Shader::shaders["chunk_optimized"];
+		// the compact format expands quad records in its vertex shader, but shades the same
+		bool compact = Settings::Graphics.compactVertices;
+		ShaderPtr currShader = Shader::shaders[compact ? "chunk_compact" : "chunk_optimized"];
 		currShader->Use();
+		if (compact)
+			currShader->set1FloatArray("u_cubeCorners", Vertices::cube_light, 72);
 
 		Camera* cam = Renderer::GetPipeline()->GetCamera(0);
 		float angle = glm::max(glm::dot(-glm::normalize(Renderer::activeSun_->GetDir()), glm::vec3(0, 1, 0)), 0.f);
@@ -149,12 +156,8 @@ namespace NuRenderer
 
 
 
-		auto& chunks = ChunkStorage::GetMapRaw();
-		auto it = chunks.begin();
-		auto end = chunks.end();
-		for (int i = 0; it != end; ++it)
+		ChunkStorage::GetMapRaw().ForEach([&](const glm::ivec3&, ChunkPtr chunk)
 		{
-			ChunkPtr chunk = it->second;
 			if (chunk 
 				&& chunk->IsVisible(*cam) 
 				//&& glm::distance(cam->GetPos(), glm::vec3(chunk->GetPos() * Chunk::CHUNK_SIZE)) < 200
@@ -165,7 +168,7 @@ namespace NuRenderer
 				chunk->Render();
 				drawCalls++;
 			}
-		}
+		});
 	}
 
 
@@ -207,10 +210,8 @@ namespace NuRenderer
 
 
 
-		std::for_each(ChunkStorage::GetMapRaw().begin(), ChunkStorage::GetMapRaw().end(),
-			[&](const std::pair<glm::ivec3, Chunk*>& pair)
+		ChunkStorage::GetMapRaw().ForEach([&](const glm::ivec3&, ChunkPtr chunk)
 		{
-			ChunkPtr chunk = pair.second;
 			if (chunk && chunk->IsVisible(*cam) &&
 				glm::distance(cam->GetPos(), glm::vec3(chunk->GetPos() * Chunk::CHUNK_SIZE)) >= 200)
 			{
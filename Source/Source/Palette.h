@@ -1,8 +1,29 @@
 #pragma once
 #include "BitArray.h"
+#include "Epoch.h"
 #include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <algorithm>
+#include <optional>
+
+// breakdown of the heap memory owned by a palette
+struct PaletteMemory
+{
+	size_t bitstream = 0; // packed indices (or raw values for dense storage)
+	size_t entries = 0;   // palette entries and the value->index table
+	unsigned entryLength = 0;
+
+	size_t Total() const { return bitstream + entries; }
+};
+
 
 // fixed-size array optimized for space
+// while every element holds the same value the index length is zero, so
+// no bitstream is allocated at all until the first differing write
 template<typename T, unsigned _Size>
 class Palette
 {
@@ -15,7 +36,26 @@ public:
 	void SetVal(int index, T);
 	T GetVal(int index) const;
 
-private:
+	// bulk access to all _Size values
+	// Import rebuilds the palette from scratch out of a histogram of the input
+	void Export(T* out) const;
+	void Import(const T* in);
+
+	// Export for a cube of edge^3 elements, with rows (along x) rowStride and slices (along z)
+	// sliceStride elements apart in out, so it can write straight into the inside of a padded array
+	void Export(T* out, unsigned edge, size_t rowStride, size_t sliceStride) const;
+
+	// the value of every element, if they are all the same
+	std::optional<T> Uniform() const;
+
+	// bits per element in the bitstream
+	unsigned EntryLength() const { return paletteEntryLength_; }
+
+	// heap bytes owned by the palette
+	size_t MemoryUsage() const;
+	PaletteMemory GetMemoryInfo() const;
+
+protected:
 	struct PaletteEntry
 	{
 		T type;
@@ -25,34 +65,78 @@ private:
 	unsigned newPaletteEntry();
 	void growPalette();
 	void fitPalette();
+	static void exportFrom(const uint64_t* words, const PaletteEntry* entries,
+		unsigned entryLength, T* out);
+
+	// replaces the bitstream and entries after the palette is resized
+	void commitStorage(BitArray&& data, std::vector<PaletteEntry>&& palette);
+
+	// open-addressed (linear probing) map of live values to their palette index
+	int findIndex(const T& type) const;
+	void insertIndex(unsigned paletteIndex);
+	void eraseIndex(unsigned paletteIndex);
+	void rebuildIndex();
+	size_t homeSlot(const T& type) const;
 
 	BitArray data_;
 	std::vector<PaletteEntry> palette_;
-	unsigned paletteEntryLength_ = 1;
+	std::vector<uint32_t> lookup_; // palette index + 1, or 0 if the slot is empty
+	unsigned paletteEntryLength_ = 0;
+	unsigned liveEntries_ = 1; // palette entries with a nonzero refcount
+
+	// when set, storage replaced by a resize is kept here instead of being freed,
+	// for the owner to retire (see Epoch) once readers that don't take a lock can't find it
+	bool retainStorage_ = false;
+	std::vector<BitArray> retiredData_;
+	std::vector<std::vector<PaletteEntry>> retiredPalettes_;
 };
 
 
 // thread-safe variation of the palette
+// writes are exclusive, reads are optimistic (seqlock): a reader never writes
+// shared memory, it just retries if a write happened while it was reading
+// storage that a reader may be looking at is retired instead of freed (see Epoch),
+// so a torn read can only produce a wrong value, which the retry then discards
 template<typename T, unsigned _Size>
 class ConcurrentPalette : public Palette<T, _Size>
 {
 public:
+	ConcurrentPalette();
+	ConcurrentPalette(const ConcurrentPalette&) = delete;
+	ConcurrentPalette& operator=(const ConcurrentPalette&) = delete;
 
-	void SetVal(int index, T val)
-	{
-		std::lock_guard w(mtx);
-		Palette<T, _Size>::SetVal(index, val);
-	}
+	// true if the palette had to be resized, which changes its memory use
+	bool SetVal(int index, T val);
+	T GetVal(int index) const;
+	void Export(T* out) const;
+	void Import(const T* in);
+	std::optional<T> Uniform() const;
 
-	T GetVal(int index) const
-	{
-		std::shared_lock r(mtx);
-		return Palette<T, _Size>::GetVal(index);
-	}
+	// plain (single-threaded) copy of the current contents
+	Palette<T, _Size> Copy() const;
+
+	size_t MemoryUsage() const;
+	PaletteMemory GetMemoryInfo() const;
 
 private:
-	// writes are exclusive, but not reads
-	mutable std::shared_mutex mtx;
+	using Entry = typename Palette<T, _Size>::PaletteEntry;
+
+	// where the storage currently lives, republished whenever it moves
+	struct View
+	{
+		const uint64_t* words;
+		const Entry* entries;
+		unsigned entryLength;
+	};
+
+	// must be called by the writer while holding the lock
+	// points readers at the current storage, then retires the storage and view it replaced
+	void publish();
+
+	mutable std::mutex mtx;
+	std::atomic<uint32_t> seq_ = 0; // odd while a write is in progress
+	std::atomic<const View*> view_ = nullptr;
+	std::unique_ptr<View> ownedView_;
 };
 
 #include "Palette.inl"
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 #include "Palette.h"
-#include <shared_mutex>
+#include <thread>
 
 template<typename T, unsigned _Size>
 Palette<T, _Size>::Palette()
@@ -8,6 +8,7 @@ Palette<T, _Size>::Palette()
 	data_.Resize(_Size * paletteEntryLength_);
 	palette_.resize(1u << paletteEntryLength_);
 	palette_[0].refcount = _Size;
+	rebuildIndex();
 }
 
 template<typename T, unsigned _Size>
@@ -25,7 +26,9 @@ Palette<T, _Size>& Palette<T, _Size>::operator=(const Palette& other)
 {
 	this->data_ = other.data_;
 	this->palette_ = other.palette_;
+	this->lookup_ = other.lookup_;
 	this->paletteEntryLength_ = other.paletteEntryLength_;
+	this->liveEntries_ = other.liveEntries_;
 	return *this;
 }
 
@@ -37,34 +40,45 @@ void Palette<T, _Size>::SetVal(int index, T type)
 	unsigned paletteIndex = data_.GetSequence(index * paletteEntryLength_, paletteEntryLength_);
 	auto& current = palette_[paletteIndex]; // compiler forces me to make this auto
 
-	// remove reference to block that is already there
-	current.refcount--;
+	// block is already there, nothing to do
+	if (current.type == type)
+		return;
 
 	// check if block type is already in palette
-	int replaceIndex = -1;
-	for (int i = 0; i < palette_.size(); i++)
+	int replaceIndex = findIndex(type);
+	if (replaceIndex != -1)
 	{
-		if (palette_[i].type == type)
+		// use existing palette entry
+		data_.SetSequence(index * paletteEntryLength_, paletteEntryLength_, unsigned(replaceIndex));
+		palette_[replaceIndex].refcount++;
+
+		// remove reference to block that was there
+		if (--current.refcount == 0)
 		{
-			replaceIndex = i;
-			// use existing palette entry
-			data_.SetSequence(index * paletteEntryLength_, paletteEntryLength_, unsigned(replaceIndex));
-			palette_[replaceIndex].refcount++;
-			return;
+			eraseIndex(paletteIndex);
+			liveEntries_--;
+			fitPalette();
 		}
+		return;
 	}
 
-	// check if palette entry of block we just removed is empty
-	if (current.refcount == 0)
+	// check if palette entry of block we are removing would become empty
+	if (current.refcount == 1)
 	{
+		eraseIndex(paletteIndex);
 		current.type = type;
-		current.refcount = 1;
+		insertIndex(paletteIndex);
 		return;
 	}
 
+	// remove reference to block that is already there
+	current.refcount--;
+
 	// we need a new palette entry, dawg
 	unsigned newEntry = newPaletteEntry();
 	palette_[newEntry] = { type, 1 };
+	insertIndex(newEntry);
+	liveEntries_++;
 	data_.SetSequence(index * paletteEntryLength_, paletteEntryLength_, newEntry);
 }
 
@@ -78,89 +92,451 @@ T Palette<T, _Size>::GetVal(int index) const
 }
 
 template<typename T, unsigned _Size>
-unsigned Palette<T, _Size>::newPaletteEntry()
+void Palette<T, _Size>::Export(T* out) const
 {
-	while (1)
+	exportFrom(data_.Data(), palette_.data(), paletteEntryLength_, out);
+}
+
+// whole rows are decoded a batch at a time, then each is mapped to values where it goes
+template<typename T, unsigned _Size>
+void Palette<T, _Size>::Export(T* out, unsigned edge, size_t rowStride, size_t sliceStride) const
+{
+	constexpr unsigned batch = 1024;
+	ASSERT(edge * edge * edge == _Size && edge <= batch);
+	uint16_t indices[batch];
+	const unsigned rowsPerBatch = batch / edge;
+	const unsigned rowCount = edge * edge;
+	for (unsigned firstRow = 0; firstRow < rowCount; firstRow += rowsPerBatch)
 	{
-		// find index of free palette entry
-		for (int i = 0; i < palette_.size(); i++)
-			if (palette_[i].refcount == 0) // empty or uninitialized entry
-				return i;
+		unsigned rows = std::min(rowsPerBatch, rowCount - firstRow);
+		data_.DecodeRange(paletteEntryLength_, firstRow * edge, rows * edge, indices);
+		for (unsigned r = 0; r < rows; r++)
+		{
+			unsigned y = (firstRow + r) % edge;
+			unsigned z = (firstRow + r) / edge;
+			T* dst = out + y * rowStride + z * sliceStride;
+			const uint16_t* src = indices + r * edge;
+			for (unsigned x = 0; x < edge; x++)
+				dst[x] = palette_[src[x]].type;
+		}
+	}
+}
 
-		// grow palette if no free entry
-		growPalette();
+template<typename T, unsigned _Size>
+void Palette<T, _Size>::Import(const T* in)
+{
+	// histogram of the input, built alongside the indices
+	// runs of the same value (very common in terrain) skip the hash lookup
+	std::unordered_map<T, uint16_t> histogram;
+	std::vector<PaletteEntry> entries;
+	std::vector<uint16_t> indices(_Size);
+	for (unsigned i = 0; i < _Size; i++)
+	{
+		if (i > 0 && in[i] == in[i - 1])
+		{
+			indices[i] = indices[i - 1];
+			entries[indices[i]].refcount++;
+			continue;
+		}
+
+		auto [it, inserted] = histogram.try_emplace(in[i], uint16_t(entries.size()));
+		if (inserted)
+			entries.push_back({ in[i], 0 });
+		indices[i] = it->second;
+		entries[it->second].refcount++;
 	}
+
+	// smallest length that fits every distinct value
+	unsigned newLength = 0;
+	while ((1u << newLength) < entries.size())
+		newLength++;
+	entries.resize(1u << newLength);
+
+	paletteEntryLength_ = newLength;
+	BitArray newData(_Size * paletteEntryLength_);
+	newData.EncodeRange(paletteEntryLength_, 0, _Size, indices.data());
+
+	commitStorage(std::move(newData), std::move(entries));
+	rebuildIndex();
+}
+
+// decodes indices a batch at a time so they stay in cache before being mapped to values
+template<typename T, unsigned _Size>
+void Palette<T, _Size>::exportFrom(const uint64_t* words, const PaletteEntry* entries,
+	unsigned entryLength, T* out)
+{
+	constexpr unsigned batch = 1024;
+	uint16_t indices[batch];
+	for (unsigned first = 0; first < _Size; first += batch)
+	{
+		unsigned count = std::min(batch, _Size - first);
+		BitArray::DecodeRange(words, entryLength, first, count, indices);
+		for (unsigned i = 0; i < count; i++)
+			out[first + i] = entries[indices[i]].type;
+	}
+}
+
+template<typename T, unsigned _Size>
+std::optional<T> Palette<T, _Size>::Uniform() const
+{
+	if (paletteEntryLength_ == 0)
+		return palette_[0].type;
+	return std::nullopt;
+}
+
+template<typename T, unsigned _Size>
+size_t Palette<T, _Size>::MemoryUsage() const
+{
+	return GetMemoryInfo().Total();
+}
+
+template<typename T, unsigned _Size>
+PaletteMemory Palette<T, _Size>::GetMemoryInfo() const
+{
+	PaletteMemory ret;
+	ret.bitstream = data_.ByteSize();
+	ret.entries = palette_.capacity() * sizeof(PaletteEntry) +
+		lookup_.capacity() * sizeof(uint32_t);
+	ret.entryLength = paletteEntryLength_;
+	return ret;
+}
+
+template<typename T, unsigned _Size>
+unsigned Palette<T, _Size>::newPaletteEntry()
+{
+	// grow palette if no free entry
+	if (liveEntries_ == palette_.size())
+		growPalette();
+
+	// find index of free palette entry
+	for (int i = 0; i < palette_.size(); i++)
+		if (palette_[i].refcount == 0) // empty or uninitialized entry
+			return i;
+
+	ASSERT_MSG(false, "Palette has no free entries after growing!");
+	return 0;
 }
 
 template<typename T, unsigned _Size>
 void Palette<T, _Size>::growPalette()
 {
 	// decode indices (index into palette_)
-	std::vector<unsigned> indices;
-	indices.resize(_Size);
-	for (int i = 0; i < _Size; i++)
-		indices[i] = data_.GetSequence(i * paletteEntryLength_, paletteEntryLength_);
+	std::vector<uint16_t> indices(_Size);
+	data_.DecodeRange(paletteEntryLength_, 0, _Size, indices.data());
 
 	// double length of palette
 	//paletteEntryLength_ <<= 1;
 	paletteEntryLength_++;
-	palette_.resize(1u << paletteEntryLength_);
+	std::vector<PaletteEntry> newPalette(1u << paletteEntryLength_);
+	std::copy(palette_.begin(), palette_.end(), newPalette.begin());
 
 	// increase length of bitset to accommodate extra bit
-	data_.Resize(_Size * paletteEntryLength_);
+	BitArray newData(_Size * paletteEntryLength_);
 
 	// encode previous indices with extended length
-	for (int i = 0; i < indices.size(); i++)
-		data_.SetSequence(i * paletteEntryLength_, paletteEntryLength_, indices[i]);
+	newData.EncodeRange(paletteEntryLength_, 0, _Size, indices.data());
+
+	commitStorage(std::move(newData), std::move(newPalette));
+	rebuildIndex();
 }
 
+// https://www.reddit.com/r/VoxelGameDev/comments/9yu8qy/palettebased_compression_for_chunked_discrete/
+// compacts live entries to the front of the palette and shrinks the index length
+// only shrinks once a quarter or less of the palette is in use, so the palette
+// doesn't thrash between two sizes when values are added and removed repeatedly
+// the exception is a single remaining value, which always drops the bitstream
 template<typename T, unsigned _Size>
 inline void Palette<T, _Size>::fitPalette()
 {
-	// Remove old entries...
-	for (int i = 0; i < palette_.size(); i++) {
-		if (palette_[i].refcount == 0)
+	// is the palette uniform or less than a quarter full?
+	bool uniform = liveEntries_ == 1;
+	if (paletteEntryLength_ == 0 ||
+		(!uniform && (paletteEntryLength_ <= 1 || liveEntries_ > palette_.size() / 4)))
+		return; // NO: the palette cannot be shrunk!
+
+	// smallest length that leaves at least one free entry (or zero if uniform)
+	unsigned newLength = 0;
+	if (!uniform)
+		while ((1u << newLength) <= liveEntries_)
+			newLength++;
+
+	// decode all indices
+	std::vector<uint16_t> indices(_Size);
+	data_.DecodeRange(paletteEntryLength_, 0, _Size, indices.data());
+
+	// move live entries to the front of a smaller palette
+	std::vector<uint16_t> remap(palette_.size());
+	std::vector<PaletteEntry> newPalette(1u << newLength);
+	unsigned paletteCounter = 0;
+	for (unsigned i = 0; i < palette_.size(); i++)
+	{
+		if (palette_[i].refcount > 0)
 		{
-			palette[i] = null;
-			paletteCount -= 1;
+			remap[i] = uint16_t(paletteCounter);
+			newPalette[paletteCounter++] = palette_[i];
 		}
 	}
 
-	// Is the palette less than half of its closest power-of-two?
-	if (paletteCount > powerOfTwo(paletteCount) / 2) {
-		// NO: The palette cannot be shrunk!
-		return;
+	// re-encode the indices with the new length
+	for (auto& index : indices)
+		index = remap[index];
+	paletteEntryLength_ = newLength;
+	BitArray newData(_Size * paletteEntryLength_);
+	newData.EncodeRange(paletteEntryLength_, 0, _Size, indices.data());
+
+	commitStorage(std::move(newData), std::move(newPalette));
+	rebuildIndex();
+}
+
+template<typename T, unsigned _Size>
+inline void Palette<T, _Size>::commitStorage(BitArray&& data, std::vector<PaletteEntry>&& palette)
+{
+	if (retainStorage_)
+	{
+		// moving keeps the old buffers at the same address
+		retiredData_.push_back(std::move(data_));
+		retiredPalettes_.push_back(std::move(palette_));
 	}
+	data_ = std::move(data);
+	palette_ = std::move(palette);
+}
 
-	// decode all indices
-	int[] indices = new int[size];
-	for (int i = 0; i < indices.length; i++) {
-		indices[i] = data.get(i * indicesLength, indicesLength);
+template<typename T, unsigned _Size>
+inline size_t Palette<T, _Size>::homeSlot(const T& type) const
+{
+	// fibonacci hashing, the table size is a power of two
+	uint64_t h = uint64_t(std::hash<T>()(type)) * 0x9E3779B97F4A7C15ull;
+	return size_t(h >> 32) & (lookup_.size() - 1);
+}
+
+template<typename T, unsigned _Size>
+inline int Palette<T, _Size>::findIndex(const T& type) const
+{
+	const size_t mask = lookup_.size() - 1;
+	for (size_t i = homeSlot(type); lookup_[i] != 0; i = (i + 1) & mask)
+		if (palette_[lookup_[i] - 1].type == type)
+			return int(lookup_[i] - 1);
+	return -1;
+}
+
+template<typename T, unsigned _Size>
+inline void Palette<T, _Size>::insertIndex(unsigned paletteIndex)
+{
+	const size_t mask = lookup_.size() - 1;
+	size_t i = homeSlot(palette_[paletteIndex].type);
+	while (lookup_[i] != 0)
+		i = (i + 1) & mask;
+	lookup_[i] = paletteIndex + 1;
+}
+
+// backward shift deletion, so no tombstones are needed
+template<typename T, unsigned _Size>
+inline void Palette<T, _Size>::eraseIndex(unsigned paletteIndex)
+{
+	const size_t mask = lookup_.size() - 1;
+	size_t i = homeSlot(palette_[paletteIndex].type);
+	while (lookup_[i] != paletteIndex + 1)
+		i = (i + 1) & mask;
+
+	for (size_t j = (i + 1) & mask; lookup_[j] != 0; j = (j + 1) & mask)
+	{
+		// move entry at j into the hole if its home slot is not in (i, j]
+		size_t home = homeSlot(palette_[lookup_[j] - 1].type);
+		if (((j - home) & mask) >= ((j - i) & mask))
+		{
+			lookup_[i] = lookup_[j];
+			i = j;
+		}
 	}
+	lookup_[i] = 0;
+}
 
-	// Create new palette, halfing it in size
-	indicesLength = indicesLength >> 1;
-	PaletteEntry[] newPalette = new PaletteEntry[2 pow indicesLength];
+template<typename T, unsigned _Size>
+inline void Palette<T, _Size>::rebuildIndex()
+{
+	// keep the load factor at or below one half
+	lookup_.assign(palette_.size() * 2, 0);
+	liveEntries_ = 0;
+	for (unsigned i = 0; i < palette_.size(); i++)
+	{
+		if (palette_[i].refcount > 0)
+		{
+			insertIndex(i);
+			liveEntries_++;
+		}
+	}
+}
 
-	// We gotta compress the palette entries!
-	int paletteCounter = 0;
-	for (int pi = 0; pi < palette.length; pi++, paletteCounter++) {
-		PaletteEntry entry = newPalette[paletteCounter] = palette[pi];
 
-		// Re-encode the indices (find and replace; with limit)
-		for (int di = 0, fc = 0; di < indices.length && fc < entry.refcount; di++) {
-			if (pi == indices[di]) {
-				indices[di] = paletteCounter;
-				fc += 1;
+
+
+template<typename T, unsigned _Size>
+ConcurrentPalette<T, _Size>::ConcurrentPalette()
+{
+	this->retainStorage_ = true;
+	publish();
+}
+
+template<typename T, unsigned _Size>
+bool ConcurrentPalette<T, _Size>::SetVal(int index, T val)
+{
+	std::lock_guard w(mtx);
+
+	// don't make readers retry if nothing would change
+	if (Palette<T, _Size>::GetVal(index) == val)
+		return false;
+	unsigned entryLength = this->paletteEntryLength_; // changes whenever the palette grows or shrinks
+
+	uint32_t seq = seq_.load(std::memory_order_relaxed);
+	seq_.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Palette<T, _Size>::SetVal(index, val);
+	publish();
+
+	seq_.store(seq + 2, std::memory_order_release);
+	return this->paletteEntryLength_ != entryLength;
+}
+
+template<typename T, unsigned _Size>
+T ConcurrentPalette<T, _Size>::GetVal(int index) const
+{
+	Epoch::Guard guard;
+	while (true)
+	{
+		uint32_t seq = seq_.load(std::memory_order_acquire);
+		if (seq & 1)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		const View* view = view_.load();
+		unsigned paletteIndex = BitArray::GetSequence(
+			view->words, index * view->entryLength, view->entryLength);
+		T ret = view->entries[paletteIndex].type;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq_.load(std::memory_order_relaxed) == seq)
+			return ret;
+	}
+}
+
+template<typename T, unsigned _Size>
+void ConcurrentPalette<T, _Size>::Export(T* out) const
+{
+	// a whole-chunk read is long enough to race with writers, so only retry
+	// optimistically a couple of times before waiting for the lock
+	{
+		Epoch::Guard guard;
+		for (int attempt = 0; attempt < 2; attempt++)
+		{
+			uint32_t seq = seq_.load(std::memory_order_acquire);
+			if (seq & 1)
+			{
+				std::this_thread::yield();
+				continue;
 			}
+
+			const View* view = view_.load();
+			Palette<T, _Size>::exportFrom(view->words, view->entries, view->entryLength, out);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (seq_.load(std::memory_order_relaxed) == seq)
+				return;
 		}
 	}
 
-	// Allocate new BitBuffer
-	data = new BitBuffer(size * indicesLength); // the length is in bits, not bytes!
+	std::lock_guard r(mtx);
+	Palette<T, _Size>::Export(out);
+}
+
+template<typename T, unsigned _Size>
+void ConcurrentPalette<T, _Size>::Import(const T* in)
+{
+	std::lock_guard w(mtx);
+
+	uint32_t seq = seq_.load(std::memory_order_relaxed);
+	seq_.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Palette<T, _Size>::Import(in);
+	publish();
 
-	// Encode the indices
-	for (int i = 0; i < indices.length; i++) {
-		data.set(i * indicesLength, indicesLength, indices[i]);
+	seq_.store(seq + 2, std::memory_order_release);
+}
+
+template<typename T, unsigned _Size>
+std::optional<T> ConcurrentPalette<T, _Size>::Uniform() const
+{
+	Epoch::Guard guard;
+	while (true)
+	{
+		uint32_t seq = seq_.load(std::memory_order_acquire);
+		if (seq & 1)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		const View* view = view_.load();
+		std::optional<T> ret;
+		if (view->entryLength == 0)
+			ret = view->entries[0].type;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq_.load(std::memory_order_relaxed) == seq)
+			return ret;
 	}
 }
+
+template<typename T, unsigned _Size>
+Palette<T, _Size> ConcurrentPalette<T, _Size>::Copy() const
+{
+	std::lock_guard r(mtx);
+	return Palette<T, _Size>(*this);
+}
+
+template<typename T, unsigned _Size>
+size_t ConcurrentPalette<T, _Size>::MemoryUsage() const
+{
+	return GetMemoryInfo().Total();
+}
+
+template<typename T, unsigned _Size>
+PaletteMemory ConcurrentPalette<T, _Size>::GetMemoryInfo() const
+{
+	std::lock_guard r(mtx);
+	return Palette<T, _Size>::GetMemoryInfo();
+}
+
+template<typename T, unsigned _Size>
+void ConcurrentPalette<T, _Size>::publish()
+{
+	const View* cur = view_.load(std::memory_order_relaxed);
+	if (cur &&
+		cur->words == this->data_.Data() &&
+		cur->entries == this->palette_.data() &&
+		cur->entryLength == this->paletteEntryLength_)
+		return;
+
+	auto view = std::make_unique<View>(View{ this->data_.Data(), this->palette_.data(), this->paletteEntryLength_ });
+	view_.store(view.get());
+	if (!ownedView_)
+	{
+		ownedView_ = std::move(view);
+		return;
+	}
+
+	// everything the old view pointed at goes with it
+	size_t bytes = sizeof(View);
+	for (const auto& data : this->retiredData_)
+		bytes += data.ByteSize();
+	for (const auto& palette : this->retiredPalettes_)
+		bytes += palette.capacity() * sizeof(Entry);
+	Epoch::Retire(std::make_tuple(std::move(ownedView_), std::move(this->retiredData_),
+		std::move(this->retiredPalettes_)), bytes);
+	this->retiredData_.clear();
+	this->retiredPalettes_.clear();
+	ownedView_ = std::move(view);
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "StagingRing.h"
+
+
+namespace
+{
+	// copies read from the ring at any offset, but keep spans aligned for the memcpys that fill them
+	constexpr GLuint SPAN_ALIGN = 16;
+}
+
+
+StagingRing::StagingRing(GLuint size)
+	: capacity_(size - size % SPAN_ALIGN)
+{
+	// coherent, so writes from any thread are seen by copies recorded after them without flushing
+	constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &gpuHandle_);
+	glNamedBufferStorage(gpuHandle_, capacity_, nullptr, flags);
+	mapped_ = static_cast<GLubyte*>(glMapNamedBufferRange(gpuHandle_, 0, capacity_, flags));
+	ASSERT(mapped_ != nullptr);
+	free_.emplace(0, capacity_);
+}
+
+
+StagingRing::~StagingRing()
+{
+	for (auto [frame, fence] : fences_)
+		glDeleteSync(fence);
+	glUnmapNamedBuffer(gpuHandle_);
+	glDeleteBuffers(1, &gpuHandle_);
+}
+
+
+std::optional<StagingRing::Span> StagingRing::Reserve(GLuint size)
+{
+	ASSERT(size > 0);
+	size += (SPAN_ALIGN - size % SPAN_ALIGN) % SPAN_ALIGN;
+	std::lock_guard lk(mtx_);
+
+	// the first free range after the last span that fits, going around the end of the ring once
+	auto fits = [&](const std::pair<const GLuint, GLuint>& range) { return range.second >= size; };
+	auto start = free_.lower_bound(head_);
+	auto it = std::find_if(start, free_.end(), fits);
+	if (it == free_.end())
+	{
+		it = std::find_if(free_.begin(), start, fits);
+		if (it == start)
+			return std::nullopt; // full, or too fragmented
+	}
+
+	GLuint offset = it->first;
+	GLuint left = it->second - size;
+	it = free_.erase(it);
+	if (left > 0)
+		free_.emplace_hint(it, offset + size, left);
+	head_ = offset + size;
+	used_ += size;
+	return Span{ offset, size, mapped_ + offset };
+}
+
+
+void StagingRing::Release(const Span& span)
+{
+	ASSERT_MSG(span.size > 0 && span.offset + span.size <= capacity_, "Released a span that isn't in the ring!");
+	std::lock_guard lk(mtx_);
+	released_.push_back({ span.offset, span.size, frame_ });
+}
+
+
+void StagingRing::EndFrame()
+{
+	fences_.push_back({ frame_, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+	while (!fences_.empty())
+	{
+		GLenum status = glClientWaitSync(fences_.front().second, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		doneFrames_ = fences_.front().first + 1;
+		glDeleteSync(fences_.front().second);
+		fences_.pop_front();
+	}
+
+	// each span comes back on its own, a span still waiting to be copied doesn't hold back any other
+	std::lock_guard lk(mtx_);
+	while (!released_.empty() && released_.front().frame < doneFrames_)
+	{
+		reclaim(released_.front().offset, released_.front().size);
+		released_.pop_front();
+	}
+	frame_++;
+}
+
+
+GLuint StagingRing::UsedBytes() const
+{
+	std::lock_guard lk(mtx_);
+	return used_;
+}
+
+
+void StagingRing::reclaim(GLuint offset, GLuint size)
+{
+	used_ -= size;
+	auto next = free_.lower_bound(offset);
+	if (next != free_.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = free_.erase(next);
+	}
+	if (next != free_.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+	free_.emplace_hint(next, offset, size);
+}
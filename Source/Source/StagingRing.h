@@ -0,0 +1,69 @@
+#pragma once
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+
+// persistently mapped buffer that meshing threads copy finished meshes into,
+// so uploading one on the main thread is only recording a copy on the GPU
+// space is handed out around the ring (next fit over the free ranges), and each span comes back
+// on its own once it's released and the GPU is done with the frame it was released in (every frame is fenced)
+// so a span that waits for an upload (deferred by the budget, or far away) only holds its own space
+// a span that's never copied (its mesh was replaced first) is released the same way
+class StagingRing
+{
+public:
+	// main thread only, like every GL call
+	explicit StagingRing(GLuint size);
+	~StagingRing();
+
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	struct Span
+	{
+		GLuint offset = 0;
+		GLuint size = 0; // 0 for no span
+		GLubyte* data = nullptr;
+	};
+
+	// from any thread: room for size bytes for the caller to fill in, or none if the ring is full
+	std::optional<Span> Reserve(GLuint size);
+
+	// from any thread: nothing recorded after this reads the span anymore
+	void Release(const Span& span);
+
+	// main thread, once per frame: fences the copies recorded this frame, and takes back
+	// the space of released spans whose frame the GPU is done with
+	void EndFrame();
+
+	GLuint GetGPUHandle() const { return gpuHandle_; }
+	GLuint Capacity() const { return capacity_; }
+	GLuint UsedBytes() const;
+
+private:
+	struct Released
+	{
+		GLuint offset;
+		GLuint size;
+		uint64_t frame; // it was released in
+	};
+
+	// with mtx_ held, merges with the free ranges on either side
+	void reclaim(GLuint offset, GLuint size);
+
+	GLuint gpuHandle_ = 0;
+	GLubyte* mapped_ = nullptr;
+	const GLuint capacity_;
+
+	mutable std::mutex mtx_;
+	std::map<GLuint, GLuint> free_;  // offset -> size, never adjacent to each other
+	std::deque<Released> released_; // in the order they were released, oldest first
+	GLuint head_ = 0;               // the search for the next span starts here
+	GLuint used_ = 0;               // reserved, or released but not back yet
+	uint64_t frame_ = 0;
+
+	// main thread only
+	std::deque<std::pair<uint64_t, GLsync>> fences_; // of the frames the GPU may not be done with
+	uint64_t doneFrames_ = 0; // frames before this one are done on the GPU
+};
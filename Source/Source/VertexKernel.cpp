@@ -0,0 +1,224 @@
+#include "stdafx.h"
+#include "VertexKernel.h"
+#include "ChunkHelpers.h"
+#include <Vertices.h>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace VertexKernel
+{
+	namespace
+	{
+#ifdef _WIN32
+		void cpuid(int32_t out[4], int32_t x)
+		{
+			__cpuidex(out, x, 0);
+		}
+		uint64_t xgetbv(unsigned int x)
+		{
+			return _xgetbv(x);
+		}
+#else
+		void cpuid(int32_t out[4], int32_t x)
+		{
+			__cpuid_count(x, 0, out[0], out[1], out[2], out[3]);
+		}
+		uint64_t xgetbv(unsigned int index)
+		{
+			uint32_t eax, edx;
+			__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+			return ((uint64_t)edx << 32) | eax;
+		}
+#endif
+
+		// same checks as FastNoiseSIMD's GetFastestSIMD
+		Level fastestLevel()
+		{
+#if defined(__arm__) || defined(__aarch64__)
+			return Scalar;
+#else
+			int32_t cpuInfo[4];
+			cpuid(cpuInfo, 0);
+			int nIds = cpuInfo[0];
+			if (nIds < 0x00000001)
+				return Scalar;
+
+			cpuid(cpuInfo, 0x00000001);
+			if ((cpuInfo[2] & 1 << 19) == 0)
+				return Scalar;
+
+			// AVX has to be enabled by the OS too
+			bool cpuXSaveSupport = (cpuInfo[2] & 1 << 26) != 0;
+			bool osAVXSupport = (cpuInfo[2] & 1 << 27) != 0;
+			bool cpuAVXSupport = (cpuInfo[2] & 1 << 28) != 0;
+			if (!cpuXSaveSupport || !osAVXSupport || !cpuAVXSupport || (xgetbv(0) & 0x6) != 0x6)
+				return SSE41;
+
+			if (nIds < 0x00000007)
+				return SSE41;
+			cpuid(cpuInfo, 0x00000007);
+			if ((cpuInfo[1] & 1 << 5) == 0)
+				return SSE41;
+			return AVX2;
+#endif
+		}
+
+		// field of each axis in a packed position
+		constexpr uint32_t positionShift[3] = { 26, 20, 14 };
+
+		// position of a plane offset in an occlusion code (see OcclusionAO)
+		int occlusionBit(int normalAxis, const glm::ivec3& offset)
+		{
+			glm::ivec2 ab = normalAxis == 0 ? glm::ivec2(offset.y, offset.z) :
+				normalAxis == 1 ? glm::ivec2(offset.x, offset.z) : glm::ivec2(offset.x, offset.y);
+			return (ab.x + 1) + 3 * (ab.y + 1);
+		}
+
+		Tables makeTables()
+		{
+			using namespace ChunkHelpers;
+			Tables t{};
+			for (int face = 0; face < 6; face++)
+			{
+				int normalAxis = faces[face].x ? 0 : faces[face].y ? 1 : 2;
+				int uAxis = (normalAxis + 1) % 3;
+				int vAxis = (normalAxis + 2) % 3;
+				const GLfloat* data = Vertices::cube_light + face * 12;
+
+				glm::ivec3 cornerDirs[4];
+				for (int c = 0; c < 4; c++)
+				{
+					glm::vec3 vert(data[c * 3 + 0], data[c * 3 + 1], data[c * 3 + 2]);
+					glm::uvec3 corner = glm::ceil(vert);
+					cornerDirs[c] = glm::ivec3(vert * 2.0f);
+
+					for (int axis = 0; axis < 3; axis++)
+						if (corner[axis])
+							t.cornerMask[face][c] |= 0x3Fu << positionShift[axis];
+					t.encodeBase[face][c] = Encode(glm::uvec3(0), face, 0, c);
+					t.lightBase[face][c] = EncodeLight(0, -glm::ivec3(corner));
+				}
+
+				t.shiftU[face] = uint8_t(positionShift[uAxis]);
+				t.shiftV[face] = uint8_t(positionShift[vAxis]);
+				t.unitNormal[face] = 1u << positionShift[normalAxis];
+
+				// corners 0 and 3 only differ along the texture's horizontal axis
+				bool texAlongU = glm::ceil(data[0 + uAxis]) != glm::ceil(data[9 + uAxis]);
+				t.shiftW[face] = texAlongU ? 19 : 24;
+				t.shiftH[face] = texAlongU ? 24 : 19;
+
+				// same rules as the per-corner AO: two sides hide the corner block,
+				// otherwise each of the three takes away a level
+				for (unsigned code = 0; code < 512; code++)
+				{
+					uint8_t ao = 0;
+					for (int c = 0; c < 4; c++)
+					{
+						glm::ivec3 side1(0), side2(0);
+						side1[uAxis] = cornerDirs[c][uAxis];
+						side2[vAxis] = cornerDirs[c][vAxis];
+						bool s1 = code >> occlusionBit(normalAxis, side1) & 1;
+						bool s2 = code >> occlusionBit(normalAxis, side2) & 1;
+						bool diagonal = code >> occlusionBit(normalAxis, side1 + side2) & 1;
+						int cornerAO = s1 && s2 ? 0 : 3 - (s1 + s2 + diagonal);
+						ao |= cornerAO << (c * 2);
+					}
+					t.occlusionAO[face][code] = ao;
+				}
+			}
+
+			for (int ao = 0; ao < 256; ao++)
+			{
+				int cornerAO[4];
+				for (int c = 0; c < 4; c++)
+				{
+					cornerAO[c] = ao >> (c * 2) & 3;
+					t.darken[ao][c] = uint32_t(6 - 2 * cornerAO[c]) * 0x01010101u;
+				}
+				// partially solve anisotropy issue
+				t.flipped[ao] = cornerAO[0] + cornerAO[2] > cornerAO[1] + cornerAO[3];
+			}
+			return t;
+		}
+	}
+
+
+	const Tables& GetTables()
+	{
+		static const Tables tables = makeTables();
+		return tables;
+	}
+
+
+	Level GetLevel()
+	{
+		static const Level level = []
+		{
+			int fastest = fastestLevel();
+			while (!IsCompiled(Level(fastest)))
+				fastest--;
+			return Level(fastest);
+		}();
+		return level;
+	}
+
+
+	void Expand(const Quad* quads, size_t count, uint32_t* out)
+	{
+		Expand(GetLevel(), quads, count, out);
+	}
+
+
+	void Expand(Level level, const Quad* quads, size_t count, uint32_t* out)
+	{
+		const Tables& t = GetTables();
+#ifdef VK_COMPILE_AVX2
+		if (level >= AVX2)
+			return ExpandAVX2(t, quads, count, out);
+#endif
+#ifdef VK_COMPILE_SSE41
+		if (level >= SSE41)
+			return ExpandSSE41(t, quads, count, out);
+#endif
+		ExpandScalar(t, quads, count, out);
+	}
+
+
+	void ExpandScalar(const Tables& t, const Quad* quads, size_t count, uint32_t* out)
+	{
+		const uint32_t indicesA[6] = { 0, 1, 3, 3, 1, 2 }; // normal indices
+		const uint32_t indicesB[6] = { 0, 1, 2, 2, 3, 0 }; // anisotropy fix (flip tris)
+
+		for (size_t i = 0; i < count; i++, out += 12)
+		{
+			const Quad& q = quads[i];
+			uint32_t extent = Extent(t, q);
+			uint32_t quadSize = QuadSize(t, q);
+			uint32_t light = SpreadLight(q.light);
+
+			uint32_t encodeds[4];
+			uint32_t lightdeds[4];
+			for (int c = 0; c < 4; c++)
+			{
+				encodeds[c] = q.position + (extent & t.cornerMask[q.face][c]) + t.encodeBase[q.face][c] + (uint32_t(q.texIdx) << 2);
+
+				// per channel light - min(light, darken), the | 0x80 keeps borrows inside each byte
+				uint32_t d = (light | 0x80808080u) - t.darken[q.ao][c];
+				uint32_t kept = (d & 0x80808080u) >> 7;
+				lightdeds[c] = PackLight(d & kept * 0x7F) | t.lightBase[q.face][c] | quadSize;
+			}
+
+			const uint32_t* indices = t.flipped[q.ao] ? indicesB : indicesA;
+			for (int v = 0; v < 6; v++)
+			{
+				out[v * 2 + 0] = encodeds[indices[v]];
+				out[v * 2 + 1] = lightdeds[indices[v]];
+			}
+		}
+	}
+}
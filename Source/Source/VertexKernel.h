@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// expands quads into the 6 interleaved (encoded, lighting) vertices of ChunkHelpers::ExpandQuad
+// with integer math only, the 4 corners of a quad in the lanes of one register
+// the fastest version the CPU supports is picked at runtime, the same way FastNoiseSIMD does
+
+#if !(defined(__arm__) || defined(__aarch64__))
+// comment out lines to not compile for certain instruction sets
+#define VK_COMPILE_SSE41
+
+// to compile AVX2 set C++ code generation to use /arch:AVX2 on VertexKernel_avx2.cpp
+// this does not break support for pre AVX2 CPUs, AVX2 code is only run if support is detected
+#define VK_COMPILE_AVX2
+#endif
+
+// helpers defined here are static: VertexKernel_avx2.cpp is compiled with /arch:AVX2, and an inline
+// function it instantiates could otherwise be the copy the linker keeps for every other caller
+namespace VertexKernel
+{
+	enum Level
+	{
+		Scalar,
+		SSE41,
+		AVX2,
+
+		LevelCount
+	};
+
+	// a face, or a greedy-merged rectangle of faces
+	struct Quad
+	{
+		uint32_t position; // lowest block, packed like ChunkHelpers::Encode (x << 26 | y << 20 | z << 14)
+		uint16_t light;    // raw Light, with the sun already set
+		uint16_t texIdx;
+		uint8_t face;
+		uint8_t ao;        // 2 bits per corner (corner 0 lowest), from 0 (darkest) to 3 (unoccluded)
+		uint8_t w, h;      // size in blocks along the axes after the normal's (see ExpandQuad)
+	};
+
+	// per-face constants taken from Vertices::cube_light, used by every version
+	struct Tables
+	{
+		uint32_t cornerMask[6][4]; // position fields the quad's size stretches at each corner
+		uint32_t encodeBase[6][4]; // normal | corner index
+		uint32_t lightBase[6][4];  // dirCent of each corner
+		uint8_t shiftU[6], shiftV[6]; // position field of the face's u and v axes
+		uint32_t unitNormal[6];    // 1 in the position field of the normal's axis
+		uint8_t shiftW[6], shiftH[6]; // quad size field of w and h (textures can run along either)
+		uint32_t darken[256][4];   // light taken off each corner for an AO byte (6 - 2 * AO), in every byte
+		bool flipped[256];         // whether an AO byte uses the flipped triangle pattern
+		uint8_t occlusionAO[6][512];
+	};
+
+	const Tables& GetTables();
+
+	// whether a version was compiled in (see VK_COMPILE_*), the scalar one always is
+	static constexpr bool IsCompiled(Level level)
+	{
+		switch (level)
+		{
+#ifdef VK_COMPILE_SSE41
+		case SSE41: return true;
+#endif
+#ifdef VK_COMPILE_AVX2
+		case AVX2: return true;
+#endif
+		case Scalar: return true;
+		default: return false;
+		}
+	}
+
+	// fastest compiled in version supported by this CPU, detected once
+	Level GetLevel();
+
+	// writes 12 words (6 vertices) per quad, identical to ExpandQuad
+	void Expand(const Quad* quads, size_t count, uint32_t* out);
+	void Expand(Level level, const Quad* quads, size_t count, uint32_t* out); // for benchmarking
+
+	// AO byte (see Quad::ao) of a face from the 3x3 blocks in front of it
+	// bit (a + 1) + 3 * (b + 1) of occlusion is set if the block at plane offset (a, b) isn't air
+	// a is along x and b along the other axis of the plane, or for faces along x a is along y and b along z
+	static inline uint8_t OcclusionAO(int face, unsigned occlusion)
+	{
+		return GetTables().occlusionAO[face][occlusion];
+	}
+
+	// one per instruction set, in VertexKernel_*.cpp
+	void ExpandScalar(const Tables& t, const Quad* quads, size_t count, uint32_t* out);
+	void ExpandSSE41(const Tables& t, const Quad* quads, size_t count, uint32_t* out);
+	void ExpandAVX2(const Tables& t, const Quad* quads, size_t count, uint32_t* out);
+
+	// spreads the 4 light channels into the 4 bytes of a word, and back
+	static inline uint32_t SpreadLight(uint16_t light)
+	{
+		uint32_t l = light;
+		return (l & 0xF) | (l & 0xF0) << 4 | (l & 0xF00) << 8 | (l & 0xF000) << 12;
+	}
+	static inline uint32_t PackLight(uint32_t spread)
+	{
+		uint32_t t = spread | spread >> 4;
+		return (t & 0xFF) | (t >> 8 & 0xFF00);
+	}
+
+	// the quad's extent in position fields, and its size in the lighting word
+	static inline uint32_t Extent(const Tables& t, const Quad& q)
+	{
+		return t.unitNormal[q.face] | uint32_t(q.w) << t.shiftU[q.face] | uint32_t(q.h) << t.shiftV[q.face];
+	}
+	static inline uint32_t QuadSize(const Tables& t, const Quad& q)
+	{
+		return uint32_t(q.w - 1) << t.shiftW[q.face] | uint32_t(q.h - 1) << t.shiftH[q.face];
+	}
+}
@@ -0,0 +1,85 @@
+#include "VertexKernel.h"
+
+// to compile AVX2 support enable AVX2 code generation compiler flags for this file
+#ifdef VK_COMPILE_AVX2
+#ifndef __AVX2__
+#ifdef __GNUC__
+#error To compile AVX2 add build command "-mavx2" on VertexKernel_avx2.cpp, or remove "#define VK_COMPILE_AVX2" from VertexKernel.h
+#else
+#error To compile AVX2 set C++ code generation to use /arch:AVX2 on VertexKernel_avx2.cpp, or remove "#define VK_COMPILE_AVX2" from VertexKernel.h
+#endif
+#endif
+
+#include <immintrin.h> //AVX2
+
+namespace VertexKernel
+{
+	namespace
+	{
+		// the per-face row of a table for two quads, one in each 128-bit half
+		inline __m256i loadPair(const uint32_t (&a)[4], const uint32_t (&b)[4])
+		{
+			return _mm256_inserti128_si256(
+				_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)a)), _mm_loadu_si128((const __m128i*)b), 1);
+		}
+
+		inline __m256i setPair(uint32_t a, uint32_t b)
+		{
+			return _mm256_setr_epi32(a, a, a, a, b, b, b, b);
+		}
+	}
+
+
+	// same as ExpandSSE41, with two quads per register
+	// every shuffle stays inside its 128-bit half, so each half works on its own quad
+	void ExpandAVX2(const Tables& t, const Quad* quads, size_t count, uint32_t* out)
+	{
+		for (size_t i = 0; i < count; i += 2, out += 24)
+		{
+			const Quad& a = quads[i];
+			const Quad& b = quads[i + 1 < count ? i + 1 : i]; // an odd last quad is done twice
+
+			__m256i encoded = _mm256_add_epi32(
+				setPair(a.position + (uint32_t(a.texIdx) << 2), b.position + (uint32_t(b.texIdx) << 2)),
+				_mm256_and_si256(setPair(Extent(t, a), Extent(t, b)), loadPair(t.cornerMask[a.face], t.cornerMask[b.face])));
+			encoded = _mm256_add_epi32(encoded, loadPair(t.encodeBase[a.face], t.encodeBase[b.face]));
+
+			__m256i light = _mm256_subs_epu8(
+				setPair(SpreadLight(a.light), SpreadLight(b.light)),
+				loadPair(t.darken[a.ao], t.darken[b.ao]));
+			light = _mm256_or_si256(light, _mm256_srli_epi32(light, 4));
+			light = _mm256_or_si256(
+				_mm256_and_si256(light, _mm256_set1_epi32(0xFF)),
+				_mm256_and_si256(_mm256_srli_epi32(light, 8), _mm256_set1_epi32(0xFF00)));
+			light = _mm256_or_si256(light, loadPair(t.lightBase[a.face], t.lightBase[b.face]));
+			light = _mm256_or_si256(light, setPair(QuadSize(t, a), QuadSize(t, b)));
+
+			__m256i lo = _mm256_unpacklo_epi32(encoded, light);
+			__m256i hi = _mm256_unpackhi_epi32(encoded, light);
+
+			// pick the triangle pattern of each half
+			__m256i flipped = _mm256_setr_epi64x(
+				-int64_t(t.flipped[a.ao]), -int64_t(t.flipped[a.ao]), -int64_t(t.flipped[b.ao]), -int64_t(t.flipped[b.ao]));
+			__m256i v23 = _mm256_blendv_epi8(
+				_mm256_shuffle_epi32(hi, _MM_SHUFFLE(3, 2, 3, 2)),
+				_mm256_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 1, 0)), flipped);
+			__m256i v45 = _mm256_blendv_epi8(
+				_mm256_alignr_epi8(hi, lo, 8),
+				_mm256_alignr_epi8(lo, hi, 8), flipped);
+
+			if (i + 1 < count)
+			{
+				_mm256_storeu_si256((__m256i*)(out + 0), _mm256_permute2x128_si256(lo, v23, 0x20));
+				_mm256_storeu_si256((__m256i*)(out + 8), _mm256_permute2x128_si256(v45, lo, 0x30));
+				_mm256_storeu_si256((__m256i*)(out + 16), _mm256_permute2x128_si256(v23, v45, 0x31));
+			}
+			else
+			{
+				_mm_storeu_si128((__m128i*)(out + 0), _mm256_castsi256_si128(lo));
+				_mm_storeu_si128((__m128i*)(out + 4), _mm256_castsi256_si128(v23));
+				_mm_storeu_si128((__m128i*)(out + 8), _mm256_castsi256_si128(v45));
+			}
+		}
+	}
+}
+#endif
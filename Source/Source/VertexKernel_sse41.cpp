@@ -0,0 +1,52 @@
+#include "VertexKernel.h"
+
+// depending on the compiler this file may need to have SSE4.1 code generation compiler flags enabled
+#ifdef VK_COMPILE_SSE41
+#include <smmintrin.h> //SSE4.1
+
+namespace VertexKernel
+{
+	void ExpandSSE41(const Tables& t, const Quad* quads, size_t count, uint32_t* out)
+	{
+		for (size_t i = 0; i < count; i++, out += 12)
+		{
+			const Quad& q = quads[i];
+
+			// one corner per lane
+			__m128i mask = _mm_loadu_si128((const __m128i*)t.cornerMask[q.face]);
+			__m128i encoded = _mm_add_epi32(
+				_mm_set1_epi32(int(q.position + (uint32_t(q.texIdx) << 2))),
+				_mm_and_si128(_mm_set1_epi32(int(Extent(t, q))), mask));
+			encoded = _mm_add_epi32(encoded, _mm_loadu_si128((const __m128i*)t.encodeBase[q.face]));
+
+			// darken every channel at once with a saturating byte subtract, then pack the nibbles back
+			__m128i light = _mm_subs_epu8(
+				_mm_set1_epi32(int(SpreadLight(q.light))),
+				_mm_loadu_si128((const __m128i*)t.darken[q.ao]));
+			light = _mm_or_si128(light, _mm_srli_epi32(light, 4));
+			light = _mm_or_si128(
+				_mm_and_si128(light, _mm_set1_epi32(0xFF)),
+				_mm_and_si128(_mm_srli_epi32(light, 8), _mm_set1_epi32(0xFF00)));
+			light = _mm_or_si128(light, _mm_loadu_si128((const __m128i*)t.lightBase[q.face]));
+			light = _mm_or_si128(light, _mm_set1_epi32(int(QuadSize(t, q))));
+
+			// (encoded, light) pairs of corners 0, 1 and 2, 3
+			__m128i lo = _mm_unpacklo_epi32(encoded, light);
+			__m128i hi = _mm_unpackhi_epi32(encoded, light);
+
+			// corners 0, 1, 3, 3, 1, 2, or 0, 1, 2, 2, 3, 0 when flipped
+			// both are made and blended, the pattern is too random to branch on
+			__m128i flipped = _mm_set1_epi32(-int(t.flipped[q.ao]));
+			__m128i v23 = _mm_blendv_epi8(
+				_mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 2, 3, 2)),
+				_mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 1, 0)), flipped);
+			__m128i v45 = _mm_blendv_epi8(
+				_mm_alignr_epi8(hi, lo, 8),
+				_mm_alignr_epi8(lo, hi, 8), flipped);
+			_mm_storeu_si128((__m128i*)(out + 0), lo);
+			_mm_storeu_si128((__m128i*)(out + 4), v23);
+			_mm_storeu_si128((__m128i*)(out + 8), v45);
+		}
+	}
+}
+#endif
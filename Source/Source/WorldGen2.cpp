@@ -21,6 +21,13 @@ namespace WorldGen2
 #endif
 	}
 
+	void SetBounds(glm::ivec3 low, glm::ivec3 high)
+	{
+		lowChunkDim = low;
+		highChunkDim = high;
+	}
+
+
 	// init chunks that we finna modify
 	void Init()
 	{
@@ -32,9 +39,8 @@ namespace WorldGen2
 				printf(" Y: %d", y);
 				for (int z = lowChunkDim.z; z < highChunkDim.z; z++)
 				{
-					Chunk* newChunk = new Chunk();
-					newChunk->SetPos({ x, y, z });
-					ChunkStorage::GetMapRaw()[{ x, y, z }] = newChunk;
+					// chunks start as air and are only allocated if generation puts something in them
+					ChunkStorage::MarkAir({ x, y, z });
 				}
 			}
 		}
@@ -63,63 +69,51 @@ namespace WorldGen2
 		//noisey->SetPerturbAmp(0.4);
 		//noisey->SetPerturbFrequency(0.4);
 		
-		auto& chunks = ChunkStorage::GetMapRaw();
-		std::for_each(std::execution::par, chunks.begin(), chunks.end(),
-			[&](auto pair)
+		std::vector<glm::ivec3> positions;
+		for (int x = lowChunkDim.x; x < highChunkDim.x; x++)
+			for (int y = lowChunkDim.y; y < highChunkDim.y; y++)
+				for (int z = lowChunkDim.z; z < highChunkDim.z; z++)
+					positions.push_back({ x, y, z });
+
+		std::for_each(std::execution::par, positions.begin(), positions.end(),
+			[&](const glm::ivec3& cpos)
 		{
-			if (pair.second)
+			glm::ivec3 st = cpos * Chunk::CHUNK_SIZE;
+			float* noiseSet = noisey->GetCubicFractalSet(st.z, st.y, st.x, 
+				Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE, 1);
+			int idx = 0;
+
+			printf(".");
+
+			// generate into a flat array and import it in one go, rather than
+			// going through the palette (and the chunk map) for every block
+			auto types = std::make_unique<Chunk::TypeArray>();
+			types->fill(BlockType::bAir);
+			bool empty = true;
+			for (int z = 0; z < Chunk::CHUNK_SIZE; z++)
 			{
-				glm::ivec3 st = pair.first * Chunk::CHUNK_SIZE;
-				float* noiseSet = noisey->GetCubicFractalSet(st.z, st.y, st.x, 
-					Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE, 1);
-				int idx = 0;
-
-				printf(".");
-				glm::ivec3 pos, wpos;
-				for (pos.z = 0; pos.z < Chunk::CHUNK_SIZE; pos.z++)
+				for (int y = 0; y < Chunk::CHUNK_SIZE; y++)
 				{
-					//int zcsq = pos.z * Chunk::CHUNK_SIZE_SQRED;
-					for (pos.y = 0; pos.y < Chunk::CHUNK_SIZE; pos.y++)
+					for (int x = 0; x < Chunk::CHUNK_SIZE; x++)
 					{
-						//int yczcsq = pos.y * Chunk::CHUNK_SIZE + zcsq;
-						for (pos.x = 0; pos.x < Chunk::CHUNK_SIZE; pos.x++)
-						{
-							//int index = pos.x + yczcsq;
-							wpos = ChunkHelpers::chunkPosToWorldPos(pos, pair.first);
-
-							//double density = noise.GetValue(wpos.x, wpos.y, wpos.z); // chunks are different
-							//double density = noise.GetValue(pos.x, pos.y, pos.z); // same chunk every time
-							//density = 0;
-
-							//if (pos.z < 8 && pos.x < 8 && pos.y < 8)
-							//	ChunkStorage::SetBlockType(wpos, BlockType::bStone);
-							//continue;
-
-							float density = noiseSet[idx++];
-							if (density < -.02)
-							{
-								ChunkStorage::SetBlockType(wpos, BlockType::bGrass);
-							}
-							if (density < -.03)
-							{
-								ChunkStorage::SetBlockType(wpos, BlockType::bDirt);
-							}
-							if (density < -.04)
-							{
-								ChunkStorage::SetBlockType(wpos, BlockType::bStone);
-							}
-
-							//printf("%f\n", density);
-						}
+						float density = noiseSet[idx++];
+						BlockType& type = (*types)[ID3D(x, y, z, Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE)];
+						if (density < -.04)
+							type = BlockType::bStone;
+						else if (density < -.03)
+							type = BlockType::bDirt;
+						else if (density < -.02)
+							type = BlockType::bGrass;
+						empty = empty && type == BlockType::bAir;
 					}
 				}
-
-				FastNoiseSIMD::FreeNoiseSet(noiseSet);
-			}
-			else
-			{
-				printf("null chunk doe\n");
 			}
+
+			// all-air chunks stay unallocated
+			if (!empty)
+				ChunkStorage::Materialize(cpos)->ImportTypes(*types);
+
+			FastNoiseSIMD::FreeNoiseSet(noiseSet);
 		});
 
 		delete noisey;
@@ -128,22 +122,24 @@ namespace WorldGen2
 
 	void InitMeshes()
 	{
-		auto& chunks = ChunkStorage::GetMapRaw();
+		std::vector<ChunkPtr> chunks;
+		ChunkStorage::GetMapRaw().ForEach([&](const glm::ivec3&, ChunkPtr chunk)
+		{
+			chunks.push_back(chunk);
+		});
 		std::for_each(std::execution::par,
-			chunks.begin(), chunks.end(), [](auto& p)
+			chunks.begin(), chunks.end(), [](ChunkPtr chunk)
 		{
-			p.second->BuildMesh();
+			chunk->BuildMesh();
 		});
 	}
 
 
 	void InitBuffers()
 	{
-		auto& chunks = ChunkStorage::GetMapRaw();
-		std::for_each(std::execution::seq,
-			chunks.begin(), chunks.end(), [](auto& p)
+		ChunkStorage::GetMapRaw().ForEach([](const glm::ivec3&, ChunkPtr chunk)
 		{
-			p.second->BuildBuffers();
+			chunk->BuildBuffers();
 		});
 	}
 }
\ No newline at end of file
@@ -5,6 +5,9 @@ struct Chunk;
 // https://github.com/tModLoader/tModLoader/wiki/Vanilla-World-Generation-Steps
 namespace WorldGen2
 {
+	// the chunks Init and GenerateWorld cover, [low, high)
+	void SetBounds(glm::ivec3 low, glm::ivec3 high);
+
 	void Init();
 	void GenerateWorld();
 	void InitMeshes();
@@ -26,3 +26,12 @@ const std::vector<BlockProperties> Block::PropertiesTable =
 	{BlockProperties("GGlass",     {0, 0, 0, 0}, Visibility::Partial)},
 	{BlockProperties("BGlass",     {0, 0, 0, 0}, Visibility::Partial)},
 };
+
+static const bool visibilityChecked = []
+{
+	ASSERT(Block::PropertiesTable.size() == size_t(BlockType::bCount));
+	for (size_t i = 0; i < Block::PropertiesTable.size(); i++)
+		ASSERT_MSG(VisibilityOf(BlockType(i)) == Block::PropertiesTable[i].visibility,
+			"VisibilityOf disagrees with PropertiesTable");
+	return true;
+}();
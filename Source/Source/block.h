@@ -54,6 +54,25 @@ enum class BlockType : uint16_t // upgrade when over 2^16 block types
 };
 
 
+// the visibility of each type, known at compile time so tables can be built from it
+// (must agree with PropertiesTable, which is checked at startup)
+constexpr Visibility VisibilityOf(BlockType t)
+{
+	switch (t)
+	{
+	case BlockType::bAir:
+		return Visibility::Invisible;
+	case BlockType::bOakLeaves:
+	case BlockType::bRglass:
+	case BlockType::bGglass:
+	case BlockType::bBglass:
+		return Visibility::Partial;
+	default:
+		return Visibility::Opaque;
+	}
+}
+
+
 typedef struct Block
 {
 public:
@@ -13,6 +13,7 @@
 #include "shader.h"
 #include <Vertices.h>
 #include <sstream>
+#include <thread>
 #include "settings.h"
 #include "misc_utils.h"
 #include "ChunkStorage.h"
@@ -22,11 +23,13 @@
 Chunk::Chunk()
 {
 	mesh.SetParent(this);
+	UpdateMemoryStats();
 }
 
 
 Chunk::~Chunk()
 {
+	MemoryStats::Retract(memoryRecord_);
 }
 
 
@@ -46,6 +49,72 @@ Chunk& Chunk::operator=(const Chunk& rhs)
 }
 
 
+std::shared_ptr<const ChunkSnapshot> Chunk::Snapshot() const
+{
+	std::lock_guard lk(snapshotMtx_);
+
+	// nothing was written since the last snapshot, and it's still in use
+	auto cached = snapshot_.lock();
+	if (cached && writers_ == 0 && cached->version == version_)
+		return cached;
+
+	while (true)
+	{
+		// copying while a write is in progress could capture half of it
+		if (writers_ != 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		auto snapshot = std::make_shared<ChunkSnapshot>();
+		snapshot->version = version_;
+		snapshot->pos = pos_;
+		snapshot->storage = storage.Snapshot();
+
+		// no write started or finished while copying
+		if (writers_ == 0 && version_ == snapshot->version)
+		{
+			snapshot->bytes = sizeof(ChunkSnapshot) +
+				snapshot->storage.types.MemoryUsage() + snapshot->storage.light.MemoryUsage();
+			MemoryStats::Add(MemoryStats::Snapshots, snapshot->bytes);
+			snapshot_ = snapshot;
+			return snapshot;
+		}
+	}
+}
+
+
+void Chunk::Restore(const ChunkSnapshot& snapshot)
+{
+	auto types = std::make_unique<TypeArray>();
+	auto light = std::make_unique<LightArray>();
+	snapshot.ExportTypes(*types);
+	snapshot.ExportLight(*light);
+	SetPos(snapshot.pos);
+	ImportTypes(*types);
+	ImportLight(*light);
+}
+
+
+void Chunk::UpdateMemoryStats()
+{
+	using namespace MemoryStats;
+	size_t bytes[CategoryCount] = {};
+
+	PaletteMemory types = storage.TypeMemory();
+	PaletteMemory light = storage.LightMemory();
+	bytes[TypePalette] = types.entries;
+	bytes[TypeBitstream] = types.bitstream;
+	bytes[LightPalette] = light.entries;
+	bytes[LightBitstream] = light.bitstream;
+	mesh.GetStagingMemory(bytes);
+	bytes[ChunkObject] = sizeof(Chunk);
+
+	Report(memoryRecord_, bytes, types.entryLength);
+}
+
+
 void Chunk::Update()
 {
 	// in the future, make this function perform other tick update actions,
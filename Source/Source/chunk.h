@@ -6,13 +6,14 @@
 #include "biome.h"
 #include "misc_utils.h"
 #include <mutex>
-#include <concurrent_unordered_map.h> // TODO: temp solution to concurrent chunk access
 #include <atomic>
+#include <thread>
 #include <Shapes.h>
 
 #include "ChunkHelpers.h"
 #include "BlockStorage.h"
 #include "ChunkMesh.h"
+#include "MemoryStats.h"
 
 #include <cereal/archives/binary.hpp>
 
@@ -25,6 +26,7 @@
 class VAO;
 class VBO;
 class IBO;
+struct ChunkSnapshot;
 
 //typedef std::pair<glm::ivec3, glm::ivec3> localpos;
 
@@ -39,6 +41,19 @@ class IBO;
 	7: -x+y-z
 */
 
+// where a chunk is in the pipeline, each state comes after the ones above it
+// a chunk is only meshed once it's lit and none of its face neighbors is still waiting for its blocks
+// (see ChunkManager::readyToMesh), remeshing goes back from Uploaded to Meshed
+enum class ChunkState : uint8_t
+{
+	Allocated, // storage exists, blocks not generated yet
+	Generated, // blocks are final (until edited)
+	Lit,       // light of its own emitters spread
+	Meshed,    // a mesh is waiting to be uploaded
+	Uploaded,  // the GPU has its latest mesh
+};
+
+
 // TODO: clean this up a lot
 typedef struct Chunk
 {
@@ -79,6 +94,9 @@ public:
 
 	inline const glm::ivec3& GetPos() { return pos_; }
 
+	ChunkState GetState() const { return state_.load(); }
+	void SetState(ChunkState state) { state_ = state; }
+
 	inline bool IsVisible(Camera& cam) const
 	{
 		return cam.GetFrustum()->IsInside(bounds) >= Frustum::Visibility::Partial;
@@ -104,16 +122,23 @@ public:
 		return storage.GetBlockType(index);
 	}
 
+	// the memory stats are only updated when a palette grows or shrinks, the rest of the time they're unchanged
 	inline void SetBlockTypeAt(const glm::ivec3& lpos, BlockType type)
 	{
-		storage.SetBlock(
-			ID3D(lpos.x, lpos.y, lpos.z, CHUNK_SIZE, CHUNK_SIZE), type);
+		bool resized = false;
+		write([&] { resized = storage.SetBlock(
+			ID3D(lpos.x, lpos.y, lpos.z, CHUNK_SIZE, CHUNK_SIZE), type); });
+		if (resized)
+			UpdateMemoryStats();
 	}
 
 	inline void SetLightAt(const glm::ivec3& lpos, Light light)
 	{
-		storage.SetLight(
-			ID3D(lpos.x, lpos.y, lpos.z, CHUNK_SIZE, CHUNK_SIZE), light);
+		bool resized = false;
+		write([&] { resized = storage.SetLight(
+			ID3D(lpos.x, lpos.y, lpos.z, CHUNK_SIZE, CHUNK_SIZE), light); });
+		if (resized)
+			UpdateMemoryStats();
 	}
 
 	inline Light LightAt(const glm::ivec3& p)
@@ -126,23 +151,108 @@ public:
 		return storage.GetLight(index);
 	}
 
+	// flat copies of the whole chunk, indexed with ID3D
+	using TypeArray = std::array<BlockType, CHUNK_SIZE_CUBED>;
+	using LightArray = std::array<Light, CHUNK_SIZE_CUBED>;
+
+	inline void ExportTypes(TypeArray& out) const
+	{
+		storage.ExportTypes(out);
+	}
+
+	inline void ExportLight(LightArray& out) const
+	{
+		storage.ExportLight(out);
+	}
+
+	inline void ImportTypes(const TypeArray& in)
+	{
+		write([&] { storage.ImportTypes(in); });
+		UpdateMemoryStats();
+	}
+
+	inline void ImportLight(const LightArray& in)
+	{
+		write([&] { storage.ImportLight(in); });
+		UpdateMemoryStats();
+	}
+
+	inline std::optional<BlockType> UniformType() const
+	{
+		return storage.UniformType();
+	}
+
+	// every write bumps the version, so a snapshot is current iff its version matches
+	uint64_t Version() const { return version_.load(); }
+
+	// runs fn (which reads this chunk) again until no write overlapped it
+	// false if every attempt was overlapped
+	template<typename Fn>
+	bool ReadConsistent(Fn&& fn, int attempts = 8) const
+	{
+		for (int i = 0; i < attempts; i++)
+		{
+			uint64_t version = version_;
+			if (writers_ != 0)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			fn();
+			if (writers_ == 0 && version_ == version)
+				return true;
+		}
+		return false;
+	}
+
+	// immutable copy of the blocks and light at the current version
+	// cached, so repeated calls between writes share the same copy
+	std::shared_ptr<const ChunkSnapshot> Snapshot() const;
+
+	// replaces the contents of this chunk with those of a snapshot
+	void Restore(const ChunkSnapshot& snapshot);
+
 	AABB GetAABB() const
 	{
 		return bounds;
 	}
 
+	// adjacent chunks, indexed like ChunkHelpers::neighbors (null where there is no chunk)
+	// maintained by ChunkStorage as chunks are inserted and removed
+	inline Chunk* Neighbor(int index) const
+	{
+		return neighbors_[index].load(std::memory_order_acquire);
+	}
+
+	// dir components are in [-1, 1], no offset gives this chunk
+	inline Chunk* Neighbor(const glm::ivec3& dir)
+	{
+		int index = ChunkHelpers::neighborIndex(dir);
+		return index == -1 ? this : Neighbor(index);
+	}
+
 
-	void BuildMesh()
+	// false if a neighbor kept changing while it was read, the dirty sections are left to build again
+	bool BuildMesh()
 	{
-		mesh.BuildMesh();
+		if (!mesh.BuildMesh())
+			return false;
+		state_ = ChunkState::Meshed;
+		UpdateMemoryStats();
+		return true;
 	}
 
 	void BuildBuffers()
 	{
 		//mesh.BuildBuffers();
 		mesh.BuildBuffers2();
+		state_ = ChunkState::Uploaded;
+		UpdateMemoryStats();
 	}
 
+	// recomputes this chunk's footprint and reports the change to MemoryStats
+	void UpdateMemoryStats();
+
 	void Render()
 	{
 		mesh.Render();
@@ -167,12 +277,122 @@ public:
 	}
 
 private:
+	// writers may run concurrently with each other (the palettes serialize them),
+	// but a snapshot is only taken while none are in progress
+	template<typename Fn>
+	void write(Fn&& fn)
+	{
+		writers_++;
+		fn();
+		version_++;
+		writers_--;
+	}
+
 	glm::mat4 model_;
 	glm::ivec3 pos_;	// position relative to other chunks (1 chunk = 1 index)
 	bool visible_;		// used in frustum culling
 	AABB bounds{};
+	std::atomic<ChunkState> state_ = ChunkState::Allocated;
 
 	//ArrayBlockStorage<CHUNK_SIZE_CUBED> storage;
 	PaletteBlockStorage<CHUNK_SIZE_CUBED> storage;
 	ChunkMesh mesh;
+
+	std::atomic<uint64_t> version_ = 0;
+	std::atomic<int> writers_ = 0;
+	mutable std::mutex snapshotMtx_;
+	mutable std::weak_ptr<const ChunkSnapshot> snapshot_; // only kept while someone holds it
+
+	MemoryStats::ChunkRecord memoryRecord_;
+
+	friend class ChunkStorage;
+	std::atomic<Chunk*> neighbors_[26] = {};
 }Chunk, *ChunkPtr;
+
+
+// a chunk's blocks and light as they were at one version
+// never modified after creation, so any thread can read it without locking
+struct ChunkSnapshot
+{
+	uint64_t version = 0;
+	glm::ivec3 pos{ 0 };
+	BlockStorageSnapshot<Chunk::CHUNK_SIZE_CUBED> storage;
+	size_t bytes = 0; // reported to MemoryStats while the snapshot lives
+
+	ChunkSnapshot() = default;
+	ChunkSnapshot(const ChunkSnapshot&) = delete;
+	ChunkSnapshot& operator=(const ChunkSnapshot&) = delete;
+	~ChunkSnapshot()
+	{
+		MemoryStats::Remove(MemoryStats::Snapshots, bytes);
+	}
+
+	inline BlockType BlockTypeAt(int index) const
+	{
+		return storage.types.GetVal(index);
+	}
+
+	inline BlockType BlockTypeAt(const glm::ivec3& p) const
+	{
+		return BlockTypeAt(ID3D(p.x, p.y, p.z, Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE));
+	}
+
+	inline Light LightAt(const glm::ivec3& p) const
+	{
+		return storage.light.GetVal(ID3D(p.x, p.y, p.z, Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE));
+	}
+
+	inline Block BlockAt(const glm::ivec3& p) const
+	{
+		return Block(BlockTypeAt(p), LightAt(p));
+	}
+
+	inline std::optional<BlockType> UniformType() const
+	{
+		return storage.types.Uniform();
+	}
+
+	inline void ExportTypes(Chunk::TypeArray& out) const
+	{
+		storage.types.Export(out.data());
+	}
+
+	inline void ExportLight(Chunk::LightArray& out) const
+	{
+		storage.light.Export(out.data());
+	}
+
+	// into the inside of a padded array, with rows and slices the given number of elements apart
+	inline void ExportTypes(BlockType* out, size_t rowStride, size_t sliceStride) const
+	{
+		storage.types.Export(out, Chunk::CHUNK_SIZE, rowStride, sliceStride);
+	}
+
+	inline void ExportLight(Light* out, size_t rowStride, size_t sliceStride) const
+	{
+		storage.light.Export(out, Chunk::CHUNK_SIZE, rowStride, sliceStride);
+	}
+
+	// Serialization
+	template <class Archive>
+	void save(Archive& ar) const
+	{
+		auto types = std::make_unique<Chunk::TypeArray>();
+		auto light = std::make_unique<Chunk::LightArray>();
+		ExportTypes(*types);
+		ExportLight(*light);
+		ar(pos, cereal::binary_data(types->data(), sizeof(*types)),
+			cereal::binary_data(light->data(), sizeof(*light)));
+	}
+
+	template <class Archive>
+	void load(Archive& ar)
+	{
+		auto types = std::make_unique<Chunk::TypeArray>();
+		auto light = std::make_unique<Chunk::LightArray>();
+		ar(pos, cereal::binary_data(types->data(), sizeof(*types)),
+			cereal::binary_data(light->data(), sizeof(*light)));
+		storage.types.Import(types->data());
+		storage.light.Import(light->data());
+	}
+};
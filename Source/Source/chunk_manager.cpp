@@ -11,6 +11,11 @@
 #include "utilities.h"
 #include "ChunkHelpers.h"
 #include "ChunkStorage.h"
+#include "FaceMask.h"
+#include "settings.h"
+#include "LodGrid.h"
+#include "Epoch.h"
+#include "ChunkRenderer.h"
 
 
 ChunkManager::ChunkManager()
@@ -23,17 +28,7 @@ ChunkManager::ChunkManager()
 
 ChunkManager::~ChunkManager()
 {
-	shutdownThreads = true;
-	for (auto t_ptr : chunk_generator_threads_)
-	{
-		t_ptr->join();
-		delete t_ptr;
-	}
-	for (auto t_ptr : chunk_mesher_threads_)
-	{
-		t_ptr->join();
-		delete t_ptr;
-	}
+	jobs_.reset(); // before the queues its jobs use
 }
 
 
@@ -42,21 +37,14 @@ void ChunkManager::Init()
 	// run main thread on core 1
 	//SetThreadAffinityMask(GetCurrentThread(), 1);
 
-	// spawn chunk block generator threads
-	//for (int i = 0; i < 4; i++)
-	//{
-	//	chunk_generator_threads_.push_back(
-	//		new std::thread([this]() { chunk_generator_thread_task(); }));
-	//	//SetThreadAffinityMask(chunk_generator_threads_[i]->native_handle(), ~1);
-	//}
+	// workers for generating, lighting and meshing chunks
+	jobs_ = std::make_unique<JobSystem>(workerCount_);
 
-	// spawn chunk mesh generator threads
-	for (int i = 0; i < 1; i++)
-	{
-		chunk_mesher_threads_.push_back(
-			new std::thread([this]() { chunk_mesher_thread_task(); }));
-		//SetThreadAffinityMask(chunk_mesher_threads_[i]->native_handle(), ~1);
-	}
+	// anything queued before there were workers
+	for (size_t i = generation_queue_.Size(); i > 0; i--)
+		jobs_->Submit([this] { generateJob(); });
+	for (size_t i = mesher_queue_.Size(); i > 0; i--)
+		jobs_->Submit([this] { meshJob(); });
 }
 
 
@@ -76,22 +64,85 @@ void ChunkManager::Update()
 	//});
 
 	//chunk_gen_mesh_nobuffer();
+	updateSchedulers();
 	chunk_buffer_task();
 	//removeFarChunks();
 	//createNearbyChunks();
 
-	for (ChunkPtr chunk : delayed_update_queue_)
-		UpdateChunk(chunk);
-	delayed_update_queue_.clear();
+	updateLods();
+	{
+		std::lock_guard lk(light_mutex_);
+		flushDelayedUpdates();
+	}
+	Epoch::Collect(); // retired storage that readers were still using when it was retired
   PERF_BENCHMARK_END;
 }
 
 
-void ChunkManager::UpdateChunk(ChunkPtr chunk)
+void ChunkManager::UpdateChunk(ChunkPtr chunk, uint8_t sections, JobSystem::Priority priority)
 {
 	ASSERT(chunk != nullptr);
+	chunk->GetMesh().MarkDirty(sections);
 	std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
-	mesher_queue_.insert(chunk);
+
+	// meshing it now would only mean meshing it again, as its neighbors are generated
+	// or once the mesh in progress is done
+	if (!readyToMesh(chunk))
+	{
+		auto [it, inserted] = waiting_.try_emplace(chunk, priority);
+		it->second = std::min(it->second, priority);
+		return;
+	}
+	queueMesh(chunk, priority);
+}
+
+
+void ChunkManager::queueMesh(ChunkPtr chunk, JobSystem::Priority priority)
+{
+	// a chunk that's already queued only moves up, the job queued with it takes whatever is most urgent
+	if (mesher_queue_.Push(chunk, priority) && jobs_)
+		jobs_->Submit([this] { meshJob(); }, priority);
+}
+
+
+void ChunkManager::advanceChunk(ChunkPtr chunk, ChunkState state)
+{
+	std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
+	if (chunk->GetState() < state)
+		chunk->SetState(state);
+
+	// only the chunk and its face neighbors can have become ready
+	queueIfReady(chunk);
+	for (int i = 0; i < 6; i++)
+		if (ChunkPtr neighbor = chunk->Neighbor(i))
+			queueIfReady(neighbor);
+}
+
+
+void ChunkManager::queueIfReady(ChunkPtr chunk)
+{
+	auto it = waiting_.find(chunk);
+	if (it == waiting_.end() || !readyToMesh(chunk))
+		return;
+	JobSystem::Priority priority = it->second;
+	waiting_.erase(it);
+	queueMesh(chunk, priority);
+}
+
+
+bool ChunkManager::readyToMesh(ChunkPtr chunk) const
+{
+	if (chunk->GetState() < ChunkState::Lit || meshing_.count(chunk))
+		return false;
+
+	// missing neighbors are air or outside the world, both are as generated as they'll get
+	for (int i = 0; i < 6; i++)
+	{
+		ChunkPtr neighbor = chunk->Neighbor(i);
+		if (neighbor && neighbor->GetState() < ChunkState::Generated)
+			return false;
+	}
+	return true;
 }
 
 
@@ -101,10 +152,7 @@ void ChunkManager::UpdateChunk(const glm::ivec3 wpos)
 	//auto cptr = Chunk::chunks[cpos.chunk_pos];
 	auto cptr = ChunkStorage::GetChunk(cpos.chunk_pos);
 	if (cptr)
-	{
-		std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
-		mesher_queue_.insert(cptr);
-	}
+		UpdateChunk(cptr);
 }
 
 
@@ -112,6 +160,7 @@ void ChunkManager::UpdateBlock(const glm::ivec3& wpos, Block bl)
 {
 	ChunkHelpers::localpos p = ChunkHelpers::worldPosToLocalPos(wpos);
 	//BlockPtr block = Chunk::AtWorld(wpos);
+	std::lock_guard lk(light_mutex_); // the light changes below, and lighting jobs can be running
 	Block remBlock = ChunkStorage::AtWorldD(p); // store state of removed block to update lighting
 	ChunkPtr chunk = ChunkStorage::GetChunk(p.chunk_pos);
 
@@ -122,18 +171,21 @@ void ChunkManager::UpdateBlock(const glm::ivec3& wpos, Block bl)
 	//		return;
 	//}
 
+	// all-air chunks are already generated, they just have no storage yet
+	if (!chunk && ChunkStorage::IsAir(p.chunk_pos))
+		chunk = ChunkStorage::Materialize(p.chunk_pos);
+
 	// create empty chunk if it's null
 	if (!chunk)
 	{
 		// make chunk, then modify changed block
-		ChunkStorage::GetMapRaw()[p.chunk_pos] = chunk = new Chunk();
-		chunk->SetPos(p.chunk_pos);
-		std::lock_guard<std::mutex> lock1(chunk_generation_mutex_);
-		generation_queue_.insert(chunk);
+		chunk = ChunkStorage::Materialize(p.chunk_pos);
+		queueGeneration(chunk);
 		remBlock = chunk->BlockAt(p.block_pos); // remBlock would've been 0 block cuz null, so it's fix here
 	}
 
 	chunk->SetBlockTypeAt(p.block_pos, bl.GetType());
+	Block addBlock = chunk->BlockAt(p.block_pos);
 
 	// check if removed block emitted light
 	lightPropagateRemove(wpos);
@@ -143,13 +195,10 @@ void ChunkManager::UpdateBlock(const glm::ivec3& wpos, Block bl)
 	if (emit2 != glm::uvec3(0))
 		lightPropagateAdd(wpos, Light(Block::PropertiesTable[int(bl.GetType())].emittance));
 
-	// add to update list if it ain't
-	{ // scoped, otherwise deadlock will occur in 'checkUpdateChunkNearBlock'
-		std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
-		mesher_queue_.insert(chunk);
-	}
+	// only the sections that can see the block: its own faces, and those of the blocks around it
+	delayed_update_queue_[chunk] |= ChunkMesh::SectionsNear(p.block_pos.y);
 
-	// check if adjacent to opaque blocks in nearby chunks, then update those chunks if it is
+	// update chunks across a border only if the faces facing the block (or their AO) changed
 	constexpr glm::ivec3 dirs[] =
 	{
 		{-1, 0, 0 },
@@ -158,14 +207,30 @@ void ChunkManager::UpdateBlock(const glm::ivec3& wpos, Block bl)
 		{ 0, 1, 0 },
 		{ 0, 0,-1 },
 		{ 0, 0, 1 }
-		// TODO: add 20 more cases for diagonals (AO)
 	};
 	for (const auto& dir : dirs)
 	{
-		checkUpdateChunkNearBlock(wpos, dir);
+		checkUpdateChunkNearBlock(wpos, dir, remBlock, addBlock);
+	}
+
+	// AO looks at the blocks along the edges and corners of a chunk too,
+	// so every chunk with the block in its shell can change when it stops or starts being air
+	bool occupancyChanged = Settings::Graphics.blockAO &&
+		(remBlock.GetType() == BlockType::bAir) != (addBlock.GetType() == BlockType::bAir);
+	for (int i = 0; occupancyChanged && i < 26; i++)
+	{
+		glm::ivec3 dir = ChunkHelpers::neighbors[i];
+		// only the chunks the block borders
+		glm::ivec3 npos = p.block_pos + dir;
+		glm::ivec3 cdir = glm::ivec3(glm::greaterThanEqual(npos, glm::ivec3(Chunk::CHUNK_SIZE))) -
+			glm::ivec3(glm::lessThan(npos, glm::ivec3(0)));
+		if (cdir != dir)
+			continue;
+		if (ChunkPtr cptr = ChunkStorage::GetChunk(p.chunk_pos + dir))
+			delayed_update_queue_[cptr] |= ChunkMesh::SectionsNear(p.block_pos.y - dir.y * Chunk::CHUNK_SIZE);
 	}
 
-	delayed_update_queue_.erase(chunk);
+	flushDelayedUpdates();
 }
 
 
@@ -181,17 +246,13 @@ void ChunkManager::UpdateBlockCheap(const glm::ivec3& wpos, Block block)
 
 void ChunkManager::ReloadAllChunks()
 {
-	for (const auto& p : ChunkStorage::GetMapRaw())
+	ChunkStorage::GetMapRaw().ForEach([&](const glm::ivec3&, ChunkPtr chunk)
 	{
-		if (p.second)
-		{
-			//std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
-			std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
-			mesher_queue_.insert(p.second);
-		}
-			//if (!isChunkInUpdateList(p.second))
-			//	updatedChunks_.push_back(p.second);
-	}
+		//std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
+		UpdateChunk(chunk);
+			//if (!isChunkInUpdateList(chunk))
+			//	updatedChunks_.push_back(chunk);
+	});
 }
 
 
@@ -204,14 +265,16 @@ void ChunkManager::SaveWorld(std::string fname)
 {
 	std::ofstream of("./resources/Maps/" + fname + ".bin", std::ios::binary);
 	cereal::BinaryOutputArchive archive(of);
-	std::vector<Chunk*> tempChunks;
-	//tempChunks.insert(tempChunks.begin(), Chunk::chunks.begin(), Chunk::chunks.end());
-	std::for_each(ChunkStorage::GetMapRaw().begin(), ChunkStorage::GetMapRaw().end(), [&](auto& p)
+
+	// snapshots let the world keep changing while it's being written out
+	std::vector<std::shared_ptr<const ChunkSnapshot>> snapshots;
+	ChunkStorage::GetMapRaw().ForEach([&](const glm::ivec3&, ChunkPtr chunk)
 		{
-			if (p.second)
-				tempChunks.push_back(p.second);
+			snapshots.push_back(chunk->Snapshot());
 		});
-	archive(tempChunks);
+	archive(cereal::make_size_tag(static_cast<cereal::size_type>(snapshots.size())));
+	for (const auto& snapshot : snapshots)
+		archive(*snapshot);
 
 	std::cout << "Saved to " << fname << "!\n";
 }
@@ -219,29 +282,30 @@ void ChunkManager::SaveWorld(std::string fname)
 
 void ChunkManager::LoadWorld(std::string fname)
 {
-	for_each(ChunkStorage::GetMapRaw().begin(), ChunkStorage::GetMapRaw().end(), [](auto pair)
-	{
-		if (pair.second)
-			delete pair.second;
-	});
-	ChunkStorage::GetMapRaw().clear();
+	ChunkStorage::Clear();
 
-	// TODO: fix this (doesn't call serialize functions for some reason)
 	std::ifstream is("./resources/Maps/" + fname + ".bin", std::ios::binary);
 	cereal::BinaryInputArchive archive(is);
-	std::vector<Chunk> tempChunks;
-	archive(tempChunks);
-	std::for_each(tempChunks.begin(), tempChunks.end(), [&](Chunk& c)
-		{
-		ChunkStorage::GetMapRaw()[c.GetPos()] = new Chunk(c);
-		});
+	cereal::size_type count;
+	archive(cereal::make_size_tag(count));
+	for (cereal::size_type i = 0; i < count; i++)
+	{
+		auto snapshot = std::make_unique<ChunkSnapshot>();
+		archive(*snapshot);
+		Chunk* chunk = new Chunk();
+		chunk->Restore(*snapshot);
+		chunk->SetState(ChunkState::Lit); // saved with its light
+		ChunkStorage::Insert(chunk);
+	}
 
 	ReloadAllChunks();
 	std::cout << "Loaded " << fname << "!\n";
 }
 
 
-void ChunkManager::checkUpdateChunkNearBlock(const glm::ivec3& pos, const glm::ivec3& near)
+// removed: the block that was at pos, added: the block that replaced it
+void ChunkManager::checkUpdateChunkNearBlock(const glm::ivec3& pos, const glm::ivec3& near,
+	Block removed, Block added)
 {
 	// skip if both blocks are in same chunk
 	auto p1 = ChunkHelpers::worldPosToLocalPos(pos);
@@ -249,19 +313,141 @@ void ChunkManager::checkUpdateChunkNearBlock(const glm::ivec3& pos, const glm::i
 	if (p1.chunk_pos == p2.chunk_pos)
 		return;
 
-	// update chunk if near block is NOT air/invisible
-	//BlockPtr cb = Chunk::AtWorld(pos);
-	//BlockPtr nb = Chunk::AtWorld(pos + near);
-	//if (cb && nb && nb->GetType() != BlockType::bAir)
 	ChunkPtr cptr = ChunkStorage::GetChunk(p2.chunk_pos);
-	if (cptr)
+	if (!cptr)
+		return;
+
+	// the near block's face toward pos appears or disappears
+	BlockType nb = cptr->BlockAt(p2.block_pos).GetType();
+	const auto& emits = FaceMask::EmitTable[-near.y > 0];
+	bool faceChanged = emits[uint16_t(nb)][uint16_t(removed.GetType())] !=
+		emits[uint16_t(nb)][uint16_t(added.GetType())];
+	if (faceChanged)
+		delayed_update_queue_[cptr] |= ChunkMesh::SectionsNear(pos.y - p2.chunk_pos.y * Chunk::CHUNK_SIZE);
+}
+
+
+// a block's light is read by the faces around it, which can be in the chunks it borders
+void ChunkManager::markNearBlock(const ChunkStorage::Cursor& c)
+{
+	if (c.chunk)
+		delayed_update_queue_[c.chunk] |= ChunkMesh::SectionsNear(c.lpos.y);
+
+	constexpr glm::ivec3 dirs[] =
+	{
+		{-1, 0, 0 },
+		{ 1, 0, 0 },
+		{ 0,-1, 0 },
+		{ 0, 1, 0 },
+		{ 0, 0,-1 },
+		{ 0, 0, 1 }
+	};
+	for (const auto& dir : dirs)
 	{
-		std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
-		mesher_queue_.insert(cptr);
-		delayed_update_queue_.erase(cptr);
+		ChunkStorage::Cursor n = ChunkStorage::Step(c, dir);
+		if (n.chunk && n.chunk != c.chunk)
+			delayed_update_queue_[n.chunk] |= ChunkMesh::SectionsNear(c.WorldPos().y - n.cpos.y * Chunk::CHUNK_SIZE);
 	}
-		//if (!isChunkInUpdateList(Chunk::chunks[p2.chunk_pos]))
-		//	updatedChunks_.push_back(Chunk::chunks[p2.chunk_pos]);
+}
+
+
+void ChunkManager::updateSchedulers()
+{
+	Camera* cam = Renderer::GetPipeline()->GetCamera(0);
+	if (!cam)
+		return;
+
+	// work for chunks past where they'd be unloaded is dropped until they're back in range
+	Frustum frustum = *cam->GetFrustum();
+	float radius = loadDistance_ + unloadLeniency_;
+	for (size_t i = generation_queue_.Update(cam->GetPos(), cam->front, frustum, radius); i > 0; i--)
+		jobs_->Submit([this] { generateJob(); });
+	for (size_t i = mesher_queue_.Update(cam->GetPos(), cam->front, frustum, radius); i > 0; i--)
+		jobs_->Submit([this] { meshJob(); });
+}
+
+
+void ChunkManager::updateLods()
+{
+	// with LOD meshes off there's nothing to do once every chunk is back at LOD 0
+	bool enabled = Settings::Graphics.lodMeshes;
+	if (!enabled && lodLevels_ == 0 && lodNext_ == lodPass_.size())
+		return;
+
+	Camera* cam = Renderer::GetPipeline()->GetCamera(0);
+	if (!cam)
+		return;
+
+	// moving less than the hysteresis of the nearest boundary can't change a chunk's level by much
+	const auto& settings = ChunkRenderer::settings;
+	auto& map = ChunkStorage::GetMapRaw();
+	glm::vec3 eye = cam->GetPos();
+	size_t count = map.Size();
+	bool changed = glm::distance(eye, lodEye_) > settings.lodStart * settings.lodHysteresis ||
+		count != lodChunkCount_ || enabled != lodMeshes_;
+	if (lodNext_ == lodPass_.size() && changed)
+	{
+		lodPass_.clear();
+		map.ForEach([&](const glm::ivec3& pos, ChunkPtr)
+		{
+			lodPass_.push_back(pos);
+		});
+		lodNext_ = 0;
+		lodEye_ = eye;
+		lodChunkCount_ = count;
+		lodMeshes_ = enabled;
+		lodPassLevels_ = 0;
+	}
+	if (lodNext_ == lodPass_.size())
+		return;
+
+	// the current camera is used, so a chunk is placed where it is now even late in the pass
+	size_t end = std::min(lodPass_.size(), lodNext_ + LodsPerUpdate);
+	for (; lodNext_ < end; lodNext_++)
+	{
+		ChunkPtr chunk = map.Find(lodPass_[lodNext_]);
+		if (!chunk)
+			continue; // removed since the pass started
+
+		ChunkMesh& mesh = chunk->GetMesh();
+		AABB box = chunk->GetAABB();
+		float distance = glm::distance((box.min + box.max) / 2.f, eye);
+		int level = lodMeshes_ ? selectLod(distance, mesh.GetLod()) : 0;
+		if (level != mesh.GetLod())
+		{
+			mesh.SetLod(level);
+			UpdateChunk(chunk, ChunkMesh::ALL_SECTIONS, JobSystem::Priority::Low);
+		}
+		if (level > 0)
+			lodPassLevels_++;
+	}
+	if (lodNext_ == lodPass_.size())
+		lodLevels_ = lodPassLevels_;
+}
+
+
+// LOD 0 up to lodStart, then a level more each time the distance doubles
+// chunks only change level once they're lodHysteresis past a boundary,
+// so the ones near it aren't remeshed back and forth as the camera moves
+int ChunkManager::selectLod(float distance, int current)
+{
+	const auto& settings = ChunkRenderer::settings;
+	auto start = [&](int level) { return settings.lodStart * float(1 << (level - 1)); };
+
+	int level = current;
+	while (level < LodGrid::MAX_LEVEL && distance > start(level + 1) * (1 + settings.lodHysteresis))
+		level++;
+	while (level > 0 && distance < start(level) * (1 - settings.lodHysteresis))
+		level--;
+	return level;
+}
+
+
+void ChunkManager::flushDelayedUpdates(JobSystem::Priority priority)
+{
+	for (auto [chunk, sections] : delayed_update_queue_)
+		UpdateChunk(chunk, sections, priority);
+	delayed_update_queue_.clear();
 }
 
 
@@ -270,29 +456,32 @@ void ChunkManager::checkUpdateChunkNearBlock(const glm::ivec3& pos, const glm::i
 void ChunkManager::removeFarChunks()
 {
 	// delete chunks far from the camera (past leniency range)
-	if (generation_queue_.size() == 0 && mesher_queue_.size() == 0 && debug_cur_pool_left == 0)
+	if (generation_queue_.Size() == 0 && mesher_queue_.Size() == 0 && jobs_->RunningJobs() == 0)
 	{
 		std::vector<ChunkPtr> deleteList;
 		// attempt at safety
-		std::lock_guard<std::mutex> lock1(chunk_generation_mutex_);
 		std::lock_guard<std::mutex> lock2(chunk_mesher_mutex_);
 		std::lock_guard<std::mutex> lock3(chunk_buffer_mutex_);
-		Utils::erase_if(
-			ChunkStorage::GetMapRaw(),
-			[&](auto& p)->bool
+		ChunkStorage::RemoveIf([&](const glm::ivec3& cpos, ChunkPtr chunk)
 		{
 			// range is distance from camera to corner of chunk (corner is ok)
-			float dist = glm::distance(glm::vec3(p.first * Chunk::CHUNK_SIZE), Renderer::GetPipeline()->GetCamera(0)->GetPos());
-			if (p.second && dist > loadDistance_ + unloadLeniency_)
+			float dist = glm::distance(glm::vec3(cpos * Chunk::CHUNK_SIZE), Renderer::GetPipeline()->GetCamera(0)->GetPos());
+			if (dist > loadDistance_ + unloadLeniency_)
 			{
-				deleteList.push_back(p.second);
+				deleteList.push_back(chunk);
 				return true;
 			}
 			return false;
 		});
 
 		for (ChunkPtr p : deleteList)
+		{
+			generation_queue_.Remove(p);
+			mesher_queue_.Remove(p);
+			waiting_.erase(p);
+			buffer_queue_.erase(p); // uploads can be left over from earlier frames
 			delete p;
+		}
 	}
 
 	//std::for_each(
@@ -316,23 +505,25 @@ void ChunkManager::removeFarChunks()
 void ChunkManager::createNearbyChunks()
 {
 	// generate new chunks that are close to the camera
-	std::for_each(
-		std::execution::par,
-		ChunkStorage::GetMapRaw().begin(),
-		ChunkStorage::GetMapRaw().end(),
-		[&](auto& p)
+	// (the map never holds null entries, so scan the positions in range instead)
+	glm::vec3 camPos = Renderer::GetPipeline()->GetCamera(0)->GetPos();
+	glm::ivec3 center = ChunkHelpers::worldPosToLocalPos(glm::ivec3(camPos)).chunk_pos;
+	int range = int(loadDistance_ / Chunk::CHUNK_SIZE) + 1;
+	for (int x = -range; x <= range; x++)
 	{
-		float dist = glm::distance(glm::vec3(p.first * Chunk::CHUNK_SIZE), Renderer::GetPipeline()->GetCamera(0)->GetPos());
-		// generate null chunks within distance
-		if (!p.second && dist <= loadDistance_)
+		for (int y = -range; y <= range; y++)
 		{
-			p.second = new Chunk();
-			p.second->SetPos(p.first);
-//			p.second->generate_ = true;
-			std::lock_guard<std::mutex> lock1(chunk_generation_mutex_);
-			generation_queue_.insert(p.second);
+			for (int z = -range; z <= range; z++)
+			{
+				glm::ivec3 cpos = center + glm::ivec3(x, y, z);
+				float dist = glm::distance(glm::vec3(cpos * Chunk::CHUNK_SIZE), camPos);
+				if (dist > loadDistance_ || ChunkStorage::GetChunk(cpos) || ChunkStorage::IsAir(cpos))
+					continue;
+
+				queueGeneration(ChunkStorage::Materialize(cpos));
+			}
 		}
-	});
+	}
 }
 
 
@@ -342,7 +533,7 @@ void ChunkManager::createNearbyChunks()
 // wpos: world position
 // nLight: new lighting value
 // skipself: chunk updating thing
-void ChunkManager::lightPropagateAdd(glm::ivec3 wpos, Light nLight, bool skipself)
+void ChunkManager::lightPropagateAdd(glm::ivec3 wpos, Light nLight)
 {
 	// get existing light at the position
 	auto optL = ChunkStorage::AtWorldE(wpos);
@@ -352,18 +543,19 @@ void ChunkManager::lightPropagateAdd(glm::ivec3 wpos, Light nLight, bool skipsel
 		// combine the two by taking the max values only
 		glm::u8vec4 t = glm::max(optL->GetLight().Get(), nLight.Get());
 		ChunkStorage::SetLight(wpos, t);
+		markNearBlock(ChunkStorage::CursorAt(wpos));
 		//L.Set(t); //*L = t;
 	}
 	
-	// queue of world positions, rather than chunk + local index (they are equivalent)
-	std::queue<glm::ivec3> lightQueue;
-	lightQueue.push(wpos);
+	// queue of cursors, so stepping to a neighbor follows the chunk's neighbor pointers
+	std::queue<ChunkStorage::Cursor> lightQueue;
+	lightQueue.push(ChunkStorage::CursorAt(wpos));
 
 	while (!lightQueue.empty())
 	{
-		glm::ivec3 lightp = lightQueue.front(); // light position
+		ChunkStorage::Cursor lightp = lightQueue.front(); // light position
 		lightQueue.pop();
-		Light lightLevel = ChunkStorage::AtWorldC(lightp).GetLight(); // node that will be giving light to others
+		Light lightLevel = ChunkStorage::At(lightp).value_or(Block()).GetLight(); // node that will be giving light to others
 		constexpr glm::ivec3 dirs[] =
 		{
 			{ 1, 0, 0 },
@@ -377,18 +569,14 @@ void ChunkManager::lightPropagateAdd(glm::ivec3 wpos, Light nLight, bool skipsel
 		// update each neighbor
 		for (const auto& dir : dirs)
 		{
-			glm::ivec3 lightPos = lightp + dir;
-			auto block = ChunkStorage::AtWorldE(lightPos);
+			ChunkStorage::Cursor lightPos = ChunkStorage::Step(lightp, dir);
+			auto block = ChunkStorage::At(lightPos);
 			if (!block.has_value())
 				continue;
 			//BlockPtr block = GetBlockPtr(lightp + dir);
 			//Block block = GetBlock(lightp + dir); // neighboring block
 			//LightPtr light = &block->GetLightRef(); // neighboring light (pointer)
 			Light light = block->GetLight();
-
-			// add chunk to update queue if it exists
-			if (ChunkStorage::GetChunk(ChunkHelpers::worldPosToLocalPos(lightPos).chunk_pos) != nullptr)
-				delayed_update_queue_.insert(ChunkStorage::GetChunk(ChunkHelpers::worldPosToLocalPos(lightPos).chunk_pos));
 			
 			// invalid light check
 			//ASSERT(light != nullptr);
@@ -410,29 +598,30 @@ void ChunkManager::lightPropagateAdd(glm::ivec3 wpos, Light nLight, bool skipsel
 				// then push the position of that light into the queue
 				//glm::u8vec4 val = light.Get();
 				// this line can be optimized to reduce amount of global block getting
-				glm::u8vec4 val = ChunkStorage::AtWorldC(lightPos).GetLight().Get();
+				glm::u8vec4 val = ChunkStorage::At(lightPos).value_or(Block()).GetLight().Get();
 				val[ci] = (lightLevel.Get()[ci] - 1);// *Block::PropertiesTable[block.GetTypei()].color[ci];
 				//light->Set(val);
 				ChunkStorage::SetLight(lightPos, val);
 				enqueue = true;
 			}
 			if (enqueue) // enqueue if any lighting component changed
+			{
 				lightQueue.push(lightPos);
+				markNearBlock(lightPos);
+			}
 		}
 	}
-
-	// do not update this chunk again if it contained the placed light
-	if (skipself)
-		delayed_update_queue_.erase(ChunkStorage::GetChunk(ChunkHelpers::worldPosToLocalPos(wpos).chunk_pos));
 }
 
 
 void ChunkManager::lightPropagateRemove(glm::ivec3 wpos)
 {
-	std::queue<std::pair<glm::ivec3, Light>> lightRemovalQueue;
-	Light light = ChunkStorage::AtWorldC(wpos).GetLight();
-	lightRemovalQueue.push({ wpos, light });
-	ChunkStorage::SetLight(wpos, Light({ 0, 0, 0, light.GetS() }));
+	std::queue<std::pair<ChunkStorage::Cursor, Light>> lightRemovalQueue;
+	ChunkStorage::Cursor start = ChunkStorage::CursorAt(wpos);
+	Light light = ChunkStorage::At(start).value_or(Block()).GetLight();
+	lightRemovalQueue.push({ start, light });
+	ChunkStorage::SetLight(start, Light({ 0, 0, 0, light.GetS() }));
+	markNearBlock(start);
 	//GetBlockPtr(wpos)->GetLightRef().Set({ 0, 0, 0, light.GetS() });
 
 	std::queue<std::pair<glm::ivec3, Light>> lightReadditionQueue;
@@ -455,8 +644,8 @@ void ChunkManager::lightPropagateRemove(glm::ivec3 wpos)
 
 		for (const auto& dir : dirs)
 		{
-			glm::ivec3 blockPos = plight + dir;
-			auto optB = ChunkStorage::AtWorldE(blockPos);
+			ChunkStorage::Cursor blockPos = ChunkStorage::Step(plight, dir);
+			auto optB = ChunkStorage::At(blockPos);
 			//BlockPtr b = GetBlockPtr(plight + dir);
 			if (!optB.has_value())
 				continue;
@@ -466,7 +655,7 @@ void ChunkManager::lightPropagateRemove(glm::ivec3 wpos)
 				// if the removed block emits light, it needs to be re-propagated
 				auto emit = Block::PropertiesTable[optB->GetTypei()].emittance;
 				if (emit != glm::u8vec4(0))
-					lightReadditionQueue.push({ blockPos, emit });
+					lightReadditionQueue.push({ blockPos.WorldPos(), emit });
 				Light nearLight = optB->GetLight();
 				//Light& nearLight = b->GetLightRef();
 				glm::u8vec4 nlightv = nearLight.Get(); // near light value
@@ -478,8 +667,7 @@ void ChunkManager::lightPropagateRemove(glm::ivec3 wpos)
 					if (nlightv[ci] != 0 && nlightv[ci] == lightv[ci] - 1)
 					{
 						lightRemovalQueue.push({ blockPos, nearLight });
-						if (ChunkStorage::GetChunk(ChunkHelpers::worldPosToLocalPos(blockPos).chunk_pos))
-							delayed_update_queue_.insert(ChunkStorage::GetChunk(ChunkHelpers::worldPosToLocalPos(blockPos).chunk_pos));
+						markNearBlock(blockPos);
 						auto tmp = nearLight.Get();
 						tmp[ci] = 0;
 						//nearLight.Set(tmp);
@@ -491,7 +679,7 @@ void ChunkManager::lightPropagateRemove(glm::ivec3 wpos)
 					{
 						glm::u8vec4 nue(0);
 						nue[ci] = nlightv[ci];
-						lightReadditionQueue.push({ blockPos, nue });
+						lightReadditionQueue.push({ blockPos.WorldPos(), nue });
 					}
 				}
 			}
@@ -504,11 +692,8 @@ void ChunkManager::lightPropagateRemove(glm::ivec3 wpos)
 	{
 		const auto& p = lightReadditionQueue.front();
 		lightReadditionQueue.pop();
-		lightPropagateAdd(p.first, p.second, false);
+		lightPropagateAdd(p.first, p.second);
 	}
-
-	// do not update the removed block's chunk again since the act of removing will update it
-	delayed_update_queue_.erase(ChunkStorage::GetChunk(ChunkHelpers::worldPosToLocalPos(wpos).chunk_pos));
 }
 
 
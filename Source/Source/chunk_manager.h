@@ -1,38 +1,22 @@
 #pragma once
 #include "chunk.h"
+#include "ChunkStorage.h"
 #include "block.h"
 #include "camera.h"
 #include <Pipeline.h>
 #include "Renderer.h"
+#include "JobSystem.h"
+#include "ChunkScheduler.h"
 
 #include <set>
 #include <unordered_set>
+#include <unordered_map>
 #include <atomic>
 #include <stack>
 
 typedef struct Chunk* ChunkPtr;
 //class ChunkLoadManager;
 
-namespace Utils
-{
-	struct ChunkPtrKeyEq
-	{
-		bool operator()(const ChunkPtr& first, const ChunkPtr& second) const
-		{
-			//ASSERT(first != second);
-			if (first == second)
-				return false;
-			glm::vec3 wposA = glm::vec3(first->GetPos() * Chunk::CHUNK_SIZE);
-			glm::vec3 wposB = glm::vec3(second->GetPos() * Chunk::CHUNK_SIZE);
-			glm::vec3 cam = Renderer::GetPipeline()->GetCamera(0)->GetPos();
-			return
-				glm::distance(wposA, cam) <
-				glm::distance(wposB, cam);
-		}
-	};
-}
-
-
 // Interfaces with the Chunk class to
 // manage how and when chunk block and mesh data is generated, and
 // when that data is sent to the GPU.
@@ -52,7 +36,9 @@ public:
 
 	// interaction
 	void Update();
-	void UpdateChunk(ChunkPtr chunk);
+	// remesh some sections of a chunk
+	void UpdateChunk(ChunkPtr chunk, uint8_t sections = ChunkMesh::ALL_SECTIONS,
+		JobSystem::Priority priority = JobSystem::Priority::Normal);
 	void UpdateChunk(const glm::ivec3 wpos); // update chunk at block position
 	void UpdateBlock(const glm::ivec3& wpos, Block bl);
 	void UpdateBlockCheap(const glm::ivec3& wpos, Block block);
@@ -66,6 +52,7 @@ public:
 	//void SetCurrentLevel(LevelPtr level) { level_ = level; }
 	void SetLoadDistance(float d) { loadDistance_ = d; }
 	void SetUnloadLeniency(float d) { unloadLeniency_ = d; }
+	void SetWorkerCount(int n) { workerCount_ = n; } // job system workers, only read by Init (0 for the default)
 
 	void SaveWorld(std::string fname);
 	void LoadWorld(std::string fname);
@@ -74,42 +61,85 @@ public:
 private:
 public: // TODO: TEMPORARY
 	// functions
-	void checkUpdateChunkNearBlock(const glm::ivec3& pos, const glm::ivec3& near);
+	void checkUpdateChunkNearBlock(const glm::ivec3& pos, const glm::ivec3& near, Block removed, Block added);
 
 	void removeFarChunks();
 	void createNearbyChunks();
 
-	// generates actual blocks
-	void chunk_generator_thread_task();
-	//std::set<ChunkPtr, Utils::ChunkPtrKeyEq> generation_queue_;
-	std::unordered_set<ChunkPtr> generation_queue_;
-	std::mutex chunk_generation_mutex_;
-	std::vector<std::thread*> chunk_generator_threads_;
+	// every stage of the chunk pipeline runs as a job
+	// a queued chunk is in its stage's scheduler, and each time a chunk is queued a job is submitted
+	// that takes whichever chunk of the stage is most urgent when it runs
+	std::unique_ptr<JobSystem> jobs_;
+	int workerCount_ = 0;
+
+	// snapshots the camera for the schedulers, once per tick
+	void updateSchedulers();
+
+	// generates actual blocks, then lights them
+	void queueGeneration(ChunkPtr chunk);
+	void generateJob();
+	ChunkScheduler generation_queue_;
+
+	// spreads the light of a generated chunk's emitters, then meshes it
+	void lightChunk(ChunkPtr chunk);
+	// flood fills (and delayed_update_queue_, which they fill) are one at a time,
+	// whether they come from an edit or from a job
+	std::mutex light_mutex_;
+
+	// moves a chunk to a later state (never back), then queues the meshes that were waiting on it
+	void advanceChunk(ChunkPtr chunk, ChunkState state);
+	// lit, not being meshed, and every face neighbor that exists has its blocks,
+	// so its border faces won't change when they're generated (only with chunk_mesher_mutex_ held)
+	bool readyToMesh(ChunkPtr chunk) const;
+	// chunks updated before they were ready to mesh, they're queued when they become ready
+	std::unordered_map<ChunkPtr, JobSystem::Priority> waiting_;
+	void queueIfReady(ChunkPtr chunk); // with chunk_mesher_mutex_ held
 
 	// generates meshes for ANY UPDATED chunk
-	void chunk_mesher_thread_task();
-	//std::set<ChunkPtr, Utils::ChunkPtrKeyEq> mesher_queue_;
-	//std::set<ChunkPtr> mesher_queue_;
-	std::unordered_set<ChunkPtr> mesher_queue_;
+	void queueMesh(ChunkPtr chunk, JobSystem::Priority priority); // with chunk_mesher_mutex_ held
+	void meshJob();
+	ChunkScheduler mesher_queue_;
+	std::unordered_set<ChunkPtr> meshing_; // a chunk updated while it's meshed waits until it's done
 	std::mutex chunk_mesher_mutex_;
-	std::vector<std::thread*> chunk_mesher_threads_;
 	std::atomic_int debug_cur_pool_left = 0;
 
 	// NOT multithreaded task
+	// stale meshes are skipped, the chunk is queued again when its newer mesh is built
+	// uploads stop at ChunkRenderer::settings' budget, the chunks left over stay queued
 	void chunk_buffer_task();
-	//std::set<ChunkPtr, Utils::ChunkPtrKeyEq> buffer_queue_;
 	std::unordered_set<ChunkPtr> buffer_queue_;
 	std::mutex chunk_buffer_mutex_;
+	size_t debug_superseded = 0; // uploads skipped because a newer mesh was on its way
+	size_t debug_uploaded = 0;   // by the last chunk_buffer_task
 
 
 	// DEBUG does everything in a serial fashion
 	// chunk_buffer_task must be called after this
 	void chunk_gen_mesh_nobuffer();
 
-	std::unordered_set<ChunkPtr> delayed_update_queue_;
+	// mesh sections to update once the current edit is done, so chunks touched many times are queued once
+	// only used with light_mutex_ held
+	std::unordered_map<ChunkPtr, uint8_t> delayed_update_queue_;
+	void markNearBlock(const ChunkStorage::Cursor& c); // the light of a block changed
+	// edits (and the light they move) are what the player is waiting to see, so they go first by default
+	void flushDelayedUpdates(JobSystem::Priority priority = JobSystem::Priority::High);
+
+	// picks the LOD of each chunk's mesh from its distance to the camera, remeshing those that change
+	// chunks are re-evaluated a slice per update, in passes that only start once the camera has moved
+	// past the LOD hysteresis, chunks were added or removed, or LOD meshes were turned on or off
+	void updateLods();
+	static int selectLod(float distance, int current);
+	static constexpr size_t LodsPerUpdate = 2048;
+	std::vector<glm::ivec3> lodPass_; // the pass in progress
+	size_t lodNext_ = 0;
+	glm::vec3 lodEye_{ 0 };     // what the pass in progress started from
+	size_t lodChunkCount_ = 0;
+	bool lodMeshes_ = false;
+	size_t lodPassLevels_ = 0;  // chunks given a nonzero level by the pass in progress
+	size_t lodLevels_ = 0;      // by the last complete pass
 
 	// new light intensity to add
-	void lightPropagateAdd(glm::ivec3 wpos, Light nLight, bool skipself = true);
+	void lightPropagateAdd(glm::ivec3 wpos, Light nLight);
 	void lightPropagateRemove(glm::ivec3 wpos);
 
 	// returns true if block at max sunlight level
@@ -120,7 +150,6 @@ public: // TODO: TEMPORARY
 	// vars
 	float loadDistance_;
 	float unloadLeniency_;
-	bool shutdownThreads = false;
 	//std::vector<ChunkPtr> updatedChunks_;
 	//std::vector<ChunkPtr> genChunkList_;
 	//LevelPtr level_ = nullptr;
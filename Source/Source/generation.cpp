@@ -26,8 +26,9 @@ void WorldGen::GenerateSimpleWorld(int xSize, int ySize, int zSize, float sparse
 		{
 			for (int zc = 0; zc < zSize; zc++)
 			{
-				Chunk* init = ChunkStorage::GetMapRaw()[glm::ivec3(xc, yc, zc)] = new Chunk();
+				Chunk* init = new Chunk();
 				init->SetPos(glm::ivec3(xc, yc, zc));
+				ChunkStorage::Insert(init);
 				updateList.push_back(init);
 					
 				for (int x = 0; x < Chunk::CHUNK_SIZE; x++)
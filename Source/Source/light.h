@@ -10,6 +10,7 @@ public:
 	Light(glm::u8vec4 L) { Set(L); }
 
 	uint16_t& Raw() { return raw_; }
+	uint16_t Raw() const { return raw_; }
 
 	glm::u8vec4 Get() const { return { GetR(), GetG(), GetB(), GetS() }; }
 	uint8_t GetR() const { return raw_ >> 12; }
@@ -32,4 +33,13 @@ public:
 private:
 	// 4 bits each of: red, green, blue, and sunlight
 	uint16_t raw_;
-}Light, *LightPtr;
\ No newline at end of file
+}Light, *LightPtr;
+
+namespace std
+{
+	template<>
+	struct hash<Light>
+	{
+		size_t operator()(const Light& l) const { return hash<uint16_t>()(l.Raw()); }
+	};
+}
\ No newline at end of file
@@ -4,10 +4,42 @@
 #include "World.h"
 #include "Renderer.h"
 #include "NuRenderer.h"
+#include "MemoryStats.h"
+#include "MesherBench.h"
+#include "WorldGen2.h"
+#include <cstring>
 
 
-int main()
+int main(int argc, char** argv)
 {
+	// --dump-memory <path>: generate the initial world without a window, write its memory stats and exit
+	// there is no GL context, so nothing is meshed or uploaded and the GPU allocators are reported as null
+	const char* memoryDumpPath = nullptr;
+	for (int i = 1; i + 1 < argc; i++)
+		if (std::strcmp(argv[i], "--dump-memory") == 0)
+			memoryDumpPath = argv[i + 1];
+
+	// --bench-mesher [options]: mesh a generated region without a window, print timings and exit
+	MesherBench::Options benchOptions;
+	switch (MesherBench::ParseArgs(argc, argv, benchOptions))
+	{
+	case MesherBench::ParseResult::Ok:
+		return MesherBench::Run(benchOptions);
+	case MesherBench::ParseResult::Invalid:
+		return 2;
+	default:
+		break;
+	}
+
+	if (memoryDumpPath)
+	{
+		WorldGen2::Init();
+		WorldGen2::GenerateWorld();
+		bool ok = MemoryStats::DumpJson(memoryDumpPath);
+		printf("%s memory stats to %s\n", ok ? "Wrote" : "Failed to write", memoryDumpPath);
+		return ok ? 0 : 1;
+	}
+
 	//BitArray coom(50);
 	//coom.SetSequence(5, 8, 0b11001101);
 	//std::bitset<8> bb(coom.GetSequence(5, 8));
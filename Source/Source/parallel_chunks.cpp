@@ -1,124 +1,161 @@
 #include "stdafx.h"
 #include "chunk_manager.h"
+#include "generation.h"
+#include "ChunkRenderer.h"
 #include <algorithm>
+#include <chrono>
 #include <execution>
 
-// TODO: add a way to notify these threads to terminate when the program
-// does to prevent crash on exit
 
-// perpetual thread task to generate blocks in new chunks
-void ChunkManager::chunk_generator_thread_task()
+// queues a new chunk to have its blocks generated
+void ChunkManager::queueGeneration(ChunkPtr chunk)
 {
-	while (!shutdownThreads)
-	{
-		//std::set<ChunkPtr, Utils::ChunkPtrKeyEq> temp;
-		std::unordered_set<ChunkPtr> temp;
-		{
-			std::lock_guard<std::mutex> lock1(chunk_generation_mutex_);
-			temp.swap(generation_queue_);
-		}
+	if (generation_queue_.Push(chunk) && jobs_)
+		jobs_->Submit([this] { generateJob(); });
+}
 
-		std::for_each(std::execution::seq, temp.begin(), temp.end(), [this](ChunkPtr chunk)
-		{
-			WorldGen::GenerateChunk(chunk->GetPos());
-			std::lock_guard<std::mutex> lock2(chunk_mesher_mutex_);
-			mesher_queue_.insert(chunk);
-		});
 
-		//std::lock_guard<std::mutex> lock2(chunk_mesher_mutex_);
-		//mesher_queue_.insert(temp.begin(), temp.end());
-	}
+// generates blocks in the most urgent new chunk, then lights it
+void ChunkManager::generateJob()
+{
+	ChunkPtr chunk = generation_queue_.Pop();
+	if (!chunk)
+		return;
+
+	WorldGen::GenerateChunk(chunk->GetPos());
+	advanceChunk(chunk, ChunkState::Generated);
+	jobs_->Submit([this, chunk] { lightChunk(chunk); });
 }
 
 
-// TODO: figure how to make this parallel again (if necessary)
-// perpetual thread task to generate meshes for updated chunks
-void ChunkManager::chunk_mesher_thread_task()
+// spreads the light of every emitter in a generated chunk, which can reach into its neighbors,
+// then queues the chunk and whatever the light reached to be meshed (once they're ready)
+void ChunkManager::lightChunk(ChunkPtr chunk)
 {
-	while (!shutdownThreads)
+	thread_local static auto types = std::make_unique<Chunk::TypeArray>();
+	chunk->ExportTypes(*types);
+
+	std::lock_guard<std::mutex> lock(light_mutex_);
+	glm::ivec3 origin = chunk->GetPos() * Chunk::CHUNK_SIZE;
+	int i = 0;
+	for (int z = 0; z < Chunk::CHUNK_SIZE; z++)
 	{
-		//std::set<ChunkPtr, Utils::ChunkPtrKeyEq> temp;
-		//std::set<ChunkPtr> temp;
-		std::unordered_set<ChunkPtr> temp;
-		std::vector<ChunkPtr> sorted; // to-be ordered set containing temp's items
+		for (int y = 0; y < Chunk::CHUNK_SIZE; y++)
 		{
-			std::lock_guard<std::mutex> lock1(chunk_mesher_mutex_);
-			temp.swap(mesher_queue_);
-			debug_cur_pool_left += temp.size();
+			for (int x = 0; x < Chunk::CHUNK_SIZE; x++)
+			{
+				glm::u8vec4 emit = Block::PropertiesTable[int((*types)[i++])].emittance;
+				if (emit != glm::u8vec4(0))
+					lightPropagateAdd(origin + glm::ivec3(x, y, z), Light(emit));
+			}
 		}
-		sorted.insert(sorted.begin(), temp.begin(), temp.end());
-
-		// TODO: this is temp solution to load near chunks to camera first
-		std::sort(std::execution::par_unseq ,sorted.begin(), sorted.end(), Utils::ChunkPtrKeyEq());
-		std::for_each(std::execution::par, sorted.begin(), sorted.end(), [this](ChunkPtr chunk)
-		{
-			//SetThreadAffinityMask(GetCurrentThread(), ~1);
-			// send each mesh to GPU immediately after building it
-			chunk->BuildMesh();
-			debug_cur_pool_left--;
-			std::lock_guard<std::mutex> lock2(chunk_buffer_mutex_);
-			buffer_queue_.insert(chunk);
-		});
 	}
-	//std::shared_ptr<void> fdsa;
-	//fdsa.use_count();
+
+	advanceChunk(chunk, ChunkState::Lit);
+	delayed_update_queue_[chunk] |= ChunkMesh::ALL_SECTIONS;
+	flushDelayedUpdates(JobSystem::Priority::Normal);
 }
 
 
-// sends vertex data of fully-updated chunks to GPU from main thread (fast and simple)
-void ChunkManager::chunk_buffer_task()
+// meshes the most urgent queued chunk
+void ChunkManager::meshJob()
 {
-	//std::set<ChunkPtr, Utils::ChunkPtrKeyEq> temp;
-	std::unordered_set<ChunkPtr> temp;
+	// taken and marked as meshing at once, so an update in between waits for this mesh
+	ChunkPtr chunk;
+	{
+		std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
+		chunk = mesher_queue_.Pop();
+		if (!chunk)
+			return;
+		meshing_.insert(chunk);
+	}
+
+	debug_cur_pool_left++;
+	bool built = chunk->BuildMesh();
+	debug_cur_pool_left--;
+	if (built)
 	{
 		std::lock_guard<std::mutex> lock(chunk_buffer_mutex_);
-		temp.swap(buffer_queue_);
+		buffer_queue_.insert(chunk);
 	}
 
-	// normally, there will only be a few items in here per frame
-	for (ChunkPtr chunk : temp)
-		chunk->BuildBuffers();
+	// it was updated while it was being meshed, or its neighbors were being written too often to read them
+	std::lock_guard<std::mutex> lock(chunk_mesher_mutex_);
+	meshing_.erase(chunk);
+	if (!built)
+		waiting_.try_emplace(chunk, JobSystem::Priority::Low);
+	queueIfReady(chunk);
 }
 
 
-// copy-pasted from above functions
-void ChunkManager::chunk_gen_mesh_nobuffer()
+// sends vertex data of fully-updated chunks to GPU from main thread, nearest first,
+// until the frame's upload budget runs out (the rest are left for the next frames)
+void ChunkManager::chunk_buffer_task()
 {
+	std::vector<ChunkPtr> ready;
 	{
-		std::unordered_set<ChunkPtr> temp;
-		{
-			std::lock_guard<std::mutex> lock1(chunk_generation_mutex_);
-			temp.swap(generation_queue_);
-		}
+		std::lock_guard<std::mutex> lock(chunk_buffer_mutex_);
+		ready.assign(buffer_queue_.begin(), buffer_queue_.end());
+		buffer_queue_.clear();
+	}
+	debug_uploaded = 0;
+	if (ready.empty())
+		return;
 
-		std::for_each(std::execution::seq, temp.begin(), temp.end(), [this](ChunkPtr chunk)
-			{
-				WorldGen::GenerateChunk(chunk->GetPos());
-				std::lock_guard<std::mutex> lock2(chunk_mesher_mutex_);
-				mesher_queue_.insert(chunk);
-			});
+	if (Camera* cam = Renderer::GetPipeline()->GetCamera(0))
+	{
+		glm::vec3 eye = cam->GetPos();
+		auto distance = [&](ChunkPtr chunk)
+		{
+			AABB box = chunk->GetAABB();
+			return glm::distance((box.min + box.max) / 2.f, eye);
+		};
+		std::sort(ready.begin(), ready.end(), [&](ChunkPtr a, ChunkPtr b) { return distance(a) < distance(b); });
 	}
 
+	// meshes in the staging ring are only copies recorded on the GPU, but the allocators still search
+	// their allocations for every one, so the time is checked as well as the bytes
+	const auto& settings = ChunkRenderer::settings;
+	auto start = std::chrono::steady_clock::now();
+	size_t bytes = 0;
+	size_t next = 0;
+	for (; next < ready.size(); next++)
 	{
-		std::unordered_set<ChunkPtr> temp;
-		std::vector<ChunkPtr> sorted; // to-be ordered set containing temp's items
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		bool spent = elapsed.count() >= settings.uploadBudgetMs || bytes >= size_t(settings.uploadBudgetKB) * 1024;
+		if (next > 0 && spent)
+			break;
+
+		ChunkPtr chunk = ready[next];
+		if (chunk->GetMesh().IsStale())
 		{
-			std::lock_guard<std::mutex> lock1(chunk_mesher_mutex_);
-			temp.swap(mesher_queue_);
-			debug_cur_pool_left += temp.size();
+			debug_superseded++;
+			continue;
 		}
-		sorted.insert(sorted.begin(), temp.begin(), temp.end());
+		bytes += chunk->GetMesh().GetStagedBytes();
+		chunk->BuildBuffers();
+		debug_uploaded++;
+	}
 
-		// TODO: this is temp solution to load near chunks to camera first
-		std::sort(sorted.begin(), sorted.end(), Utils::ChunkPtrKeyEq());
-		std::for_each(std::execution::seq, sorted.begin(), sorted.end(), [this](ChunkPtr chunk)
-		{
-			//SetThreadAffinityMask(GetCurrentThread(), ~1);
-			// send each mesh to GPU immediately after building it
-			chunk->BuildMesh();
-			debug_cur_pool_left--;
-			std::lock_guard<std::mutex> lock2(chunk_buffer_mutex_);
-			buffer_queue_.insert(chunk);
-		});
+	if (next < ready.size())
+	{
+		std::lock_guard<std::mutex> lock(chunk_buffer_mutex_);
+		buffer_queue_.insert(ready.begin() + next, ready.end());
+	}
+}
+
+
+// does the work of the queued jobs on this thread instead, the jobs then find nothing to do
+void ChunkManager::chunk_gen_mesh_nobuffer()
+{
+	while (ChunkPtr chunk = generation_queue_.Pop())
+	{
+		WorldGen::GenerateChunk(chunk->GetPos());
+		advanceChunk(chunk, ChunkState::Generated);
+		lightChunk(chunk);
 	}
-}
\ No newline at end of file
+
+	// nearest first, like the jobs
+	while (mesher_queue_.Size() > 0)
+		meshJob();
+}
@@ -0,0 +1,122 @@
+#version 460 core
+
+// vertex pulling version of chunk_optimized.vs
+// each quad is one record (see ChunkHelpers::EncodeQuad) that is expanded into 6 vertices,
+// so draws are issued with 6 vertices per record and nothing is bound per vertex
+//
+// quad.x layout (left to right bits):
+// 0 - 14       15 - 17   18 - 26   27 - 31
+// lpos x,y,z   face      texture   h - 1
+// quad.y layout
+// 0 - 2    3 - 7    8 - 15       16 - 31
+// unused   w - 1    AO (3..0)    light (R, G, B, Sun)
+// w and h are the size (in blocks) of a greedy-meshed quad along the two axes
+// after the face's normal axis (x -> y -> z -> x)
+layout (std430, binding = 0) readonly buffer quadData
+{
+  uvec2 quads[];
+};
+
+// per-chunk info
+layout (location = 2) in ivec3 u_pos; // (per instance)
+
+// global info
+uniform mat4 u_viewProj;
+uniform float u_cubeCorners[72]; // Vertices::cube_light, 6 faces * 4 corners * xyz
+
+// records before the first quad of a chunk (chunk position + padding)
+const uint reservedRecords = 2;
+
+
+out vec3 vPos;
+out vec3 vNormal;
+out vec3 vTexCoord;
+out vec4 vLighting; // RGBSun
+out flat vec3 vBlockPos;
+
+out vec4 vColor;
+
+const vec3 normals[] =
+{
+  { 0, 0, 1 }, // 'far' face    (+z direction)
+  { 0, 0,-1 }, // 'near' face   (-z direction)
+  {-1, 0, 0 }, // 'left' face   (-x direction)
+  { 1, 0, 0 }, // 'right' face  (+x direction)
+  { 0, 1, 0 }, // 'top' face    (+y direction)
+  { 0,-1, 0 }  // 'bottom' face (-y direction)
+};
+
+
+// counterclockwise from bottom right texture coordinates
+const vec2 tex_corners[] =
+{
+  { 1, 0 },
+  { 1, 1 },
+  { 0, 1 },
+  { 0, 0 },
+};
+
+// corners of the two triangles of a quad
+const uint indicesA[] = { 0, 1, 3, 3, 1, 2 }; // normal indices
+const uint indicesB[] = { 0, 1, 2, 2, 3, 0 }; // anisotropy fix (flip tris)
+
+float layer2coord(uint capacity, uint layer)
+{
+  return max(0, min(float(capacity - 1), floor(float(layer) + 0.5)));
+}
+
+vec3 CubeCorner(uint face, uint corner)
+{
+  uint i = face * 12 + corner * 3;
+  return ceil(vec3(u_cubeCorners[i], u_cubeCorners[i + 1], u_cubeCorners[i + 2]));
+}
+
+
+void main()
+{
+  // draws start at 6 * the chunk's first record, so this is the quad's record in the whole buffer
+  uvec2 quad = quads[gl_VertexID / 6 + reservedRecords];
+
+  vec3 lpos = vec3(quad.x >> 27, (quad.x >> 22) & 0x1F, (quad.x >> 17) & 0x1F);
+  uint face = (quad.x >> 14) & 0x7;
+  uint textureIdx = (quad.x >> 5) & 0x1FF;
+  uint h = (quad.x & 0x1F) + 1;
+  uint w = ((quad.y >> 24) & 0x1F) + 1;
+
+  uint ao[4];
+  for (int i = 0; i < 4; i++)
+    ao[i] = (quad.y >> (16 + 2 * i)) & 0x3;
+
+  // partially solve anisotropy issue
+  uint cornerIdx = ao[0] + ao[2] > ao[1] + ao[3] ? indicesB[gl_VertexID % 6] : indicesA[gl_VertexID % 6];
+
+  // stretch the far corners over the rectangle
+  uint normalAxis = face < 2 ? 2 : face < 4 ? 0 : 1;
+  uint uAxis = (normalAxis + 1) % 3;
+  uint vAxis = (normalAxis + 2) % 3;
+  vec3 corner = CubeCorner(face, cornerIdx);
+  vec3 modelPos = lpos + corner;
+  modelPos[uAxis] += corner[uAxis] * (w - 1);
+  modelPos[vAxis] += corner[vAxis] * (h - 1);
+  vPos = modelPos + u_pos;
+  vNormal = normals[face];
+
+  // textures repeat across merged quads
+  // corners 0 and 3 only differ along the texture's horizontal axis
+  bool texAlongU = CubeCorner(face, 0)[uAxis] != CubeCorner(face, 3)[uAxis];
+  vec2 quadSize = texAlongU ? vec2(w, h) : vec2(h, w);
+  vTexCoord = vec3(tex_corners[cornerIdx] * quadSize, layer2coord(1024, textureIdx));
+
+  // the face's light, darkened by the corner's AO
+  vec4 lighting;
+  lighting.r = (quad.y >> 12) & 0xF;
+  lighting.g = (quad.y >> 8) & 0xF;
+  lighting.b = (quad.y >> 4) & 0xF;
+  lighting.a = quad.y & 0xF;
+  vLighting = max(lighting - (6 - 2 * float(ao[cornerIdx])), 0.0) / 16.0;
+
+  vec3 dirCent = 0.5 - corner; // direction from the corner to the center of its block
+  vBlockPos = vPos + dirCent; // block position = vertex pos + direction to center of block
+
+  gl_Position = u_viewProj * vec4(vPos, 1.0);
+}
\ No newline at end of file
@@ -9,8 +9,9 @@
 layout (location = 0) in uint aEncoded; // (per vertex)
 
 // aLighting layout
-// 0 - 12   13 - 15   16 - 19   20 - 23   24 - 27   28 - 31
-// unused    dirCent     R         G         B         Sun
+// 0 - 2    3 - 7     8 - 12    13 - 15   16 - 19   20 - 23   24 - 27   28 - 31
+// unused   quad V    quad U    dirCent     R         G         B         Sun
+// quad U/V = size - 1 (in blocks) of a greedy-meshed quad along the texture's axes
 layout (location = 1) in uint aLighting;// (per vertex)
 
 // per-chunk info
@@ -77,9 +78,12 @@ void Decode(in uint encoded,
 
 
 // decodes lighting information into a usable vec4
-// also decodes dircent info
-void Decode(in uint encoded, out vec4 lighting, out vec3 dirCent)
+// also decodes dircent info and the quad size
+void Decode(in uint encoded, out vec4 lighting, out vec3 dirCent, out vec2 quadSize)
 {
+  quadSize.x = ((encoded >> 19) & 0x1F) + 1;
+  quadSize.y = ((encoded >> 24) & 0x1F) + 1;
+
   dirCent.x = (encoded >> 18) & 0x1;
   dirCent.y = (encoded >> 17) & 0x1;
   dirCent.z = (encoded >> 16) & 0x1;
@@ -103,7 +107,9 @@ void main()
   vPos = modelPos + u_pos;
 
   // decode lighting + misc
-  Decode(aLighting, vLighting, dirCent);
+  vec2 quadSize;
+  Decode(aLighting, vLighting, dirCent, quadSize);
+  vTexCoord.xy *= quadSize; // textures repeat across merged quads
   vBlockPos = vPos + dirCent; // block position = vertex pos + direction to center of block
 
   gl_Position = u_viewProj * vec4(vPos, 1.0);
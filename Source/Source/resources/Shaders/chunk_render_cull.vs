@@ -32,7 +32,7 @@ out flat int vID;
 void main()
 {
   vID = gl_InstanceID; // index of chunk being drawn
-  uint aOffset = drawCommands[vID].first * 2; // ratio between vertex size and int
+  uint aOffset = drawCommands[vID].baseInstance * 2; // ratio between vertex size and int
   vec3 cPos = { vbo[aOffset], vbo[aOffset+1], vbo[aOffset+2] };
   //float err = distance(cPos, u_viewpos) / ...
   vPos = cPos + (aPos * 1.1 + .5) * (u_chunk_size);
@@ -26,6 +26,8 @@ struct InDrawInfo
   uint offset;
   uint size;
   AABB16 box;
+  uint faceEnds[6]; // where each face direction's records end (see FaceRanges::AllocInfo)
+  uvec2 _pad02;
 };
 
 // this struct's layout cannot change
@@ -62,10 +64,14 @@ uniform uint u_vertexSize; // size of vertex in bytes
 uniform float u_cullMinDist;
 uniform float u_cullMaxDist;
 uniform uint u_reservedVertices; // amt of reserved space (in vertices) before vertices for instanced attributes 
+uniform uint u_verticesPerRecord = 1; // vertices drawn per record (6 when each record is a whole quad)
+uniform bool u_faceRanges = false; // draw only the face directions that can face the viewer
 
 float GetDistance(in AABB16 box, in vec3 pos);
 bool CullDistance(float dist, float minDist, float maxDist);
 int CullFrustum(in AABB16 box, in Frustum frustum);
+uint FacingDirections(in AABB16 box, in vec3 pos);
+void EmitCommand(uint firstRecord, uint begin, uint end, float dist);
 
 layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
 void main()
@@ -89,21 +95,74 @@ void main()
 #endif
     if (condition == true)
     {
-      DrawArraysCommand cmd;
-      cmd.count = (alloc.size / u_vertexSize) - u_reservedVertices;
-      cmd.instanceCount = 0;
-      if (dist < 32)
-        cmd.instanceCount = 1;
-      cmd.first = alloc.offset / u_vertexSize;
-      cmd.baseInstance = cmd.first;
-
-      uint insert = atomicAdd(nextIdx, 1);
-      outDrawCommands[insert] = cmd;
+      uint firstRecord = alloc.offset / u_vertexSize;
+      uint records = (alloc.size / u_vertexSize) - u_reservedVertices;
+      if (!u_faceRanges)
+      {
+        EmitCommand(firstRecord, 0, records, dist);
+        continue;
+      }
+
+      // one command per run of facing directions, same as FaceRanges::Commands
+      uint facing = FacingDirections(alloc.box, u_viewpos);
+      uint runBegin = 0;
+      uint runEnd = 0;
+      for (int face = 0; face < 6; face++)
+      {
+        uint begin = face == 0 ? 0 : alloc.faceEnds[face - 1];
+        uint end = alloc.faceEnds[face];
+        if (begin == end)
+          continue;
+        if ((facing >> face & 1) != 0)
+        {
+          if (runBegin == runEnd)
+            runBegin = begin;
+          runEnd = end;
+        }
+        else if (runBegin != runEnd)
+        {
+          EmitCommand(firstRecord, runBegin, runEnd, dist);
+          runBegin = runEnd = 0;
+        }
+      }
+      if (runBegin != runEnd)
+        EmitCommand(firstRecord, runBegin, runEnd, dist);
     }
   }
 }
 
 
+// draws records [begin, end) after the header of the allocation starting at firstRecord
+void EmitCommand(uint firstRecord, uint begin, uint end, float dist)
+{
+  DrawArraysCommand cmd;
+  cmd.count = (end - begin) * u_verticesPerRecord;
+  cmd.instanceCount = 0;
+  if (dist < 32)
+    cmd.instanceCount = 1;
+  cmd.first = (firstRecord + begin) * u_verticesPerRecord;
+  cmd.baseInstance = firstRecord; // first record, where the per-chunk attributes are
+
+  uint insert = atomicAdd(nextIdx, 1);
+  outDrawCommands[insert] = cmd;
+}
+
+
+// bit i is set if faces pointing along direction i inside the box can face pos
+// (directions in ChunkHelpers::faces order)
+uint FacingDirections(in AABB16 box, in vec3 pos)
+{
+  uint dirs = 0;
+  if (pos.z > box.min.z) dirs |= 1u << 0; // far (+z)
+  if (pos.z < box.max.z) dirs |= 1u << 1; // near (-z)
+  if (pos.x < box.max.x) dirs |= 1u << 2; // left (-x)
+  if (pos.x > box.min.x) dirs |= 1u << 3; // right (+x)
+  if (pos.y > box.min.y) dirs |= 1u << 4; // top (+y)
+  if (pos.y < box.max.y) dirs |= 1u << 5; // bottom (-y)
+  return dirs;
+}
+
+
 float GetDistance(in AABB16 box, in vec3 pos)
 {
   vec3 bp = (box.max.xyz + box.min.xyz) / 2.0;
@@ -30,6 +30,13 @@ namespace Settings
 		const size_t res_amt = resolutions.size();
 
 		static inline bool blockAO = true;
+		static inline bool greedyMeshing = false; // merge coplanar faces into larger quads
+		// one 8 byte record per quad instead of 6 vertices, expanded in the vertex shader
+		// only read when the chunk allocator is created, so it can't change while running
+		static inline bool compactVertices = false;
+		// far chunks are meshed from cells of several blocks (see LodGrid) instead of drawn as splats
+		static inline bool lodMeshes = false;
+		static inline bool lodMajority = false; // LOD cells by majority instead of keeping the surface
 	};
 
 	struct SND
@@ -29,7 +29,6 @@
 #include <vector>
 #include <unordered_map>
 #include <map>
-#include <concurrent_unordered_map.h>
 #include <algorithm>
 #include <chrono>
 using namespace std::chrono;